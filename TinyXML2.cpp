@@ -3,6 +3,83 @@
 #include <new>					//管理动态存储
 #include <cstddef>				//隐式表达类型
 #include <cstdarg>				//变量参数处理
+#include <cfloat>				//浮点运算特性
+
+//线程检查工具把越过分配末尾的对齐读取（见下面的TIXML_NO_SANITIZE）报告为访问已释放的内存，检查时退回逐字节扫描
+#if defined(__SANITIZE_THREAD__) && !defined(TINYXML2_NO_SIMD)
+#define TINYXML2_NO_SIMD
+#endif
+#if defined(__has_feature)
+#if __has_feature(thread_sanitizer) && !defined(TINYXML2_NO_SIMD)
+#define TINYXML2_NO_SIMD
+#endif
+#endif
+
+//SIMD扫描内核，定义TINYXML2_NO_SIMD可关闭，退回逐字节扫描
+#if !defined(TINYXML2_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define TIXML_SIMD_AVX2
+#elif !defined(TINYXML2_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define TIXML_SIMD_SSE2
+#endif
+
+//对齐读取可能越过'\0'或记号的结尾读到同一块内的字节，不越页，读到的值也不使用，但地址检查工具会误报
+//并行解析时各块不共用对齐块（见XMLDocument::SeparateChunks()），不会读到其他线程写入的字节
+#if defined(__GNUC__)
+#define TIXML_NO_SANITIZE __attribute__((no_sanitize_address))
+#else
+#define TIXML_NO_SANITIZE
+#endif
+
+//Linux下LoadFile对大文件使用内存映射，定义TINYXML2_NO_MMAP可关闭，退回fread读取
+#if !defined(TINYXML2_NO_MMAP) && defined(__linux__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TIXML_USE_MMAP
+#endif
+
+//使用内存映射的最小文件长度，小文件直接读取更快
+#ifndef TINYXML2_MMAP_THRESHOLD
+#define TINYXML2_MMAP_THRESHOLD (64 * 1024)
+#endif
+
+//ParseParallel()使用pthread，定义TINYXML2_NO_THREADS或在其他平台上退回单线程解析
+#if !defined(TINYXML2_NO_THREADS) && ( defined(__linux__) || defined(__APPLE__) )
+#include <pthread.h>
+#include <unistd.h>
+#define TIXML_USE_THREADS
+#endif
+
+//按名称查找可以在多个线程中同时进行，查找时建立索引要用原子操作记账和登记
+#if defined(__GNUC__)
+#define TIXML_ATOMIC_ADD( p, n ) __sync_fetch_and_add( (p), (n) )
+#define TIXML_ATOMIC_CAS( p, oldValue, newValue ) __sync_bool_compare_and_swap( (p), (oldValue), (newValue) )
+#else
+#define TIXML_ATOMIC_ADD( p, n ) ( *(p) += (n) )
+#define TIXML_ATOMIC_CAS( p, oldValue, newValue ) ( *(p) == (oldValue) ? ( *(p) = (newValue), true ) : false )
+#endif
+
+//属性数超过该值时，查找和检查重复属性改用散列索引
+#ifndef TINYXML2_ATTRIBUTE_INDEX_MIN
+#define TINYXML2_ATTRIBUTE_INDEX_MIN 8
+#endif
+
+//按名称查找子元素时，遍历超过该数目的子节点仍未找到就建立子元素索引
+#ifndef TINYXML2_CHILD_INDEX_MIN
+#define TINYXML2_CHILD_INDEX_MIN 32
+#endif
+
+//并行解析时每个线程至少分到的字节数，太小的分块不值得启动线程
+#ifndef TINYXML2_PARALLEL_MIN_CHUNK
+#define TINYXML2_PARALLEL_MIN_CHUNK (1024 * 1024)
+#endif
+
+//浮点运算按类型本身的精度进行时，数值解析可以直接用一次乘除得到正确舍入的结果
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define TIXML_EXACT_FLOAT_ARITHMETIC
+#endif
 
 //处理字符串，用于存储到缓存区，TIXML_SNPRINTF拥有snprintf功能
 #define TIXML_SNPRINTF	snprintf		
@@ -16,9 +93,6 @@ static inline int TIXML_VSCPRINTF( const char* format, va_list va )
 	return len;
 }
 
-//输入功能，TIXML_SSCANF拥有sscanf功能
-#define TIXML_SSCANF   sscanf
-
 //换行
 static const char LINE_FEED				= (char)0x0a;			
 static const char LF = LINE_FEED;
@@ -52,40 +126,140 @@ namespace tinyxml2{
         { "lt",	2, 		'<'	 },
         { "gt",	2,		'>'	 }
     };
-    
-    //code
-    void StrPair::CollapseWhitespace()
-    {
-        //避免警告
-        TIXMLASSERT(( _flags & NEEDS_DELETE) == 0);
-        //初始化起始位置,忽略空白,调用XMLUtil中SkipWhiteSpace功能
-        _start = XMLUtil::SkipWhiteSpace(_start, 0);
-
-        if (*_start) {
-            const char* p = _start;     // 读指针
-            char* q = _start;           // 写指针
-
-            while(*p) {
-                //判断是否为空白
-                if (XMLUtil::IsWhiteSpace(*p)) {
-                    //跳过空白,换行
-                    p = XMLUtil::SkipWhiteSpace(p, 0);
-                    if (*p == 0) {
-                        break;
-                    }
-                    *q = ' ';       
-                    ++q;
+
+    //按块比较字节，返回位掩码，每一位对应块中的一个字节
+#if defined(TIXML_SIMD_AVX2)
+    typedef __m256i SimdBlock;
+    static const int SIMD_WIDTH = 32;
+    static const uint32_t SIMD_FULL_MASK = 0xffffffffu;
+    TIXML_NO_SANITIZE static inline SimdBlock SimdLoad( const char* p ) { return _mm256_load_si256( reinterpret_cast<const __m256i*>(p) ); }
+    static inline SimdBlock SimdSplat( char c )                 { return _mm256_set1_epi8( c ); }
+    static inline SimdBlock SimdSub( SimdBlock b, SimdBlock c ) { return _mm256_sub_epi8( b, c ); }
+    static inline SimdBlock SimdOr( SimdBlock b, SimdBlock c )  { return _mm256_or_si256( b, c ); }
+    static inline uint32_t SimdEqual( SimdBlock b, SimdBlock c ) { return (uint32_t)_mm256_movemask_epi8( _mm256_cmpeq_epi8( b, c ) ); }
+    //无符号比较 b <= c
+    static inline uint32_t SimdLessEqual( SimdBlock b, SimdBlock c ) { return SimdEqual( _mm256_min_epu8( b, c ), b ); }
+#elif defined(TIXML_SIMD_SSE2)
+    typedef __m128i SimdBlock;
+    static const int SIMD_WIDTH = 16;
+    static const uint32_t SIMD_FULL_MASK = 0xffffu;
+    TIXML_NO_SANITIZE static inline SimdBlock SimdLoad( const char* p ) { return _mm_load_si128( reinterpret_cast<const __m128i*>(p) ); }
+    static inline SimdBlock SimdSplat( char c )                 { return _mm_set1_epi8( c ); }
+    static inline SimdBlock SimdSub( SimdBlock b, SimdBlock c ) { return _mm_sub_epi8( b, c ); }
+    static inline SimdBlock SimdOr( SimdBlock b, SimdBlock c )  { return _mm_or_si128( b, c ); }
+    static inline uint32_t SimdEqual( SimdBlock b, SimdBlock c ) { return (uint32_t)_mm_movemask_epi8( _mm_cmpeq_epi8( b, c ) ); }
+    //无符号比较 b <= c
+    static inline uint32_t SimdLessEqual( SimdBlock b, SimdBlock c ) { return SimdEqual( _mm_min_epu8( b, c ), b ); }
+#endif
+
+    //查找下一个endChar或'\0'，同时统计跳过的换行数
+    //watchA/watchB为需要记录的字符('\0'表示不记录)，在停止位置之前出现时置位*special；
+    //collapse为真时，除单个空格以外的空白也会置位*special
+    static inline char* ScanTextRun( char* p, char endChar, int* curLineNumPtr, char watchA, char watchB, bool collapse, bool* special )
+    {
+        TIXMLASSERT( endChar != '\n' );
+#if defined(TIXML_SIMD_AVX2) || defined(TIXML_SIMD_SSE2)
+        //只做对齐读取，对齐的块不会跨页，读到'\0'之后的字节也是安全的
+        const uintptr_t offset = reinterpret_cast<uintptr_t>(p) & (SIMD_WIDTH - 1);
+        char* block = p - offset;
+        uint32_t valid = ( SIMD_FULL_MASK << offset ) & SIMD_FULL_MASK;
+        uint32_t spaceCarry = 0;
+        const SimdBlock endChars = SimdSplat( endChar );
+        const SimdBlock zeros = SimdSplat( 0 );
+        const SimdBlock lineFeeds = SimdSplat( '\n' );
+        const SimdBlock watchAs = SimdSplat( watchA );
+        const SimdBlock watchBs = SimdSplat( watchB );
+        const SimdBlock spaces = SimdSplat( ' ' );
+        const SimdBlock tabs = SimdSplat( '\t' );
+        const SimdBlock controlRange = SimdSplat( '\r' - '\t' );
+        for( ;; ) {
+            const SimdBlock b = SimdLoad( block );
+            const uint32_t stop = ( SimdEqual( b, endChars ) | SimdEqual( b, zeros ) ) & valid;
+            uint32_t newlines = SimdEqual( b, lineFeeds ) & valid;
+            uint32_t marks = SimdEqual( b, watchAs ) | SimdEqual( b, watchBs );
+            if ( collapse ) {
+                //控制空白，或者紧跟在空格后的空格
+                const uint32_t blanks = SimdEqual( b, spaces ) & valid;
+                marks |= SimdLessEqual( SimdSub( b, tabs ), controlRange ) | ( blanks & ( ( blanks << 1 ) | spaceCarry ) );
+                spaceCarry = blanks >> ( SIMD_WIDTH - 1 );
+            }
+            marks &= valid;
+            if ( stop ) {
+                //只统计停止位置之前的字节
+                const uint32_t before = ( stop & (0u - stop) ) - 1;
+                *curLineNumPtr += __builtin_popcount( newlines & before );
+                if ( marks & before ) {
+                    *special = true;
                 }
-                //写入q
-                *q = *p;    
-                ++q;
-                ++p;
+                return block + __builtin_ctz( stop );
+            }
+            *curLineNumPtr += __builtin_popcount( newlines );
+            if ( marks ) {
+                *special = true;
+            }
+            block += SIMD_WIDTH;
+            valid = SIMD_FULL_MASK;
+        }
+#else
+        bool afterSpace = false;
+        while ( *p && *p != endChar ) {
+            if ( *p == '\n' ) {
+                ++(*curLineNumPtr);
+            }
+            if ( *p == watchA || *p == watchB ) {
+                *special = true;
+            }
+            else if ( collapse && XMLUtil::IsWhiteSpace( *p ) && ( *p != ' ' || afterSpace ) ) {
+                *special = true;
+            }
+            afterSpace = ( *p == ' ' );
+            ++p;
+        }
+        return p;
+#endif
+    }
+
+    //查找名称的结尾：第一个不是名称字符的位置
+    static inline char* ScanNameRun( char* p )
+    {
+#if defined(TIXML_SIMD_AVX2) || defined(TIXML_SIMD_SSE2)
+        //名称字符：字母、数字、':'、'_'、'.'、'-'以及所有>=0x80的字节
+        const uintptr_t offset = reinterpret_cast<uintptr_t>(p) & (SIMD_WIDTH - 1);
+        char* block = p - offset;
+        uint32_t valid = ( SIMD_FULL_MASK << offset ) & SIMD_FULL_MASK;
+        const SimdBlock caseBit = SimdSplat( 0x20 );
+        const SimdBlock letterBase = SimdSplat( 'a' );
+        const SimdBlock letterRange = SimdSplat( 'z' - 'a' );
+        const SimdBlock digitBase = SimdSplat( '0' );
+        const SimdBlock digitRange = SimdSplat( ':' - '0' );     //'0'...'9'和':'
+        const SimdBlock dashBase = SimdSplat( '-' );
+        const SimdBlock dashRange = SimdSplat( '.' - '-' );      //'-'和'.'
+        const SimdBlock highBase = SimdSplat( (char)0x80 );
+        const SimdBlock highRange = SimdSplat( 0x7f );
+        const SimdBlock underscores = SimdSplat( '_' );
+        for( ;; ) {
+            const SimdBlock b = SimdLoad( block );
+            const uint32_t name = SimdLessEqual( SimdSub( SimdOr( b, caseBit ), letterBase ), letterRange )
+                                | SimdLessEqual( SimdSub( b, digitBase ), digitRange )
+                                | SimdLessEqual( SimdSub( b, dashBase ), dashRange )
+                                | SimdLessEqual( SimdSub( b, highBase ), highRange )
+                                | SimdEqual( b, underscores );
+            const uint32_t stop = ~name & valid;
+            if ( stop ) {
+                return block + __builtin_ctz( stop );
             }
-        //初始化q
-        *q = 0;
+            block += SIMD_WIDTH;
+            valid = SIMD_FULL_MASK;
+        }
+#else
+        while ( XMLUtil::IsNameChar( *p ) ) {
+            ++p;
         }
+        return p;
+#endif
     }
 
+    //code
     void StrPair::Reset()
     {
         if ( _flags & NEEDS_DELETE ) {
@@ -96,16 +270,28 @@ namespace tinyxml2{
         _end = 0;
     }
 
-    void StrPair::SetStr( const char* str, int flags )
+    bool StrPair::SetStr( const char* str, int flags, StrArena* arena )
     {
         TIXMLASSERT( str );
-        Reset();
         size_t len = strlen( str );
-        TIXMLASSERT( _start == 0 );
-        _start = new char[ len+1 ];
-        memcpy( _start, str, len+1 );
+        //分配区中的旧字符串够长就原地覆盖，反复设置同一个值不会让分配区增长
+        if ( arena && ( _flags & IN_ARENA ) && len <= (size_t)( _end - _start ) ) {
+            memmove( _start, str, len+1 );
+            _end = _start + len;
+            _flags = flags | IN_ARENA;
+            return true;
+        }
+        //str可能指向本对象的旧字符串，先复制再释放
+        char* start = arena ? arena->Alloc( len+1 ) : new char[ len+1 ];
+        if ( !start ) {
+            return false;
+        }
+        memcpy( start, str, len+1 );
+        Reset();
+        _start = start;
         _end = _start + len;
-        _flags = flags | NEEDS_DELETE;
+        _flags = flags | ( arena ? IN_ARENA : NEEDS_DELETE );
+        return true;
     }
 
     const char* StrPair::GetStr()
@@ -117,94 +303,87 @@ namespace tinyxml2{
             *_end = 0;
             _flags ^= NEEDS_FLUSH;
 
+            //换行规范化、实体解码和空白折叠在同一遍中完成
             if ( _flags ) {
+                const bool newlines = ( _flags & NEEDS_NEWLINE_NORMALIZATION ) != 0;
+                const bool decode = ( _flags & NEEDS_ENTITY_PROCESSING ) != 0;
+                const bool collapse = ( _flags & NEEDS_WHITESPACE_COLLAPSING ) != 0;
                 //读指针
                 const char* p = _start; 
                 //写指针
                 char* q = _start;   
+                //折叠模式下，等待写入的空格
+                bool pendingSpace = false;
 
                 while( p < _end ) {
-                    //当p指向回车符，p++，如果p+1指向行换行符p+2
-                    if ( (_flags & NEEDS_NEWLINE_NORMALIZATION) && *p == CR ) {
-                        if ( *(p+1) == LF ) {
-                            p += 2;
-                        }
-                        else {
-                            ++p;
-                        }
-                        *q = LF;
-                        ++q;
-                    }
-                    //当p指向换行符，p+1，如果p+1指向回车符p+2
-                    else if ( (_flags & NEEDS_NEWLINE_NORMALIZATION) && *p == LF ) {
-                        if ( *(p+1) == CR ) {
-                            p += 2;
-                        }
-                        else {
-                            ++p;
-                        }
-                        *q = LF;
-                        ++q;
+                    const int buflen = 10;
+                    char buf[buflen] = { 0 };
+                    //本次输出的字节
+                    const char* out = p;
+                    int len = 1;
+                    //"\r\n"、"\n\r"和单独的'\r'、'\n'都规范化为LF
+                    if ( newlines && ( *p == CR || *p == LF ) ) {
+                        const char pair = ( *p == CR ) ? LF : CR;
+                        p += ( *(p+1) == pair ) ? 2 : 1;
+                        buf[0] = LF;
+                        out = buf;
                     }
                     //如果p指向&，则假设后面为实体，然后读取出来
-                    else if ( (_flags & NEEDS_ENTITY_PROCESSING) && *p == '&' ) {             
-                        //由tinyXML2处理的实体
-                        //实体表中的特殊实体[in/out]
+                    else if ( decode && *p == '&' ) {
                         //数字字符引用[in] &#20013 或 &#x4e2d
                         if ( *(p+1) == '#' ) {
-                            const int buflen = 10;
-                            char buf[buflen] = { 0 };
-                            int len = 0;
-                            //处理十个字符
-                            char* adjusted = const_cast<char*>( XMLUtil::GetCharacterRef( p, buf, &len ) );
-                            //没有找到实体，++p
+                            const char* adjusted = XMLUtil::GetCharacterRef( p, buf, &len );
+                            //没有找到实体，原样输出'&'
                             if ( adjusted == 0 ) {
-                                *q = *p;
+                                len = 1;
                                 ++p;
-                                ++q;
                             }
-                            //找到实体，则拷贝到q中
                             else {
                                 TIXMLASSERT( 0 <= len && len <= buflen );
                                 TIXMLASSERT( q + len <= adjusted );
                                 p = adjusted;
-                                memcpy( q, buf, len );
-                                q += len;
+                                out = buf;
                             }
                         }
                         //和默认实体比较
                         else {
-                            bool entityFound = false;
+                            ++p;
                             for( int i = 0; i < NUM_ENTITIES; ++i ) {
                                 const Entity& entity = entities[i];
-                                if ( strncmp( p + 1, entity.pattern, entity.length ) == 0 && *( p + entity.length + 1 ) == ';' ) {
+                                if ( strncmp( p, entity.pattern, entity.length ) == 0 && *( p + entity.length ) == ';' ) {
                                     //找到一个实体
-                                    *q = entity.value;
-                                    ++q;
-                                    p += entity.length + 2;
-                                    entityFound = true;
+                                    buf[0] = entity.value;
+                                    out = buf;
+                                    p += entity.length + 1;
                                     break;
+                                }
                             }
                         }
-                        if ( !entityFound ) {
-                            ++p;
+                    }
+                    else {
+                        ++p;
+                    }
+
+                    //写入，q不会超过p
+                    for( int i = 0; i < len; ++i ) {
+                        const char c = out[i];
+                        if ( collapse && XMLUtil::IsWhiteSpace( c ) ) {
+                            //去掉开头的空白，中间的连续空白合并为一个空格
+                            pendingSpace = ( q != _start );
+                            continue;
+                        }
+                        if ( pendingSpace ) {
+                            *q = ' ';
                             ++q;
+                            pendingSpace = false;
                         }
+                        *q = c;
+                        ++q;
                     }
                 }
-                else {
-                    *q = *p;
-                    ++p;
-                    ++q;
-                }
-            }
-            *q = 0;
-        }
-            //处理空白，这个模式有待优化
-            if ( _flags & NEEDS_WHITESPACE_COLLAPSING ) {
-                CollapseWhitespace();
+                *q = 0;
             }
-            _flags = (_flags & NEEDS_DELETE);
+            _flags = (_flags & ( NEEDS_DELETE | IN_ARENA ));
         }
         TIXMLASSERT( _start );
         return _start;
@@ -220,24 +399,33 @@ namespace tinyxml2{
         char  endChar = *endTag;
         size_t length = strlen( endTag );
 
-        //解析文本
-        while ( *p ) {
+        //只有包含'&'、'\r'或可折叠空白的文本才需要规范化，扫描时一并记录
+        const bool collapse = ( strFlags & NEEDS_WHITESPACE_COLLAPSING ) != 0;
+        const char watchA = ( strFlags & NEEDS_ENTITY_PROCESSING ) ? '&' : 0;
+        const char watchB = ( strFlags & NEEDS_NEWLINE_NORMALIZATION ) ? CR : 0;
+        bool special = false;
+
+        //解析文本，按块跳到下一个可能的结尾标签
+        for( ;; ) {
+            p = ScanTextRun( p, endChar, curLineNumPtr, watchA, watchB, collapse, &special );
+            if ( !*p ) {
+                return 0;
+            }
             //*p为结尾标签，则返回结尾指针
-            if ( *p == endChar && strncmp( p, endTag, length ) == 0 ) {
+            if ( strncmp( p, endTag, length ) == 0 ) {
+                //干净的文本跳过规范化，读取时只需写入终止符
+                if ( !special && !( collapse && p > start && ( *start == ' ' || *(p-1) == ' ' ) ) ) {
+                    strFlags &= ~( NEEDS_ENTITY_PROCESSING | NEEDS_NEWLINE_NORMALIZATION | NEEDS_WHITESPACE_COLLAPSING );
+                }
                 Set( start, p, strFlags );
                 return p + length;
-            } 
-            //*p为换行符，换行
-            else if (*p == '\n') {
-                ++(*curLineNumPtr);
             }
             ++p;
             TIXMLASSERT( p );
         }
-        return 0;
     }
 
-    char* StrPair::ParseName( char* p )
+    char* StrPair::ParseName( char* p, XMLNameTable* names )
     {
         //空字符
         if ( !p || !(*p) ) {
@@ -248,1638 +436,5078 @@ namespace tinyxml2{
             return 0;
         }
         char* const start = p;
-        ++p;
-        while ( *p && XMLUtil::IsNameChar( *p ) ) {
-            ++p;
+        //'\0'不是名称字符，扫描会在结尾停止
+        p = ScanNameRun( p + 1 );
+        //指向名称表中的副本，不再写入缓存
+        const char* name = names->Intern( start, p - start );
+        if ( !name ) {
+            return 0;
         }
-        //写入p
-        Set( start, p, 0 );
+        SetInternedStr( name );
         return p;
     }
 
-    void StrPair::TransferTo( StrPair* other )
+    StrArena::StrArena() :
+        _blocks(),
+        _allocator( 0 ),
+        _cursor( 0 ),
+        _available( 0 ),
+        _used( 0 ),
+        _reserved( 0 ),
+        _bytes( 0 )
     {
-        if ( this == other ) {
-            return;
-        }
-
-        TIXMLASSERT( other != 0 );
-        TIXMLASSERT( other->_flags == 0 );
-        TIXMLASSERT( other->_start == 0 );
-        TIXMLASSERT( other->_end == 0 );
-
-        other->Reset();
-        //传递
-        other->_flags = _flags;
-        other->_start = _start;
-        other->_end = _end;
-        //充值str
-        _flags = 0;
-        _start = 0;
-        _end = 0;
     }
 
-    const char* XMLUtil::writeBoolTrue  = "true";
-    const char* XMLUtil::writeBoolFalse = "false";
+    StrArena::~StrArena()
+    {
+        Clear();
+    }
 
-    void XMLUtil::SetBoolSerialization(const char* writeTrue, const char* writeFalse)
+    char* StrArena::Alloc( size_t size )
     {
-        static const char* defTrue  = "true";
-        static const char* defFalse = "false";
+        const size_t align = sizeof( char* );
+        size = ( size + align - 1 ) & ~( align - 1 );
+        if ( size > _available ) {
+            //大的请求单独成块，当前块留给后面的小请求
+            if ( size > BLOCK_SIZE / 4 ) {
+                char* block = NewBlock( size );
+                if ( block ) {
+                    _used += size;
+                }
+                return block;
+            }
+            char* block = NewBlock( BLOCK_SIZE );
+            if ( !block ) {
+                return 0;
+            }
+            _cursor = block;
+            _available = BLOCK_SIZE;
+        }
+        _used += size;
+        char* mem = _cursor;
+        _cursor += size;
+        _available -= size;
+        return mem;
+    }
 
-        writeBoolTrue = (writeTrue) ? writeTrue : defTrue;
-        writeBoolFalse = (writeFalse) ? writeFalse : defFalse;
+    char* StrArena::NewBlock( size_t size )
+    {
+        Block block;
+        block.mem = static_cast<char*>( AllocMemory( _allocator, size ) );
+        block.size = size;
+        if ( block.mem ) {
+            _blocks.Push( block );
+            _bytes += size;
+        }
+        return block.mem;
     }
 
-    const char* XMLUtil::ReadBOM( const char* p, bool* bom )
+    void StrArena::Clear()
     {
-        TIXMLASSERT( p );
-        TIXMLASSERT( bom );
-        *bom = false;
-        const unsigned char* pu = reinterpret_cast<const unsigned char*>(p);
-        // 检查BOM，每次检查三个字符:
-        if (    *(pu+0) == TIXML_UTF_LEAD_0
-            && *(pu+1) == TIXML_UTF_LEAD_1
-            && *(pu+2) == TIXML_UTF_LEAD_2 ) {
-            *bom = true;
-            p += 3;
+        while ( !_blocks.Empty() ) {
+            const Block block = _blocks.Pop();
+            FreeMemory( _allocator, block.mem, block.size );
         }
-        TIXMLASSERT( p );
-        return p;
+        _cursor = 0;
+        _available = 0;
+        _used = 0;
+        _reserved = 0;
+        _bytes = 0;
     }
 
-    void XMLUtil::ConvertUTF32ToUTF8( unsigned long input, char* output, int* length )
+    void StrArena::Reset()
     {
-        const unsigned long BYTE_MASK = 0xBF;
-        const unsigned long BYTE_MARK = 0x80;
-        const unsigned long FIRST_BYTE_MARK[7] = { 0x00, 0x00, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC };
-        
-        //确定 UTF-8 编码字节数
-        if (input < 0x80) {
-            *length = 1;
+        const size_t used = _used;
+        const size_t size = used > BLOCK_SIZE ? used : (size_t)BLOCK_SIZE;
+        if ( _blocks.Size() == 1 && _reserved >= used && _reserved / TINYXML2_RETAIN_FACTOR <= size ) {
+            _cursor = _blocks[0].mem;
+            _available = _reserved;
         }
-        else if ( input < 0x800 ) {
-            *length = 2;
+        else if ( !_blocks.Empty() ) {
+            Clear();
+            _cursor = NewBlock( size );
+            if ( _cursor ) {
+                _reserved = size;
+                _available = size;
+            }
         }
-        else if ( input < 0x10000 ) {
-            *length = 3;
+        _used = 0;
+    }
+
+    XMLNameTable::XMLNameTable() :
+        _slots( 0 ),
+        _capacity( 0 ),
+        _count( 0 ),
+        _arena(),
+        _allocator( 0 )
+    {
+    }
+
+    XMLNameTable::~XMLNameTable()
+    {
+        Clear();
+    }
+
+    void XMLNameTable::Clear()
+    {
+        if ( _slots ) {
+            FreeMemory( _allocator, _slots, _capacity * sizeof( Slot ) );
         }
-        else if ( input < 0x200000 ) {
-            *length = 4;
+        _slots = 0;
+        _capacity = 0;
+        _count = 0;
+        _arena.Clear();
+    }
+
+    //FNV-1a
+    unsigned XMLNameTable::Hash( const char* str, size_t len )
+    {
+        unsigned hash = 2166136261u;
+        for ( size_t i = 0; i < len; ++i ) {
+            hash = ( hash ^ (unsigned char)str[i] ) * 16777619u;
         }
-        else {
-            *length = 0;
-            return;
+        return hash;
+    }
+
+    //返回名称所在的槽，没有时返回应当放入的空槽
+    const XMLNameTable::Slot* XMLNameTable::Lookup( const char* str, size_t len, unsigned hash ) const
+    {
+        TIXMLASSERT( _capacity > 0 );
+        const int mask = _capacity - 1;
+        for ( int i = hash & mask; ; i = ( i + 1 ) & mask ) {
+            const Slot* slot = &_slots[i];
+            if ( !slot->str ) {
+                return slot;
+            }
+            if ( slot->hash == hash && slot->length == len && memcmp( slot->str, str, len ) == 0 ) {
+                return slot;
+            }
         }
+    }
 
-        output += *length;
-        
-        //根据字节数转换 UTF-8 编码
-        switch (*length) {
-            case 4:
-                --output;
-                *output = (char)((input | BYTE_MARK) & BYTE_MASK);
-                input >>= 6;
-            case 3:
-                --output;
-                *output = (char)((input | BYTE_MARK) & BYTE_MASK);
-                input >>= 6;
-            case 2:
-                --output;
-                *output = (char)((input | BYTE_MARK) & BYTE_MASK);
-                input >>= 6;
-            case 1:
-                --output;
-                *output = (char)(input | FIRST_BYTE_MARK[*length]);
-                break;
-            default:
-                TIXMLASSERT( false );
+    const char* XMLNameTable::Find( const char* str, size_t len ) const
+    {
+        if ( !_count ) {
+            return 0;
         }
+        return Lookup( str, len, Hash( str, len ) )->str;
     }
 
-    const char* XMLUtil::GetCharacterRef( const char* p, char* value, int* length )
+    const char* XMLNameTable::Intern( const char* str, size_t len )
     {
-        *length = 0;
-        
-        //如果*(p+1)为'#'，且*(p+2)不为空，说明是合法字符
-        if ( *(p+1) == '#' && *(p+2) ) {
-            //初始化 ucs
-            unsigned long ucs = 0;
-            TIXMLASSERT( sizeof( ucs ) >= 4 );
-            //增量
-            ptrdiff_t delta = 0;
-            unsigned mult = 1;
-            static const char SEMICOLON = ';';
-            
-            //判断是否是 Unicode 字符
-            if ( *(p+2) == 'x' ) {         
-                const char* q = p+3;
-                if ( !(*q) ) {
-                    return 0;
-                }
-                
-                //q指向末尾
-                q = strchr( q, SEMICOLON );
+        //负载不超过一半
+        if ( ( _count + 1 ) * 2 > _capacity && !Grow() ) {
+            return 0;
+        }
+        const unsigned hash = Hash( str, len );
+        Slot* slot = const_cast<Slot*>( Lookup( str, len, hash ) );
+        if ( !slot->str ) {
+            slot->str = Store( str, len );
+            if ( !slot->str ) {
+                return 0;
+            }
+            slot->hash = hash;
+            slot->length = static_cast<unsigned>( len );
+            ++_count;
+        }
+        return slot->str;
+    }
 
-                if ( !q ) {
-                    return 0;
+    bool XMLNameTable::Grow()
+    {
+        const int capacity = _capacity ? _capacity * 2 : 64;
+        Slot* slots = static_cast<Slot*>( AllocMemory( _allocator, capacity * sizeof( Slot ) ) );
+        if ( !slots ) {
+            return false;
+        }
+        memset( slots, 0, capacity * sizeof( Slot ) );
+        for ( int i = 0; i < _capacity; ++i ) {
+            if ( _slots[i].str ) {
+                int j = _slots[i].hash & ( capacity - 1 );
+                while ( slots[j].str ) {
+                    j = ( j + 1 ) & ( capacity - 1 );
                 }
-                TIXMLASSERT( *q == SEMICOLON );
+                slots[j] = _slots[i];
+            }
+        }
+        if ( _slots ) {
+            FreeMemory( _allocator, _slots, _capacity * sizeof( Slot ) );
+        }
+        _slots = slots;
+        _capacity = capacity;
+        return true;
+    }
 
-                delta = q-p;
-                --q;
+    //名称前面留一个指针，记录合并后的副本，初始指向自己
+    const char* XMLNameTable::Store( const char* str, size_t len )
+    {
+        char* mem = _arena.Alloc( sizeof( char* ) + len + 1 );
+        if ( !mem ) {
+            return 0;
+        }
+        char* name = mem + sizeof( char* );
+        memcpy( name, str, len );
+        name[len] = 0;
+        *reinterpret_cast<const char**>( mem ) = name;
+        return name;
+    }
 
-                //解析字符
-                while ( *q != 'x' ) {
-                    unsigned int digit = 0;
-                    
-                    if ( *q >= '0' && *q <= '9' ) {
-                        digit = *q - '0';
-                    }
-                    else if ( *q >= 'a' && *q <= 'f' ) {
-                        digit = *q - 'a' + 10;
-                    }
-                    else if ( *q >= 'A' && *q <= 'F' ) {
-                        digit = *q - 'A' + 10;
-                    }
-                    else {
-                        return 0;
-                    }
-                    //确认digit为十六进制 
-                    TIXMLASSERT( digit < 16 );
-                    TIXMLASSERT( digit == 0 || mult <= UINT_MAX / digit );
-                    //转化为ucs
-                    const unsigned int digitScaled = mult * digit;
-                    TIXMLASSERT( ucs <= ULONG_MAX - digitScaled );
-                    ucs += digitScaled;
-                    TIXMLASSERT( mult <= UINT_MAX / 16 );
-                    mult *= 16;
-                    --q;
-                }
+    void XMLNameTable::Merge( XMLNameTable& other )
+    {
+        for ( int i = 0; i < other._capacity; ++i ) {
+            const Slot& slot = other._slots[i];
+            if ( slot.str ) {
+                const char* name = Intern( slot.str, slot.length );
+                *reinterpret_cast<const char**>( const_cast<char*>( slot.str ) - sizeof( char* ) ) = name;
             }
-             //*(p+2)!='x'说明为十进制
-            else {           
-                const char* q = p+2;
-                if ( !(*q) ) {
-                    return 0;
-                }
-                //指向末尾
-                q = strchr( q, SEMICOLON );
+        }
+    }
 
-                if ( !q ) {
-                    return 0;
-                }
-                TIXMLASSERT( *q == SEMICOLON );
-
-                delta = q-p;
-                --q;
-                //解析
-                while ( *q != '#' ) {
-                    if ( *q >= '0' && *q <= '9' ) {
-                        const unsigned int digit = *q - '0';
-                        TIXMLASSERT( digit < 10 );
-                        TIXMLASSERT( digit == 0 || mult <= UINT_MAX / digit );                  
-                        //转换为ucs
-                        const unsigned int digitScaled = mult * digit;
-                        TIXMLASSERT( ucs <= ULONG_MAX - digitScaled );
-                        ucs += digitScaled;
-                    }
-                    else {
-                        return 0;
-                    }
-                    TIXMLASSERT( mult <= UINT_MAX / 10 );
-                    mult *= 10;
-                    --q;
-                }
-            }
-            // ucs 转换为 utf-8
-            ConvertUTF32ToUTF8( ucs, value, length );
-            return p + delta + 1;
-        }
-        return p+1;
-    }
-
-    void XMLUtil::ToStr( int v, char* buffer, int bufferSize )
+    //指针散列：乘法散列取高位，对齐造成的低位0不影响分布
+    static inline int HashPointer( const void* p, int mask )
     {
-        TIXML_SNPRINTF( buffer, bufferSize, "%d", v );
+        const size_t key = reinterpret_cast<size_t>( p );
+        return static_cast<int>( ( ( key ^ ( key >> 16 ) ) * 2654435761u ) >> 8 ) & mask;
     }
 
-
-    void XMLUtil::ToStr( unsigned v, char* buffer, int bufferSize )
-    {
-        TIXML_SNPRINTF( buffer, bufferSize, "%u", v );
-    }
-
-
-    void XMLUtil::ToStr( bool v, char* buffer, int bufferSize )
+    XMLAttributeIndex::XMLAttributeIndex( size_t* usage ) :
+        _slots( 0 ),
+        _capacity( 0 ),
+        _count( 0 ),
+        _stamp( 1 ),
+        _last( 0 ),
+        _usage( usage )
     {
-        TIXML_SNPRINTF( buffer, bufferSize, "%s", v ? writeBoolTrue : writeBoolFalse);
+        if ( _usage ) {
+            TIXML_ATOMIC_ADD( _usage, Bytes() );
+        }
     }
 
-    void XMLUtil::ToStr( float v, char* buffer, int bufferSize )
+    XMLAttributeIndex::~XMLAttributeIndex()
     {
-        TIXML_SNPRINTF( buffer, bufferSize, "%.8g", v );
+        if ( _usage ) {
+            TIXML_ATOMIC_ADD( _usage, 0 - Bytes() );
+        }
+        delete [] _slots;
     }
 
-
-    void XMLUtil::ToStr( double v, char* buffer, int bufferSize )
+    void XMLAttributeIndex::Clear()
     {
-        TIXML_SNPRINTF( buffer, bufferSize, "%.17g", v );
+        _count = 0;
+        _last = 0;
+        //标记回绕时才真正清零
+        if ( ++_stamp == 0 ) {
+            memset( _slots, 0, _capacity * sizeof( Slot ) );
+            _stamp = 1;
+        }
     }
 
-
-    void XMLUtil::ToStr(int64_t v, char* buffer, int bufferSize)
+    void XMLAttributeIndex::Build( XMLAttribute* first )
     {
-        TIXML_SNPRINTF(buffer, bufferSize, "%lld", (long long)v);
+        Clear();
+        for ( XMLAttribute* a = first; a; a = a->_next ) {
+            Insert( a );
+        }
     }
 
-    bool XMLUtil::ToInt( const char* str, int* value )
+    //返回名称所在的槽，没有时返回应当放入的空槽
+    int XMLAttributeIndex::Lookup( const char* name ) const
     {
-        if ( TIXML_SSCANF( str, "%d", value ) == 1 ) {
-            return true;
+        TIXMLASSERT( _capacity > 0 );
+        const int mask = _capacity - 1;
+        int i = HashPointer( name, mask );
+        while ( _slots[i].stamp == _stamp && _slots[i].name != name ) {
+            i = ( i + 1 ) & mask;
         }
-        return false;
+        return i;
     }
 
-    bool XMLUtil::ToUnsigned( const char* str, unsigned *value )
+    XMLAttribute* XMLAttributeIndex::Find( const char* name ) const
     {
-        if ( TIXML_SSCANF( str, "%u", value ) == 1 ) {
-            return true;
+        if ( !_count ) {
+            return 0;
         }
-        return false;
+        const Slot& slot = _slots[ Lookup( name ) ];
+        return ( slot.stamp == _stamp ) ? slot.attrib : 0;
     }
 
-    bool XMLUtil::ToBool( const char* str, bool* value )
+    bool XMLAttributeIndex::Insert( XMLAttribute* attrib )
     {
-        int ival = 0;
-        if ( ToInt( str, &ival )) {
-            *value = (ival==0) ? false : true;
-            return true;
-        }
-        if ( StringEqual( str, "true" ) ) {
-            *value = true;
-            return true;
+        //负载不超过一半
+        if ( ( _count + 1 ) * 2 > _capacity ) {
+            Grow();
         }
-        else if ( StringEqual( str, "false" ) ) {
-            *value = false;
-            return true;
+        const char* name = attrib->Name();
+        Slot& slot = _slots[ Lookup( name ) ];
+        if ( slot.stamp == _stamp ) {
+            return false;
         }
-        return false;
+        slot.name = name;
+        slot.attrib = attrib;
+        slot.stamp = _stamp;
+        ++_count;
+        _last = attrib;
+        return true;
     }
 
-
-    bool XMLUtil::ToFloat( const char* str, float* value )
-    {
-        if ( TIXML_SSCANF( str, "%f", value ) == 1 ) {
-            return true;
+    void XMLAttributeIndex::Grow()
+    {
+        Slot* old = _slots;
+        const int oldCapacity = _capacity;
+        const unsigned oldStamp = _stamp;
+        const size_t oldBytes = Bytes();
+        _capacity = _capacity ? _capacity * 2 : 32;
+        if ( _usage ) {
+            TIXML_ATOMIC_ADD( _usage, Bytes() - oldBytes );
+        }
+        _slots = new Slot[_capacity];
+        memset( _slots, 0, _capacity * sizeof( Slot ) );
+        _stamp = 1;
+        for ( int i = 0; i < oldCapacity; ++i ) {
+            if ( old[i].stamp == oldStamp ) {
+                Slot& slot = _slots[ Lookup( old[i].name ) ];
+                slot = old[i];
+                slot.stamp = _stamp;
+            }
         }
-        return false;
+        delete [] old;
     }
 
-
-    bool XMLUtil::ToDouble( const char* str, double* value )
+    XMLChildIndex::XMLChildIndex( size_t* usage ) :
+        _names( 0 ),
+        _children( 0 ),
+        _capacity( 0 ),
+        _nameCount( 0 ),
+        _childCount( 0 ),
+        _valid( false ),
+        _usage( usage )
     {
-        if ( TIXML_SSCANF( str, "%lf", value ) == 1 ) {
-            return true;
+        if ( _usage ) {
+            TIXML_ATOMIC_ADD( _usage, Bytes() );
         }
-        return false;
     }
 
-
-    bool XMLUtil::ToInt64(const char* str, int64_t* value)
+    XMLChildIndex::~XMLChildIndex()
     {
-        long long v = 0;
-        if (TIXML_SSCANF(str, "%lld", &v) == 1) {
-            *value = (int64_t)v;
-            return true;
+        if ( _usage ) {
+            TIXML_ATOMIC_ADD( _usage, 0 - Bytes() );
         }
-        return false;
+        delete [] _names;
+        delete [] _children;
     }
 
-    void XMLNode::Unlink( XMLNode* child )
+    void XMLChildIndex::Clear()
     {
-        //判断节点是否存在
-        TIXMLASSERT( child );
-        TIXMLASSERT( child->_document == _document );
-        TIXMLASSERT( child->_parent == this );
-        //重新链接孩子节点，_firstChild指向下一个节点
-        if ( child == _firstChild ) {
-            _firstChild = _firstChild->_next;
-        }
-        //_firstChild指向上一个节点
-        if ( child == _lastChild ) {
-            _lastChild = _lastChild->_prev;
-        }
-        //child指向下一个节点
-        if ( child->_prev ) {
-            child->_prev->_next = child->_next;
-        }
-        //child指向上一个节点
-        if ( child->_next ) {
-            child->_next->_prev = child->_prev;
+        if ( _nameCount || _childCount ) {
+            memset( _names, 0, _capacity * sizeof( NameSlot ) );
+            memset( _children, 0, _capacity * sizeof( ChildSlot ) );
         }
-        //清空节点
-        child->_next = 0;
-        child->_prev = 0;
-        child->_parent = 0;
+        _nameCount = 0;
+        _childCount = 0;
+        _valid = false;
     }
 
-
-    void XMLNode::DeleteNode( XMLNode* node )
+    void XMLChildIndex::Build( const XMLNode* parent )
     {
-        //如果节点为空返回
-        if ( node == 0 ) {
-            return;
+        Clear();
+        _valid = true;
+        for ( const XMLNode* node = parent->FirstChild(); node; node = node->NextSibling() ) {
+            const XMLElement* element = node->ToElement();
+            if ( element ) {
+                Append( const_cast<XMLElement*>( element ) );
+            }
         }
-        TIXMLASSERT(node->_document);
-        //检查节点是否有值
-        if (!node->ToDocument()) {
-          node->_document->MarkInUse(node);
-      }
-
-        //释放节点
-        MemPool* pool = node->_memPool;
-        node->~XMLNode();
-        pool->Free( node );
     }
 
-    void XMLNode::InsertChildPreamble( XMLNode* insertThis ) const
+    XMLChildIndex::NameSlot* XMLChildIndex::FindName( const char* name ) const
     {
-        TIXMLASSERT( insertThis );
-        TIXMLASSERT( insertThis->_document == _document );
-        //断开链接
-        if (insertThis->_parent) {
-            insertThis->_parent->Unlink( insertThis );
+        if ( !_nameCount ) {
+            return 0;
         }
-        //跟踪
-        else {
-          insertThis->_document->MarkInUse(insertThis);
-          insertThis->_memPool->SetTracked();
+        const int mask = _capacity - 1;
+        for ( int i = HashPointer( name, mask ); _names[i].name; i = ( i + 1 ) & mask ) {
+            if ( _names[i].name == name ) {
+                return &_names[i];
+            }
         }
+        return 0;
     }
 
-    const XMLElement* XMLNode::ToElementWithName( const char* name ) const
+    XMLChildIndex::NameSlot* XMLChildIndex::AddName( const char* name )
     {
-        const XMLElement* element = this->ToElement();
-        if ( element == 0 ) {
-            return 0;
+        const int mask = _capacity - 1;
+        int i = HashPointer( name, mask );
+        while ( _names[i].name && _names[i].name != name ) {
+            i = ( i + 1 ) & mask;
         }
-        if ( name == 0 ) {
-            return element;
+        if ( !_names[i].name ) {
+            _names[i].name = name;
+            ++_nameCount;
         }
-        //比较元素名和名称
-        if ( XMLUtil::StringEqual( element->Name(), name ) ) {
-           return element;
-       }
-       return 0;
+        return &_names[i];
     }
 
-    XMLNode::XMLNode( XMLDocument* doc ) :
-    _document( doc ),
-    _parent( 0 ),
-    _value(),
-    _parseLineNum( 0 ),
-    _firstChild( 0 ), _lastChild( 0 ),
-    _prev( 0 ), _next( 0 ),
-    _userData( 0 ),
-    _memPool( 0 )
+    XMLChildIndex::ChildSlot* XMLChildIndex::FindChild( const XMLElement* element ) const
     {
+        if ( !_childCount ) {
+            return 0;
+        }
+        const int mask = _capacity - 1;
+        for ( int i = HashPointer( element, mask ); _children[i].child; i = ( i + 1 ) & mask ) {
+            if ( _children[i].child == element ) {
+                return &_children[i];
+            }
+        }
+        return 0;
     }
 
-
-    XMLNode::~XMLNode()
+    XMLChildIndex::ChildSlot* XMLChildIndex::AddChild( const XMLElement* element )
     {
-        DeleteChildren();
-        if ( _parent ) {
-            _parent->Unlink( this );
+        const int mask = _capacity - 1;
+        int i = HashPointer( element, mask );
+        while ( _children[i].child ) {
+            TIXMLASSERT( _children[i].child != element );
+            i = ( i + 1 ) & mask;
         }
+        _children[i].child = element;
+        ++_childCount;
+        return &_children[i];
     }
 
-    char* XMLNode::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr )
+    void XMLChildIndex::Grow()
     {
-        XMLDocument::DepthTracker tracker(_document);
-        if (_document->Error())
-            return 0;
-        //当P不为空
-        while( p && *p ) {
-            XMLNode* node = 0;
-            //识别 p 内容
-            p = _document->Identify( p, &node );
-            TIXMLASSERT( p );
-            if ( node == 0 ) {
-                break;
-            }
-
-            //解析行数
-            int initialLineNum = node->_parseLineNum;
-            //找到结尾标记
-            StrPair endTag;
-            p = node->ParseDeep( p, &endTag, curLineNumPtr );
-            //如果p为空，则报错
-            if ( !p ) {
-                DeleteNode( node );
-                if ( !_document->Error() ) {
-                    _document->SetError( XML_ERROR_PARSING, initialLineNum, 0);
-                }
-                break;
-            }
-            
-            //查找声明
-            XMLDeclaration* decl = node->ToDeclaration();
-            if ( decl ) {
-                //如果第一个节点是声明，而最后一个节点也是声明，那么到目前为止只添加了声明。
-                bool wellLocated = false;
-                //如果是文本内容则检查首尾是否为声明
-                if (ToDocument()) {
-                    if (FirstChild()) {
-                        wellLocated =
-                        FirstChild() &&
-                        FirstChild()->ToDeclaration() &&
-                        LastChild() &&
-                        LastChild()->ToDeclaration();
-                    }
-                    else {
-                        wellLocated = true;
-                    }
-                }
-                //如果不是，则报错并且删除节点
-                if ( !wellLocated ) {
-                    _document->SetError( XML_ERROR_PARSING_DECLARATION, initialLineNum, "XMLDeclaration value=%s", decl->Value());
-                    DeleteNode( node );
-                    break;
-                }
+        NameSlot* names = _names;
+        ChildSlot* children = _children;
+        const int capacity = _capacity;
+        const size_t oldBytes = Bytes();
+        _capacity = _capacity ? _capacity * 2 : 64;
+        if ( _usage ) {
+            TIXML_ATOMIC_ADD( _usage, Bytes() - oldBytes );
+        }
+        _names = new NameSlot[_capacity];
+        _children = new ChildSlot[_capacity];
+        memset( _names, 0, _capacity * sizeof( NameSlot ) );
+        memset( _children, 0, _capacity * sizeof( ChildSlot ) );
+        _nameCount = 0;
+        _childCount = 0;
+        for ( int i = 0; i < capacity; ++i ) {
+            if ( names[i].name ) {
+                *AddName( names[i].name ) = names[i];
             }
-            //识别元素
-            XMLElement* ele = node->ToElement();
-            if ( ele ) {
-                //读取结束标记，将其返回给父母。
-                if ( ele->ClosingType() == XMLElement::CLOSING ) {
-                    if ( parentEndTag ) {
-                        ele->_value.TransferTo( parentEndTag );
-                    }
-                    //建立一个跟踪，然后立即删除
-                    node->_memPool->SetTracked();
-                    DeleteNode( node );
-                    return p;
-                }
-
-                //处理返回到该处的结束标记
-                bool mismatch = false;
-                if ( endTag.Empty() ) {
-                    if ( ele->ClosingType() == XMLElement::OPEN ) {
-                        mismatch = true;
-                    }
-                }
-                else {
-                    if ( ele->ClosingType() != XMLElement::OPEN ) {
-                        mismatch = true;
-                    }
-                    else if ( !XMLUtil::StringEqual( endTag.GetStr(), ele->Name() ) ) {
-                        mismatch = true;
-                    }
-                }
-                if ( mismatch ) {
-                    _document->SetError( XML_ERROR_MISMATCHED_ELEMENT, initialLineNum, "XMLElement name=%s", ele->Name());
-                    DeleteNode( node );
-                    break;
-                }
+            if ( children[i].child ) {
+                *AddChild( children[i].child ) = children[i];
             }
-            InsertEndChild( node );
         }
-        return 0;
+        delete [] names;
+        delete [] children;
     }
 
-    const char* XMLNode::Value() const
+    void XMLChildIndex::Append( XMLElement* element )
     {
-        // XMLDocuments 没有值,返回null。
-        if ( this->ToDocument() )
-            return 0;
-        return _value.GetStr();
+        if ( !_valid ) {
+            return;
+        }
+        //负载不超过一半
+        if ( ( _childCount + 1 ) * 2 > _capacity || ( _nameCount + 1 ) * 2 > _capacity ) {
+            Grow();
+        }
+        NameSlot* name = AddName( element->Name() );
+        ChildSlot* child = AddChild( element );
+        child->prev = name->last;
+        child->next = 0;
+        if ( name->last ) {
+            FindChild( name->last )->next = element;
+        }
+        else {
+            name->first = element;
+        }
+        name->last = element;
     }
 
-
-    void XMLNode::SetValue( const char* str, bool staticMem )
-    {   
-        //以插入方式
-        if ( staticMem ) {
-            _value.SetInternedStr( str );
+    void XMLChildIndex::Prepend( XMLElement* element )
+    {
+        if ( !_valid ) {
+            return;
+        }
+        if ( ( _childCount + 1 ) * 2 > _capacity || ( _nameCount + 1 ) * 2 > _capacity ) {
+            Grow();
+        }
+        NameSlot* name = AddName( element->Name() );
+        ChildSlot* child = AddChild( element );
+        child->prev = 0;
+        child->next = name->first;
+        if ( name->first ) {
+            FindChild( name->first )->prev = element;
         }
-        //直接赋值
         else {
-            _value.SetStr( str );
+            name->last = element;
         }
+        name->first = element;
     }
 
-    const XMLElement* XMLNode::PreviousSiblingElement( const char* name ) const
+    void XMLChildIndex::Remove( const XMLElement* element )
     {
-        for( const XMLNode* node = _prev; node; node = node->_prev ) {
-            const XMLElement* element = node->ToElementWithName( name );
-            if ( element ) {
-                return element;
+        ChildSlot* child = _valid ? FindChild( element ) : 0;
+        if ( !child ) {
+            return;
+        }
+        NameSlot* name = FindName( element->Name() );
+        TIXMLASSERT( name );
+        if ( child->prev ) {
+            FindChild( child->prev )->next = child->next;
+        }
+        else {
+            name->first = child->next;
+        }
+        if ( child->next ) {
+            FindChild( child->next )->prev = child->prev;
+        }
+        else {
+            name->last = child->prev;
+        }
+        //线性探测的删除：把后面不在自己散列位置上的槽前移，不留删除标记
+        const int mask = _capacity - 1;
+        int i = static_cast<int>( child - _children );
+        for ( int j = ( i + 1 ) & mask; _children[j].child; j = ( j + 1 ) & mask ) {
+            const int k = HashPointer( _children[j].child, mask );
+            const bool stays = ( i <= j ) ? ( i < k && k <= j ) : ( i < k || k <= j );
+            if ( !stays ) {
+                _children[i] = _children[j];
+                i = j;
             }
         }
-        return 0;
+        _children[i].child = 0;
+        --_childCount;
     }
 
-    const XMLElement* XMLNode::FirstChildElement( const char* name ) const
+    XMLElement* XMLChildIndex::First( const char* name ) const
     {
-        //遍历节点，找到第一个元素
-        for( const XMLNode* node = _firstChild; node; node = node->_next ) {
-            const XMLElement* element = node->ToElementWithName( name );
-            if ( element ) {
-                return element;
-            }
-        }
-        return 0;
+        const NameSlot* slot = FindName( name );
+        return slot ? slot->first : 0;
     }
 
-    const XMLElement* XMLNode::LastChildElement( const char* name ) const
+    XMLElement* XMLChildIndex::Last( const char* name ) const
     {
-        //遍历，从最后一个节点开始
-        for( const XMLNode* node = _lastChild; node; node = node->_prev ) {
-            const XMLElement* element = node->ToElementWithName( name );
-            if ( element ) {
-                return element;
-            }
-        }
-        return 0;
+        const NameSlot* slot = FindName( name );
+        return slot ? slot->last : 0;
     }
 
-    const XMLElement* XMLNode::NextSiblingElement( const char* name ) const
+    XMLElement* XMLChildIndex::Next( const XMLElement* element ) const
     {
-        for( const XMLNode* node = _next; node; node = node->_next ) {
-            const XMLElement* element = node->ToElementWithName( name );
-            if ( element ) {
-                return element;
-            }
-        }
-        return 0;
+        const ChildSlot* slot = FindChild( element );
+        return slot ? slot->next : 0;
     }
 
+    XMLElement* XMLChildIndex::Previous( const XMLElement* element ) const
+    {
+        const ChildSlot* slot = FindChild( element );
+        return slot ? slot->prev : 0;
+    }
+
+    void StrPair::TransferTo( StrPair* other )
+    {
+        if ( this == other ) {
+            return;
+        }
+
+        TIXMLASSERT( other != 0 );
+        TIXMLASSERT( other->_flags == 0 );
+        TIXMLASSERT( other->_start == 0 );
+        TIXMLASSERT( other->_end == 0 );
+
+        other->Reset();
+        //传递
+        other->_flags = _flags;
+        other->_start = _start;
+        other->_end = _end;
+        //充值str
+        _flags = 0;
+        _start = 0;
+        _end = 0;
+    }
+
+    //字符分类表，与区域设置无关
+    //0x01空白(CHAR_WHITESPACE)，0x02名称起始字符(CHAR_NAME_START)，0x04名称字符(CHAR_NAME)
+    const unsigned char XMLUtil::_charClass[256] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00,     //0x00
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     //0x10
+        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x04, 0x00,     //0x20
+        0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00,     //0x30
+        0x00, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,     //0x40
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x00, 0x00, 0x00, 0x00, 0x06,     //0x50
+        0x00, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,     //0x60
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00,     //0x70
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,     //0x80
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,     //0x90
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,     //0xa0
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,     //0xb0
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,     //0xc0
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,     //0xd0
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,     //0xe0
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,     //0xf0
+    };
+
+    const char* XMLUtil::SkipWhiteSpaceRun( const char* p, int* curLineNumPtr )
+    {
+        TIXMLASSERT( p );
+        int newlineCount = 0;
+#if defined(TIXML_SIMD_AVX2) || defined(TIXML_SIMD_SSE2)
+        //按块分类空白：' '或'\t'...'\r'，遇到第一个非空白字符停止
+        const uintptr_t offset = reinterpret_cast<uintptr_t>(p) & (SIMD_WIDTH - 1);
+        const char* block = p - offset;
+        uint32_t valid = ( SIMD_FULL_MASK << offset ) & SIMD_FULL_MASK;
+        const SimdBlock spaces = SimdSplat( ' ' );
+        const SimdBlock tabs = SimdSplat( '\t' );
+        const SimdBlock controlRange = SimdSplat( '\r' - '\t' );
+        const SimdBlock lineFeeds = SimdSplat( '\n' );
+        for( ;; ) {
+            const SimdBlock b = SimdLoad( block );
+            const uint32_t white = SimdEqual( b, spaces ) | SimdLessEqual( SimdSub( b, tabs ), controlRange );
+            const uint32_t stop = ~white & valid;
+            uint32_t newlines = SimdEqual( b, lineFeeds ) & valid;
+            if ( stop ) {
+                newlines &= ( stop & (0u - stop) ) - 1;
+                newlineCount += __builtin_popcount( newlines );
+                p = block + __builtin_ctz( stop );
+                break;
+            }
+            newlineCount += __builtin_popcount( newlines );
+            block += SIMD_WIDTH;
+            valid = SIMD_FULL_MASK;
+        }
+#else
+        while( IsWhiteSpace(*p) ) {
+            if ( *p == '\n' ) {
+                ++newlineCount;
+            }
+            ++p;
+        }
+#endif
+        if ( curLineNumPtr ) {
+            *curLineNumPtr += newlineCount;
+        }
+        TIXMLASSERT( p );
+        return p;
+    }
+
+    const char* XMLUtil::writeBoolTrue  = "true";
+    const char* XMLUtil::writeBoolFalse = "false";
+
+    void XMLUtil::SetBoolSerialization(const char* writeTrue, const char* writeFalse)
+    {
+        static const char* defTrue  = "true";
+        static const char* defFalse = "false";
+
+        writeBoolTrue = (writeTrue) ? writeTrue : defTrue;
+        writeBoolFalse = (writeFalse) ? writeFalse : defFalse;
+    }
+
+    const char* XMLUtil::ReadBOM( const char* p, bool* bom )
+    {
+        TIXMLASSERT( p );
+        TIXMLASSERT( bom );
+        *bom = false;
+        const unsigned char* pu = reinterpret_cast<const unsigned char*>(p);
+        // 检查BOM，每次检查三个字符:
+        if (    *(pu+0) == TIXML_UTF_LEAD_0
+            && *(pu+1) == TIXML_UTF_LEAD_1
+            && *(pu+2) == TIXML_UTF_LEAD_2 ) {
+            *bom = true;
+            p += 3;
+        }
+        TIXMLASSERT( p );
+        return p;
+    }
+
+    void XMLUtil::ConvertUTF32ToUTF8( unsigned long input, char* output, int* length )
+    {
+        const unsigned long BYTE_MASK = 0xBF;
+        const unsigned long BYTE_MARK = 0x80;
+        const unsigned long FIRST_BYTE_MARK[7] = { 0x00, 0x00, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC };
+        
+        //确定 UTF-8 编码字节数
+        if (input < 0x80) {
+            *length = 1;
+        }
+        else if ( input < 0x800 ) {
+            *length = 2;
+        }
+        else if ( input < 0x10000 ) {
+            *length = 3;
+        }
+        else if ( input < 0x200000 ) {
+            *length = 4;
+        }
+        else {
+            *length = 0;
+            return;
+        }
+
+        output += *length;
+        
+        //根据字节数转换 UTF-8 编码
+        switch (*length) {
+            case 4:
+                --output;
+                *output = (char)((input | BYTE_MARK) & BYTE_MASK);
+                input >>= 6;
+            case 3:
+                --output;
+                *output = (char)((input | BYTE_MARK) & BYTE_MASK);
+                input >>= 6;
+            case 2:
+                --output;
+                *output = (char)((input | BYTE_MARK) & BYTE_MASK);
+                input >>= 6;
+            case 1:
+                --output;
+                *output = (char)(input | FIRST_BYTE_MARK[*length]);
+                break;
+            default:
+                TIXMLASSERT( false );
+        }
+    }
+
+    const char* XMLUtil::GetCharacterRef( const char* p, char* value, int* length )
+    {
+        *length = 0;
+        
+        //如果*(p+1)为'#'，且*(p+2)不为空，说明是合法字符
+        if ( *(p+1) == '#' && *(p+2) ) {
+            //初始化 ucs
+            unsigned long ucs = 0;
+            TIXMLASSERT( sizeof( ucs ) >= 4 );
+            //增量
+            ptrdiff_t delta = 0;
+            unsigned mult = 1;
+            static const char SEMICOLON = ';';
+            
+            //判断是否是 Unicode 字符
+            if ( *(p+2) == 'x' ) {         
+                const char* q = p+3;
+                if ( !(*q) ) {
+                    return 0;
+                }
+                
+                //q指向末尾
+                q = strchr( q, SEMICOLON );
+
+                if ( !q ) {
+                    return 0;
+                }
+                TIXMLASSERT( *q == SEMICOLON );
+
+                delta = q-p;
+                --q;
+
+                //解析字符
+                while ( *q != 'x' ) {
+                    unsigned int digit = 0;
+                    
+                    if ( *q >= '0' && *q <= '9' ) {
+                        digit = *q - '0';
+                    }
+                    else if ( *q >= 'a' && *q <= 'f' ) {
+                        digit = *q - 'a' + 10;
+                    }
+                    else if ( *q >= 'A' && *q <= 'F' ) {
+                        digit = *q - 'A' + 10;
+                    }
+                    else {
+                        return 0;
+                    }
+                    //确认digit为十六进制 
+                    TIXMLASSERT( digit < 16 );
+                    TIXMLASSERT( digit == 0 || mult <= UINT_MAX / digit );
+                    //转化为ucs
+                    const unsigned int digitScaled = mult * digit;
+                    TIXMLASSERT( ucs <= ULONG_MAX - digitScaled );
+                    ucs += digitScaled;
+                    TIXMLASSERT( mult <= UINT_MAX / 16 );
+                    mult *= 16;
+                    --q;
+                }
+            }
+             //*(p+2)!='x'说明为十进制
+            else {           
+                const char* q = p+2;
+                if ( !(*q) ) {
+                    return 0;
+                }
+                //指向末尾
+                q = strchr( q, SEMICOLON );
+
+                if ( !q ) {
+                    return 0;
+                }
+                TIXMLASSERT( *q == SEMICOLON );
+
+                delta = q-p;
+                --q;
+                //解析
+                while ( *q != '#' ) {
+                    if ( *q >= '0' && *q <= '9' ) {
+                        const unsigned int digit = *q - '0';
+                        TIXMLASSERT( digit < 10 );
+                        TIXMLASSERT( digit == 0 || mult <= UINT_MAX / digit );                  
+                        //转换为ucs
+                        const unsigned int digitScaled = mult * digit;
+                        TIXMLASSERT( ucs <= ULONG_MAX - digitScaled );
+                        ucs += digitScaled;
+                    }
+                    else {
+                        return 0;
+                    }
+                    TIXMLASSERT( mult <= UINT_MAX / 10 );
+                    mult *= 10;
+                    --q;
+                }
+            }
+            // ucs 转换为 utf-8
+            ConvertUTF32ToUTF8( ucs, value, length );
+            return p + delta + 1;
+        }
+        return p+1;
+    }
+
+    //数值解析：不依赖区域设置，整个字符串（前后空白除外）必须是一个数
+    //整数逐位累加并检查溢出；浮点数先取前19位有效数字w和十进制指数q，
+    //w×10^q能直接用浮点运算精确求得时直接算，否则用128位的5的幂相乘（Eisel-Lemire），
+    //乘积的误差可能影响舍入时再用大整数比较精确决定
+
+    //十进制数：w×10^q，有效数字超过19位时w截断，truncated表示截掉的数字不全为0
+    struct DecimalNumber {
+        enum Kind { FINITE, INFINITE, NOT_A_NUMBER };
+        Kind        kind;
+        bool        negative;
+        bool        truncated;
+        uint64_t    mantissa;
+        int         exponent;
+        const char* digits;             //尾数（含小数点）的起止位置，精确比较时重新读取
+        const char* digitsEnd;
+        int         explicitExponent;   //'e'之后的指数
+    };
+
+    //浮点格式：mantissaBits不含隐含位，指数都是最低位的二进制指数
+    struct FloatFormat {
+        int mantissaBits;
+        int exponentBits;
+        int minExponent;
+        int maxExponent;
+        int minDecimal;                 //w×10^q在q小于它时舍入为0
+        int maxDecimal;                 //q大于它时溢出为无穷
+    };
+
+    static const FloatFormat DOUBLE_FORMAT = { 52, 11, -1074, 971, -342, 308 };
+    static const FloatFormat FLOAT_FORMAT = { 23, 8, -149, 104, -64, 38 };
+
+    //指数和数字个数在此处饱和，两者相加不会溢出
+    static const int EXPONENT_LIMIT = 1 << 29;
+
+    static inline bool IsDigit( char c )
+    {
+        return (unsigned)( c - '0' ) < 10;
+    }
+
+    static inline bool EqualNoCase( const char* p, const char* lower, int n )
+    {
+        for ( int i = 0; i < n; ++i ) {
+            if ( ( p[i] | 0x20 ) != lower[i] ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //跳过末尾空白后必须到达字符串结尾
+    static inline bool AtEnd( const char* p )
+    {
+        while ( XMLUtil::IsWhiteSpace( *p ) ) {
+            ++p;
+        }
+        return *p == 0;
+    }
+
+    //十进制整数，magnitude为绝对值；超过limit（负数为negativeLimit）时失败
+    static bool ParseInteger( const char* str, uint64_t limit, uint64_t negativeLimit, uint64_t* magnitude, bool* negative )
+    {
+        const char* p = str;
+        while ( XMLUtil::IsWhiteSpace( *p ) ) {
+            ++p;
+        }
+        *negative = false;
+        if ( *p == '-' || *p == '+' ) {
+            *negative = ( *p == '-' );
+            ++p;
+        }
+        if ( !IsDigit( *p ) ) {
+            return false;
+        }
+        const uint64_t max = *negative ? negativeLimit : limit;
+        uint64_t v = 0;
+        for ( ; IsDigit( *p ); ++p ) {
+            const unsigned digit = *p - '0';
+            if ( v > max / 10 || ( v == max / 10 && digit > max % 10 ) ) {
+                return false;
+            }
+            v = v * 10 + digit;
+        }
+        *magnitude = v;
+        return AtEnd( p );
+    }
+
+    static const char* ParseDecimal( const char* p, DecimalNumber* num )
+    {
+        num->kind = DecimalNumber::FINITE;
+        num->negative = false;
+        num->truncated = false;
+        num->mantissa = 0;
+        num->exponent = 0;
+        num->explicitExponent = 0;
+        if ( *p == '-' || *p == '+' ) {
+            num->negative = ( *p == '-' );
+            ++p;
+        }
+        //ToStr()写出的inf和nan也能读回
+        if ( EqualNoCase( p, "inf", 3 ) ) {
+            num->kind = DecimalNumber::INFINITE;
+            return EqualNoCase( p, "infinity", 8 ) ? p + 8 : p + 3;
+        }
+        if ( EqualNoCase( p, "nan", 3 ) ) {
+            num->kind = DecimalNumber::NOT_A_NUMBER;
+            return p + 3;
+        }
+
+        num->digits = p;
+        //前导0不计入有效数字
+        const char* cur = p;
+        while ( *cur == '0' ) {
+            ++cur;
+        }
+        const char* first = cur;
+        uint64_t w = 0;
+        while ( IsDigit( *cur ) ) {
+            w = w * 10 + ( *cur - '0' );
+            ++cur;
+        }
+        ptrdiff_t nDigits = cur - first;
+        ptrdiff_t fraction = 0;
+        if ( *cur == '.' ) {
+            const char* dot = cur++;
+            if ( nDigits == 0 ) {
+                while ( *cur == '0' ) {
+                    ++cur;
+                }
+                first = cur;
+            }
+            const char* digits = cur;
+            while ( IsDigit( *cur ) ) {
+                w = w * 10 + ( *cur - '0' );
+                ++cur;
+            }
+            nDigits += cur - digits;
+            fraction = cur - dot - 1;
+            //没有数字
+            if ( cur - p == 1 ) {
+                return 0;
+            }
+        }
+        else if ( cur == p ) {
+            return 0;
+        }
+        //超过19位时只取前19位，w在上面可能已经溢出
+        if ( nDigits > 19 ) {
+            w = 0;
+            int taken = 0;
+            for ( const char* d = first; d < cur; ++d ) {
+                if ( *d == '.' ) {
+                    continue;
+                }
+                if ( taken < 19 ) {
+                    w = w * 10 + ( *d - '0' );
+                    ++taken;
+                }
+                else if ( *d != '0' ) {
+                    num->truncated = true;
+                    break;
+                }
+            }
+            fraction -= nDigits - 19;
+        }
+        if ( fraction > EXPONENT_LIMIT ) {
+            fraction = EXPONENT_LIMIT;
+        }
+        else if ( fraction < -EXPONENT_LIMIT ) {
+            fraction = -EXPONENT_LIMIT;
+        }
+        const int exponent = -(int)fraction;
+        p = cur;
+        num->digitsEnd = p;
+        //指数部分，'e'之后必须有数字
+        if ( *p == 'e' || *p == 'E' ) {
+            ++p;
+            bool negativeExponent = false;
+            if ( *p == '-' || *p == '+' ) {
+                negativeExponent = ( *p == '-' );
+                ++p;
+            }
+            if ( !IsDigit( *p ) ) {
+                return 0;
+            }
+            int e = 0;
+            for ( ; IsDigit( *p ); ++p ) {
+                if ( e < EXPONENT_LIMIT / 10 ) {
+                    e = e * 10 + ( *p - '0' );
+                }
+            }
+            num->explicitExponent = negativeExponent ? -e : e;
+        }
+        num->mantissa = w;
+        num->exponent = exponent + num->explicitExponent;
+        return p;
+    }
+
+    static inline void Multiply64( uint64_t a, uint64_t b, uint64_t* hi, uint64_t* lo )
+    {
+#if defined(__SIZEOF_INT128__)
+        //__int128不是标准类型，__extension__避免-Wpedantic警告
+        __extension__ typedef unsigned __int128 Uint128;
+        const Uint128 r = (Uint128)a * b;
+        *hi = (uint64_t)( r >> 64 );
+        *lo = (uint64_t)r;
+#else
+        const uint64_t aLo = a & 0xffffffffU, aHi = a >> 32;
+        const uint64_t bLo = b & 0xffffffffU, bHi = b >> 32;
+        const uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+        const uint64_t mid = ( ll >> 32 ) + ( lh & 0xffffffffU ) + ( hl & 0xffffffffU );
+        *lo = ( mid << 32 ) | ( ll & 0xffffffffU );
+        *hi = hh + ( lh >> 32 ) + ( hl >> 32 ) + ( mid >> 32 );
+#endif
+    }
+
+    static inline int LeadingZeros64( uint64_t v )
+    {
+        TIXMLASSERT( v );
+#if defined(__GNUC__)
+        return __builtin_clzll( v );
+#else
+        int n = 0;
+        while ( !( v & ( (uint64_t)1 << 63 ) ) ) {
+            v <<= 1;
+            ++n;
+        }
+        return n;
+#endif
+    }
+
+    //floor(log2(5^q))
+    static inline int FloorLog2Pow5( int q )
+    {
+        return q >= 0 ? ( q * 152170 ) >> 16 : -( ( -q * 152170 + 65535 ) >> 16 );
+    }
+
+    //5^(27k)的最高128位（k=-13..12），其余的幂再乘以5^j（j<27）
+    static const uint64_t POW5_BASE[26][2] = {
+        { 0x8049a4ac0c5811aeULL, 0x205b896d777d6278ULL },   // 5^-351
+        { 0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL },   // 5^-324
+        { 0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL },   // 5^-297
+        { 0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL },   // 5^-270
+        { 0xda7f5bf590966848ULL, 0xaf39a475506a899eULL },   // 5^-243
+        { 0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL },   // 5^-216
+        { 0x8e938662882af53eULL, 0x547eb47b7282ee9cULL },   // 5^-189
+        { 0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL },   // 5^-162
+        { 0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL },   // 5^-135
+        { 0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL },   // 5^-108
+        { 0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL },   // 5^-81
+        { 0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL },   // 5^-54
+        { 0x9e74d1b791e07e48ULL, 0x775ea264cf55347dULL },   // 5^-27
+        { 0x8000000000000000ULL, 0x0000000000000000ULL },   // 5^0
+        { 0xcecb8f27f4200f3aULL, 0x0000000000000000ULL },   // 5^27
+        { 0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL },   // 5^54
+        { 0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL },   // 5^81
+        { 0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL },   // 5^108
+        { 0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL },   // 5^135
+        { 0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL },   // 5^162
+        { 0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL },   // 5^189
+        { 0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL },   // 5^216
+        { 0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL },   // 5^243
+        { 0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL },   // 5^270
+        { 0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL },   // 5^297
+        { 0x9e19db92b4e31ba9ULL, 0x6c07a2c26a8346d1ULL },   // 5^324
+    };
+
+    static const uint64_t POW5_SMALL[27] = {
+        1ULL, 5ULL, 25ULL, 125ULL, 625ULL, 3125ULL, 15625ULL, 78125ULL, 390625ULL,
+        1953125ULL, 9765625ULL, 48828125ULL, 244140625ULL, 1220703125ULL, 6103515625ULL,
+        30517578125ULL, 152587890625ULL, 762939453125ULL, 3814697265625ULL, 19073486328125ULL,
+        95367431640625ULL, 476837158203125ULL, 2384185791015625ULL, 11920928955078125ULL,
+        59604644775390625ULL, 298023223876953125ULL, 1490116119384765625ULL
+    };
+
+    //5^q的最高128位T，5^q = T*×2^(FloorLog2Pow5(q)-127)，T <= T* < T+3；0<=q<=55时相等
+    static void Pow5Significand( int q, uint64_t* hi, uint64_t* lo )
+    {
+        TIXMLASSERT( q >= -351 && q < 351 );
+        const int k = ( q + 351 ) / 27;
+        const int j = ( q + 351 ) % 27;
+        *hi = POW5_BASE[k][0];
+        *lo = POW5_BASE[k][1];
+        if ( j == 0 ) {
+            return;
+        }
+        uint64_t a1, a0, b1, b0;
+        Multiply64( *lo, POW5_SMALL[j], &a1, &a0 );
+        Multiply64( *hi, POW5_SMALL[j], &b1, &b0 );
+        const uint64_t x1 = a1 + b0;
+        const uint64_t x2 = b1 + ( x1 < a1 );
+        const int s = FloorLog2Pow5( q ) - FloorLog2Pow5( q - j );
+        TIXMLASSERT( s > 0 && s < 64 );
+        *hi = ( x2 << ( 64 - s ) ) | ( x1 >> s );
+        *lo = ( x1 << ( 64 - s ) ) | ( a0 >> s );
+    }
+
+    //192位整数从第from位开始的64位，超出192位的部分为0
+    static inline uint64_t Bits192( const uint64_t* p, int from )
+    {
+        const int word = from >> 6;
+        const int bit = from & 63;
+        if ( word >= 3 ) {
+            return 0;
+        }
+        uint64_t v = p[word] >> bit;
+        if ( bit && word < 2 ) {
+            v |= p[word + 1] << ( 64 - bit );
+        }
+        return v;
+    }
+
+    //[from, to)位是否全为1（ones）或全为0
+    static bool AllBits192( const uint64_t* p, int from, int to, bool ones )
+    {
+        if ( ones && to > 192 ) {
+            return false;
+        }
+        for ( int word = 0; word < 3; ++word ) {
+            const int lo = from > word * 64 ? from - word * 64 : 0;
+            const int hi = to < word * 64 + 64 ? to - word * 64 : 64;
+            if ( lo >= hi ) {
+                continue;
+            }
+            const uint64_t mask = ( hi - lo == 64 ? ~(uint64_t)0 : ( ( (uint64_t)1 << ( hi - lo ) ) - 1 ) ) << lo;
+            if ( ( p[word] & mask ) != ( ones ? mask : 0 ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //w×10^q舍入到格式f，结果为mantissa×2^exponent；返回false时乘积的误差可能影响舍入，
+    //此时结果不大于正确值，且最多相差几个最低位
+    static bool ComputeBinary( uint64_t w, int q, const FloatFormat& f, uint64_t* mantissa, int* exponent )
+    {
+        TIXMLASSERT( w );
+        TIXMLASSERT( q >= f.minDecimal && q <= f.maxDecimal );
+        const int lz = LeadingZeros64( w );
+        w <<= lz;
+        uint64_t hi, lo;
+        Pow5Significand( q, &hi, &lo );
+        const bool exact = q >= 0 && q <= 55;
+        //P = w×T，P* = w×T*，P <= P* < P + 3×2^64
+        uint64_t a1, a0, b1, b0, p[3];
+        Multiply64( w, lo, &a1, &a0 );
+        Multiply64( w, hi, &b1, &b0 );
+        p[0] = a0;
+        p[1] = a1 + b0;
+        p[2] = b1 + ( p[1] < a1 );
+        //P的第i位的权为2^(i+scale)
+        const int scale = q + FloorLog2Pow5( q ) - 127 - lz;
+        const int top = 191 - LeadingZeros64( p[2] );
+        int e = top - f.mantissaBits + scale;
+        if ( e < f.minExponent ) {
+            e = f.minExponent;
+        }
+        const int r = e - scale;            //结果最低位在P中的位置
+        TIXMLASSERT( r > 66 );
+        *mantissa = Bits192( p, r );
+        *exponent = e;
+        //低64位加上误差可能向上进位，进位穿过舍入位以下的各位时无法确定
+        if ( !exact && AllBits192( p, 66, r - 1, true ) ) {
+            return false;
+        }
+        const bool roundBit = ( Bits192( p, r - 1 ) & 1 ) != 0;
+        if ( roundBit ) {
+            //正好在中间时舍入到偶数，只有T精确时才可能
+            const bool halfway = exact && AllBits192( p, 0, r - 1, false );
+            if ( !halfway || ( *mantissa & 1 ) ) {
+                ++*mantissa;
+                if ( *mantissa == (uint64_t)2 << f.mantissaBits ) {
+                    *mantissa >>= 1;
+                    ++*exponent;
+                }
+            }
+        }
+        return true;
+    }
+
+    //精确比较用的大整数，32位一节，低位在前
+    struct BigNumber {
+        enum { CAPACITY = 128 };
+        uint32_t    limbs[CAPACITY];
+        int         size;
+
+        explicit BigNumber( uint64_t v ) : size( 0 ) {
+            while ( v ) {
+                limbs[size++] = (uint32_t)v;
+                v >>= 32;
+            }
+        }
+
+        void MultiplyAdd( uint32_t m, uint32_t add ) {
+            uint64_t carry = add;
+            for ( int i = 0; i < size; ++i ) {
+                carry += (uint64_t)limbs[i] * m;
+                limbs[i] = (uint32_t)carry;
+                carry >>= 32;
+            }
+            if ( carry ) {
+                TIXMLASSERT( size < CAPACITY );
+                if ( size < CAPACITY ) {
+                    limbs[size++] = (uint32_t)carry;
+                }
+            }
+        }
+
+        void MultiplyPow5( int e ) {
+            for ( ; e >= 13; e -= 13 ) {
+                MultiplyAdd( 1220703125U, 0 );
+            }
+            if ( e ) {
+                MultiplyAdd( (uint32_t)POW5_SMALL[e], 0 );
+            }
+        }
+
+        void ShiftLeft( int bits ) {
+            if ( !size || !bits ) {
+                return;
+            }
+            const int words = bits >> 5;
+            const int shift = bits & 31;
+            TIXMLASSERT( size + words < CAPACITY );
+            if ( size + words >= CAPACITY ) {
+                return;
+            }
+            limbs[size + words] = 0;
+            for ( int i = size - 1; i >= 0; --i ) {
+                const uint64_t v = (uint64_t)limbs[i] << shift;
+                limbs[i + words + 1] |= (uint32_t)( v >> 32 );
+                limbs[i + words] = (uint32_t)v;
+            }
+            for ( int i = 0; i < words; ++i ) {
+                limbs[i] = 0;
+            }
+            size += words + 1;
+            while ( size && !limbs[size - 1] ) {
+                --size;
+            }
+        }
+
+        int Compare( const BigNumber& other ) const {
+            if ( size != other.size ) {
+                return size < other.size ? -1 : 1;
+            }
+            for ( int i = size - 1; i >= 0; --i ) {
+                if ( limbs[i] != other.limbs[i] ) {
+                    return limbs[i] < other.limbs[i] ? -1 : 1;
+                }
+            }
+            return 0;
+        }
+    };
+
+    //只读入这么多位有效数字，之后的数字只记录是否全为0；
+    //两个相邻浮点数的中点最多有767位有效数字，多余的数字不影响比较结果
+    static const int MAX_EXACT_DIGITS = 800;
+
+    //用全部数字精确决定舍入：从不大于正确值的mantissa×2^exponent开始，
+    //数值超过与下一个浮点数的中点时加一
+    static void RoundExact( const DecimalNumber& num, const FloatFormat& f, uint64_t* mantissa, int* exponent )
+    {
+        BigNumber digits( 0 );
+        int nDigits = 0;
+        int fraction = 0;
+        int dropped = 0;
+        bool sticky = false;
+        bool inFraction = false;
+        uint32_t chunk = 0;
+        int chunkDigits = 0;
+        for ( const char* p = num.digits; p < num.digitsEnd; ++p ) {
+            if ( *p == '.' ) {
+                inFraction = true;
+                continue;
+            }
+            const unsigned digit = *p - '0';
+            if ( nDigits == 0 && digit == 0 ) {
+                fraction += inFraction;
+                continue;
+            }
+            if ( nDigits < MAX_EXACT_DIGITS ) {
+                chunk = chunk * 10 + digit;
+                if ( ++chunkDigits == 9 ) {
+                    digits.MultiplyAdd( 1000000000U, chunk );
+                    chunk = 0;
+                    chunkDigits = 0;
+                }
+                ++nDigits;
+                fraction += inFraction;
+            }
+            else {
+                dropped += !inFraction;
+                sticky |= ( digit != 0 );
+            }
+        }
+        if ( chunkDigits ) {
+            digits.MultiplyAdd( (uint32_t)POW5_SMALL[chunkDigits] << chunkDigits, chunk );
+        }
+        const int e10 = num.explicitExponent - fraction + dropped;
+
+        while ( *exponent <= f.maxExponent ) {
+            //中点 (2m+1)×2^(exponent-1) 与 digits×10^e10 比较
+            BigNumber value( digits );
+            BigNumber halfway( ( *mantissa << 1 ) | 1 );
+            if ( e10 >= 0 ) {
+                value.MultiplyPow5( e10 );
+            }
+            else {
+                halfway.MultiplyPow5( -e10 );
+            }
+            const int shift = e10 - ( *exponent - 1 );
+            if ( shift >= 0 ) {
+                value.ShiftLeft( shift );
+            }
+            else {
+                halfway.ShiftLeft( -shift );
+            }
+            int cmp = value.Compare( halfway );
+            if ( cmp == 0 && sticky ) {
+                cmp = 1;
+            }
+            if ( cmp < 0 || ( cmp == 0 && !( *mantissa & 1 ) ) ) {
+                return;
+            }
+            ++*mantissa;
+            if ( *mantissa == (uint64_t)2 << f.mantissaBits ) {
+                *mantissa >>= 1;
+                ++*exponent;
+            }
+            if ( cmp == 0 ) {
+                return;
+            }
+        }
+    }
+
+    //按格式f编码，返回的位与同宽度的浮点数相同
+    static uint64_t EncodeFloat( bool negative, uint64_t mantissa, int exponent, const FloatFormat& f )
+    {
+        const uint64_t hidden = (uint64_t)1 << f.mantissaBits;
+        const uint64_t maxField = ( (uint64_t)1 << f.exponentBits ) - 1;
+        uint64_t bits = 0;
+        if ( exponent > f.maxExponent ) {
+            bits = maxField << f.mantissaBits;
+        }
+        else if ( mantissa >= hidden ) {
+            bits = ( (uint64_t)( exponent - f.minExponent + 1 ) << f.mantissaBits ) | ( mantissa - hidden );
+        }
+        else {
+            //非规格化数和0
+            bits = mantissa;
+        }
+        if ( negative ) {
+            bits |= (uint64_t)1 << ( f.mantissaBits + f.exponentBits );
+        }
+        return bits;
+    }
+
+    static uint64_t DecimalToBinary( const DecimalNumber& num, const FloatFormat& f )
+    {
+        if ( num.kind == DecimalNumber::INFINITE ) {
+            return EncodeFloat( num.negative, 0, f.maxExponent + 1, f );
+        }
+        if ( num.kind == DecimalNumber::NOT_A_NUMBER ) {
+            const uint64_t maxField = ( (uint64_t)1 << f.exponentBits ) - 1;
+            return ( maxField << f.mantissaBits ) | ( (uint64_t)1 << ( f.mantissaBits - 1 ) );
+        }
+        if ( num.mantissa == 0 || num.exponent < f.minDecimal ) {
+            return EncodeFloat( num.negative, 0, f.minExponent, f );
+        }
+        if ( num.exponent > f.maxDecimal ) {
+            return EncodeFloat( num.negative, 0, f.maxExponent + 1, f );
+        }
+        uint64_t mantissa;
+        int exponent;
+        bool known = ComputeBinary( num.mantissa, num.exponent, f, &mantissa, &exponent );
+        //截断时真值在w×10^q与(w+1)×10^q之间，两端舍入结果相同时就是它
+        if ( known && num.truncated ) {
+            uint64_t upperMantissa;
+            int upperExponent;
+            known = ComputeBinary( num.mantissa + 1, num.exponent, f, &upperMantissa, &upperExponent )
+                    && upperMantissa == mantissa && upperExponent == exponent;
+        }
+        if ( !known ) {
+            RoundExact( num, f, &mantissa, &exponent );
+        }
+        return EncodeFloat( num.negative, mantissa, exponent, f );
+    }
+
+    //整个字符串（前后空白除外）是一个十进制浮点数
+    static bool ParseFloatString( const char* str, DecimalNumber* num )
+    {
+        const char* p = str;
+        while ( XMLUtil::IsWhiteSpace( *p ) ) {
+            ++p;
+        }
+        p = ParseDecimal( p, num );
+        return p && AtEnd( p );
+    }
+
+#ifdef TIXML_EXACT_FLOAT_ARITHMETIC
+    //10^0..10^22都能用double精确表示，10^0..10^10都能用float精确表示
+    static const double DOUBLE_POW10[23] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    static const float FLOAT_POW10[11] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+    };
+#endif
+
+    //数值输出：整数每次查表写两位；浮点数输出能读回原值的最短十进制数，
+    //同样位数的取最接近原值的。四舍五入区间的两端和原值都除以10^q换算成整数部分不超过19位的定点数，
+    //再去掉末尾的数字直到区间内不再有更短的数；定点数误差可能影响整数部分时用大整数精确求出
+
+    static const char DIGIT_PAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    static const uint64_t POW10[20] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+        1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+        100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+        1000000000000000000ULL, 10000000000000000000ULL
+    };
+
+    //从end向前写v的十进制数字，返回第一个数字的位置
+    static char* FormatDigits( uint64_t v, char* end )
+    {
+        char* p = end;
+        while ( v >= 100 ) {
+            const unsigned pair = (unsigned)( v % 100 ) * 2;
+            v /= 100;
+            *--p = DIGIT_PAIRS[pair + 1];
+            *--p = DIGIT_PAIRS[pair];
+        }
+        if ( v >= 10 ) {
+            *--p = DIGIT_PAIRS[v * 2 + 1];
+            *--p = DIGIT_PAIRS[v * 2];
+        }
+        else {
+            *--p = (char)( '0' + v );
+        }
+        return p;
+    }
+
+    //按bufferSize截断复制，与snprintf一样总是以'\0'结尾
+    static void CopyNumber( const char* str, int len, char* buffer, int bufferSize )
+    {
+        if ( bufferSize <= 0 ) {
+            return;
+        }
+        if ( len >= bufferSize ) {
+            len = bufferSize - 1;
+        }
+        memcpy( buffer, str, len );
+        buffer[len] = 0;
+    }
+
+    static void FormatInteger( bool negative, uint64_t magnitude, char* buffer, int bufferSize )
+    {
+        char digits[24];
+        char* end = digits + sizeof( digits );
+        char* p = FormatDigits( magnitude, end );
+        if ( negative ) {
+            *--p = '-';
+        }
+        CopyNumber( p, (int)( end - p ), buffer, bufferSize );
+    }
+
+    //floor(log10(2^t))
+    static inline int FloorLog10Pow2( int t )
+    {
+        return t >= 0 ? ( t * 78913 ) >> 18 : -( ( -t * 78913 + 262143 ) >> 18 );
+    }
+
+    //x×2^e/10^q的整数部分和是否正好是整数。multiplier是5^(-q)的最高128位，shift使整数部分落在第shift位之上
+    static uint64_t ScaleToDecimal( uint64_t x, int e, int q, uint64_t hi, uint64_t lo, int shift, bool* isInteger )
+    {
+        uint64_t a1, a0, b1, b0, p[3];
+        Multiply64( x, lo, &a1, &a0 );
+        Multiply64( x, hi, &b1, &b0 );
+        p[0] = a0;
+        p[1] = a1 + b0;
+        p[2] = b1 + ( p[1] < a1 );
+        const uint64_t floor = Bits192( p, shift );
+        //乘数比5^(-q)小不到3，乘积小不到3x < 2^57；小数部分不在[0, 2^57)之外的末端时整数部分和结果都确定
+        if ( !AllBits192( p, 57, shift, true ) && !AllBits192( p, 0, shift, false ) ) {
+            *isInteger = false;
+            return floor;
+        }
+        //与floor+1和floor精确比较：x×2^e 对 n×5^q×2^q
+        for ( int delta = 1; delta >= 0; --delta ) {
+            BigNumber value( x );
+            BigNumber bound( floor + delta );
+            if ( q >= 0 ) {
+                bound.MultiplyPow5( q );
+            }
+            else {
+                value.MultiplyPow5( -q );
+            }
+            if ( e >= q ) {
+                value.ShiftLeft( e - q );
+            }
+            else {
+                bound.ShiftLeft( q - e );
+            }
+            const int cmp = value.Compare( bound );
+            if ( cmp >= 0 ) {
+                *isInteger = ( cmp == 0 );
+                return floor + delta;
+            }
+        }
+        TIXMLASSERT( false );
+        *isInteger = false;
+        return floor;
+    }
+
+    //最短的十进制数写入out，返回长度；与printf的%g一样，10^precision以上或10^-4以下的数用指数形式
+    static int FormatShortest( uint64_t bits, const FloatFormat& f, int precision, char* out )
+    {
+        char* p = out;
+        if ( bits >> ( f.mantissaBits + f.exponentBits ) ) {
+            *p++ = '-';
+        }
+        const uint64_t maxField = ( (uint64_t)1 << f.exponentBits ) - 1;
+        const uint64_t field = ( bits >> f.mantissaBits ) & maxField;
+        const uint64_t fraction = bits & ( ( (uint64_t)1 << f.mantissaBits ) - 1 );
+        if ( field == maxField ) {
+            memcpy( p, fraction ? "nan" : "inf", 3 );
+            return (int)( p - out ) + 3;
+        }
+        if ( field == 0 && fraction == 0 ) {
+            *p++ = '0';
+            return (int)( p - out );
+        }
+        const uint64_t m2 = field ? ( fraction | ( (uint64_t)1 << f.mantissaBits ) ) : fraction;
+        const int e2 = field ? (int)field - 1 + f.minExponent : f.minExponent;
+        //区间[lower, upper]×2^e：相邻浮点数的中点，2的幂下方的间隔只有一半
+        const int e = e2 - 2;
+        const uint64_t value = m2 << 2;
+        const uint64_t upper = value + 2;
+        const uint64_t lower = value - ( ( fraction == 0 && field > 1 ) ? 1 : 2 );
+        //区间宽度至少是upper的2^-(mantissaBits+2)，upper换算后不少于digits位时区间里至少有十几个整数
+        const int digits = precision + 1;
+        const int q = FloorLog10Pow2( 63 - LeadingZeros64( upper ) + e ) - ( digits - 1 );
+        uint64_t hi, lo;
+        Pow5Significand( -q, &hi, &lo );
+        const int shift = 127 - FloorLog2Pow5( -q ) + q - e;
+        bool lowerExact, valueExact, upperExact;
+        uint64_t a = ScaleToDecimal( lower, e, q, hi, lo, shift, &lowerExact );
+        const uint64_t v = ScaleToDecimal( value, e, q, hi, lo, shift, &valueExact );
+        uint64_t b = ScaleToDecimal( upper, e, q, hi, lo, shift, &upperExact );
+        //尾数为偶数时中点读回来舍入到它，区间包含两端
+        const bool even = ( m2 & 1 ) == 0;
+        if ( !lowerExact || !even ) {
+            ++a;
+        }
+        if ( upperExact && !even ) {
+            --b;
+        }
+        TIXMLASSERT( a <= b );
+        //去掉末尾数字，直到区间内没有更短的数
+        int removed = 0;
+        while ( b / 10 >= ( a + 9 ) / 10 ) {
+            a = ( a + 9 ) / 10;
+            b /= 10;
+            ++removed;
+        }
+        TIXMLASSERT( removed > 0 && removed < 20 );
+        //取最接近原值的，正好在中间时取偶数
+        const uint64_t unit = POW10[removed];
+        uint64_t d = v / unit;
+        const uint64_t rest = v % unit;
+        if ( rest > unit / 2 || ( rest == unit / 2 && ( !valueExact || ( d & 1 ) ) ) ) {
+            ++d;
+        }
+        if ( d < a ) {
+            d = a;
+        }
+        else if ( d > b ) {
+            d = b;
+        }
+        int exponent = q + removed;
+        while ( d % 10 == 0 ) {
+            d /= 10;
+            ++exponent;
+        }
+
+        char buffer[24];
+        char* end = buffer + sizeof( buffer );
+        const char* first = FormatDigits( d, end );
+        const int n = (int)( end - first );
+        const int point = exponent + n - 1;     //第一位数字的十进制指数
+        if ( point < -4 || point >= precision ) {
+            //d.ddde±XX，与printf的%g一样指数至少两位
+            *p++ = first[0];
+            if ( n > 1 ) {
+                *p++ = '.';
+                memcpy( p, first + 1, n - 1 );
+                p += n - 1;
+            }
+            *p++ = 'e';
+            *p++ = point < 0 ? '-' : '+';
+            const int absPoint = point < 0 ? -point : point;
+            if ( absPoint < 10 ) {
+                *p++ = '0';
+            }
+            char exp[8];
+            char* expEnd = exp + sizeof( exp );
+            const char* expFirst = FormatDigits( absPoint, expEnd );
+            memcpy( p, expFirst, expEnd - expFirst );
+            p += expEnd - expFirst;
+        }
+        else if ( point < 0 ) {
+            *p++ = '0';
+            *p++ = '.';
+            for ( int i = -1; i > point; --i ) {
+                *p++ = '0';
+            }
+            memcpy( p, first, n );
+            p += n;
+        }
+        else if ( n <= point + 1 ) {
+            memcpy( p, first, n );
+            p += n;
+            for ( int i = n; i <= point; ++i ) {
+                *p++ = '0';
+            }
+        }
+        else {
+            memcpy( p, first, point + 1 );
+            p += point + 1;
+            *p++ = '.';
+            memcpy( p, first + point + 1, n - point - 1 );
+            p += n - point - 1;
+        }
+        return (int)( p - out );
+    }
+
+    void XMLUtil::ToStr( int v, char* buffer, int bufferSize )
+    {
+        const uint64_t magnitude = v < 0 ? (uint64_t)-(int64_t)v : (uint64_t)v;
+        FormatInteger( v < 0, magnitude, buffer, bufferSize );
+    }
+
+
+    void XMLUtil::ToStr( unsigned v, char* buffer, int bufferSize )
+    {
+        FormatInteger( false, v, buffer, bufferSize );
+    }
+
+
+    void XMLUtil::ToStr( bool v, char* buffer, int bufferSize )
+    {
+        TIXML_SNPRINTF( buffer, bufferSize, "%s", v ? writeBoolTrue : writeBoolFalse);
+    }
+
+    void XMLUtil::ToStr( float v, char* buffer, int bufferSize )
+    {
+        uint32_t bits;
+        memcpy( &bits, &v, sizeof( bits ) );
+        char str[32];
+        const int len = FormatShortest( bits, FLOAT_FORMAT, 9, str );
+        CopyNumber( str, len, buffer, bufferSize );
+    }
+
+
+    void XMLUtil::ToStr( double v, char* buffer, int bufferSize )
+    {
+        uint64_t bits;
+        memcpy( &bits, &v, sizeof( bits ) );
+        char str[40];
+        const int len = FormatShortest( bits, DOUBLE_FORMAT, 17, str );
+        CopyNumber( str, len, buffer, bufferSize );
+    }
+
+
+    void XMLUtil::ToStr(int64_t v, char* buffer, int bufferSize)
+    {
+        //-2^63不能直接取反
+        const uint64_t magnitude = v < 0 ? (uint64_t)-( v + 1 ) + 1 : (uint64_t)v;
+        FormatInteger( v < 0, magnitude, buffer, bufferSize );
+    }
+
+    bool XMLUtil::ToInt( const char* str, int* value )
+    {
+        uint64_t magnitude;
+        bool negative;
+        if ( !ParseInteger( str, INT_MAX, (uint64_t)INT_MAX + 1, &magnitude, &negative ) ) {
+            return false;
+        }
+        *value = negative ? (int)( -(int64_t)magnitude ) : (int)magnitude;
+        return true;
+    }
+
+    bool XMLUtil::ToUnsigned( const char* str, unsigned *value )
+    {
+        uint64_t magnitude;
+        bool negative;
+        //只接受"-0"这一个负号
+        if ( !ParseInteger( str, UINT_MAX, 0, &magnitude, &negative ) ) {
+            return false;
+        }
+        *value = (unsigned)magnitude;
+        return true;
+    }
+
+    bool XMLUtil::ToBool( const char* str, bool* value )
+    {
+        int ival = 0;
+        if ( ToInt( str, &ival )) {
+            *value = (ival==0) ? false : true;
+            return true;
+        }
+        if ( StringEqual( str, "true" ) ) {
+            *value = true;
+            return true;
+        }
+        else if ( StringEqual( str, "false" ) ) {
+            *value = false;
+            return true;
+        }
+        return false;
+    }
+
+
+    bool XMLUtil::ToFloat( const char* str, float* value )
+    {
+        DecimalNumber num;
+        if ( !ParseFloatString( str, &num ) ) {
+            return false;
+        }
+#ifdef TIXML_EXACT_FLOAT_ARITHMETIC
+        //w和10^|q|都能精确表示时一次运算就是正确舍入的结果
+        if ( num.kind == DecimalNumber::FINITE && !num.truncated && num.mantissa <= ( 1U << 24 )
+            && num.exponent >= -10 && num.exponent <= 10 ) {
+            float f = (float)num.mantissa;
+            f = num.exponent < 0 ? f / FLOAT_POW10[-num.exponent] : f * FLOAT_POW10[num.exponent];
+            *value = num.negative ? -f : f;
+            return true;
+        }
+#endif
+        const uint32_t bits = (uint32_t)DecimalToBinary( num, FLOAT_FORMAT );
+        memcpy( value, &bits, sizeof( *value ) );
+        return true;
+    }
+
+
+    bool XMLUtil::ToDouble( const char* str, double* value )
+    {
+        DecimalNumber num;
+        if ( !ParseFloatString( str, &num ) ) {
+            return false;
+        }
+#ifdef TIXML_EXACT_FLOAT_ARITHMETIC
+        if ( num.kind == DecimalNumber::FINITE && !num.truncated && num.mantissa <= ( (uint64_t)1 << 53 )
+            && num.exponent >= -22 && num.exponent <= 22 ) {
+            double d = (double)num.mantissa;
+            d = num.exponent < 0 ? d / DOUBLE_POW10[-num.exponent] : d * DOUBLE_POW10[num.exponent];
+            *value = num.negative ? -d : d;
+            return true;
+        }
+#endif
+        const uint64_t bits = DecimalToBinary( num, DOUBLE_FORMAT );
+        memcpy( value, &bits, sizeof( *value ) );
+        return true;
+    }
+
+
+    bool XMLUtil::ToInt64(const char* str, int64_t* value)
+    {
+        uint64_t magnitude;
+        bool negative;
+        if ( !ParseInteger( str, 0x7fffffffffffffffULL, 0x8000000000000000ULL, &magnitude, &negative ) ) {
+            return false;
+        }
+        //-2^63不能先转换成正数
+        *value = ( negative && magnitude ) ? -(int64_t)( magnitude - 1 ) - 1 : (int64_t)magnitude;
+        return true;
+    }
+
+    void XMLNode::Unlink( XMLNode* child )
+    {
+        //判断节点是否存在
+        TIXMLASSERT( child );
+        TIXMLASSERT( child->_document == _document );
+        TIXMLASSERT( child->_parent == this );
+        XMLChildIndex* index = ChildIndex();
+        if ( index && child->ToElement() ) {
+            index->Remove( child->ToElement() );
+        }
+        //重新链接孩子节点，_firstChild指向下一个节点
+        if ( child == _firstChild ) {
+            _firstChild = _firstChild->_next;
+        }
+        //_firstChild指向上一个节点
+        if ( child == _lastChild ) {
+            _lastChild = _lastChild->_prev;
+        }
+        //child指向下一个节点
+        if ( child->_prev ) {
+            child->_prev->_next = child->_next;
+        }
+        //child指向上一个节点
+        if ( child->_next ) {
+            child->_next->_prev = child->_prev;
+        }
+        //清空节点
+        child->_next = 0;
+        child->_prev = 0;
+        child->_parent = 0;
+    }
+
+
+    void XMLNode::DeleteNode( XMLNode* node )
+    {
+        //如果节点为空返回
+        if ( node == 0 ) {
+            return;
+        }
+        TIXMLASSERT(node->_document);
+        //检查节点是否有值
+        if (!node->ToDocument()) {
+          node->_document->MarkInUse(node);
+      }
+        //析构前断开，子元素索引中的记录需要按元素删除
+        if ( node->_parent ) {
+            node->_parent->Unlink( node );
+        }
+
+        //单调模式下不析构，内存在Clear()时整块释放
+        if ( node->_document->_monotonic ) {
+            return;
+        }
+        //释放节点
+        MemPool* pool = node->_memPool;
+        node->~XMLNode();
+        pool->Free( node );
+    }
+
+    //解析器自己的临时节点（结束标签、流式解析中回调过的节点）不论是否单调模式都立即归还内存池
+    void XMLNode::FreeNode( XMLNode* node )
+    {
+        if ( node == 0 ) {
+            return;
+        }
+        XMLDocument* doc = node->_document;
+        if ( !doc->_monotonic ) {
+            DeleteNode( node );
+            return;
+        }
+        TIXMLASSERT( !node->_parent );
+        doc->MarkInUse( node );
+        XMLElement* element = node->ToElement();
+        if ( element ) {
+            element->FreeAttributes();
+            //索引随元素一起删除，登记作废
+            if ( element->_attributeIndex || element->_childIndex ) {
+                for ( XMLDocument::IndexedElement* r = doc->_indexedElements; r; r = r->next ) {
+                    if ( r->element == element ) {
+                        r->element = 0;
+                    }
+                }
+            }
+        }
+        //子节点在单调模式下只是断开
+        MemPool* pool = node->_memPool;
+        node->~XMLNode();
+        pool->Free( node );
+    }
+
+    void XMLNode::InsertChildPreamble( XMLNode* insertThis ) const
+    {
+        TIXMLASSERT( insertThis );
+        TIXMLASSERT( insertThis->_document == _document );
+        //断开链接
+        if (insertThis->_parent) {
+            insertThis->_parent->Unlink( insertThis );
+        }
+        //跟踪
+        else {
+          insertThis->_document->MarkInUse(insertThis);
+          insertThis->_memPool->SetTracked();
+        }
+    }
+
+    //空键不与任何元素同名
+    const XMLElement* XMLNode::ToElementWithName( XMLName name ) const
+    {
+        const XMLElement* element = this->ToElement();
+        if ( element == 0 || name.Empty() ) {
+            return 0;
+        }
+        //名称都在名称表中，比较指针即可
+        if ( element->Name() == name.Str() ) {
+           return element;
+       }
+       return 0;
+    }
+
+    //从node开始（包括node）沿兄弟链向后或向前找到的第一个元素
+    const XMLElement* XMLNode::FirstElement( const XMLNode* node, bool forward )
+    {
+        for( ; node; node = forward ? node->_next : node->_prev ) {
+            const XMLElement* element = node->ToElement();
+            if ( element ) {
+                return element;
+            }
+        }
+        return 0;
+    }
+
+    //已建立的子元素索引，没有时返回0
+    XMLChildIndex* XMLNode::ChildIndex() const
+    {
+        const XMLElement* element = ToElement();
+        if ( element && element->_childIndex && element->_childIndex->Valid() ) {
+            return element->_childIndex;
+        }
+        return 0;
+    }
+
+    //为元素建立子元素索引，文档节点不建立，返回0
+    XMLChildIndex* XMLNode::BuildChildIndex() const
+    {
+        const XMLElement* element = ToElement();
+        if ( !element ) {
+            return 0;
+        }
+        if ( !element->_childIndex ) {
+            element->_childIndex = new XMLChildIndex( &_document->_indexBytes );
+            if ( _document->_monotonic ) {
+                _document->RegisterIndex( element );
+            }
+        }
+        element->_childIndex->Build( this );
+        return element->_childIndex;
+    }
+
+    XMLNode::XMLNode( XMLDocument* doc ) :
+    _document( doc ),
+    _parent( 0 ),
+    _value(),
+    _parseLineNum( 0 ),
+    _unlinkedIndex( -1 ),
+    _firstChild( 0 ), _lastChild( 0 ),
+    _prev( 0 ), _next( 0 ),
+    _userData( 0 ),
+    _memPool( 0 )
+    {
+    }
+
+
+    XMLNode::~XMLNode()
+    {
+        DeleteChildren();
+        if ( _parent ) {
+            _parent->Unlink( this );
+        }
+    }
+
+    const char* XMLNode::Value() const
+    {
+        // XMLDocuments 没有值,返回null。
+        if ( this->ToDocument() )
+            return 0;
+        return _value.GetStr();
+    }
+
+
+    void XMLNode::SetValue( const char* str, bool staticMem )
+    {   
+        //元素名保存在名称表中
+        if ( ToElement() ) {
+            const char* name = _document->InternName( str ).Str();
+            if ( !name ) {
+                return;
+            }
+            _value.SetInternedStr( name );
+            //改名后父元素的索引失效
+            XMLChildIndex* index = _parent ? _parent->ChildIndex() : 0;
+            if ( index ) {
+                index->Clear();
+            }
+        }
+        //以插入方式
+        else if ( staticMem ) {
+            _value.SetInternedStr( str );
+        }
+        //复制到文档的分配区
+        else {
+            _value.SetStr( str, 0, &_document->_strings );
+        }
+    }
+
+    const XMLElement* XMLNode::PreviousSiblingElement( const char* name ) const
+    {
+        if ( !name ) {
+            return FirstElement( _prev, false );
+        }
+        return PreviousSiblingElement( _document->FindName( name ) );
+    }
+
+    const XMLElement* XMLNode::PreviousSiblingElement( XMLName name ) const
+    {
+        if ( name.Empty() ) {
+            return 0;
+        }
+        //与自己同名时，父元素的索引直接给出前一个
+        const XMLElement* self = ToElement();
+        if ( self && _parent && self->Name() == name.Str() ) {
+            const XMLChildIndex* index = _parent->ChildIndex();
+            if ( index ) {
+                return index->Previous( self );
+            }
+        }
+        for( const XMLNode* node = _prev; node; node = node->_prev ) {
+            const XMLElement* element = node->ToElementWithName( name );
+            if ( element ) {
+                return element;
+            }
+        }
+        return 0;
+    }
+
+    const XMLElement* XMLNode::FirstChildElement( const char* name ) const
+    {
+        if ( !name ) {
+            return FirstElement( _firstChild, true );
+        }
+        return FirstChildElement( _document->FindName( name ) );
+    }
+
+    const XMLElement* XMLNode::FirstChildElement( XMLName name ) const
+    {
+        if ( name.Empty() ) {
+            return 0;
+        }
+        const XMLChildIndex* index = ChildIndex();
+        if ( index ) {
+            return index->First( name.Str() );
+        }
+        //遍历节点，找到第一个元素
+        int count = 0;
+        for( const XMLNode* node = _firstChild; node; node = node->_next ) {
+            const XMLElement* element = node->ToElementWithName( name );
+            if ( element ) {
+                return element;
+            }
+            //子节点较多时建立索引，之后的查找不再遍历
+            if ( ++count == TINYXML2_CHILD_INDEX_MIN ) {
+                index = BuildChildIndex();
+                if ( index ) {
+                    return index->First( name.Str() );
+                }
+            }
+        }
+        return 0;
+    }
+
+    const XMLElement* XMLNode::LastChildElement( const char* name ) const
+    {
+        if ( !name ) {
+            return FirstElement( _lastChild, false );
+        }
+        return LastChildElement( _document->FindName( name ) );
+    }
+
+    const XMLElement* XMLNode::LastChildElement( XMLName name ) const
+    {
+        if ( name.Empty() ) {
+            return 0;
+        }
+        const XMLChildIndex* index = ChildIndex();
+        if ( index ) {
+            return index->Last( name.Str() );
+        }
+        //遍历，从最后一个节点开始
+        int count = 0;
+        for( const XMLNode* node = _lastChild; node; node = node->_prev ) {
+            const XMLElement* element = node->ToElementWithName( name );
+            if ( element ) {
+                return element;
+            }
+            if ( ++count == TINYXML2_CHILD_INDEX_MIN ) {
+                index = BuildChildIndex();
+                if ( index ) {
+                    return index->Last( name.Str() );
+                }
+            }
+        }
+        return 0;
+    }
+
+    const XMLElement* XMLNode::NextSiblingElement( const char* name ) const
+    {
+        if ( !name ) {
+            return FirstElement( _next, true );
+        }
+        return NextSiblingElement( _document->FindName( name ) );
+    }
+
+    const XMLElement* XMLNode::NextSiblingElement( XMLName name ) const
+    {
+        if ( name.Empty() ) {
+            return 0;
+        }
+        const XMLElement* self = ToElement();
+        if ( self && _parent && self->Name() == name.Str() ) {
+            const XMLChildIndex* index = _parent->ChildIndex();
+            if ( index ) {
+                return index->Next( self );
+            }
+        }
+        for( const XMLNode* node = _next; node; node = node->_next ) {
+            const XMLElement* element = node->ToElementWithName( name );
+            if ( element ) {
+                return element;
+            }
+        }
+        return 0;
+    }
+
+
+    XMLNode* XMLNode::InsertEndChild( XMLNode* addThis )
+    {
+        TIXMLASSERT( addThis );
+        if ( addThis->_document != _document ) {
+            TIXMLASSERT( false );
+            return 0;
+        }
+        //准备插入
+        InsertChildPreamble( addThis );
+        //添加
+        if ( _lastChild ) {
+            TIXMLASSERT( _firstChild );
+            TIXMLASSERT( _lastChild->_next == 0 );
+            _lastChild->_next = addThis;
+            addThis->_prev = _lastChild;
+            _lastChild = addThis;
+
+            addThis->_next = 0;
+        }
+        //（右）子节点就是（左）子节点
+        else {
+            TIXMLASSERT( _firstChild == 0 );
+            _firstChild = _lastChild = addThis;
+
+            addThis->_prev = 0;
+            addThis->_next = 0;
+        }
+        addThis->_parent = this;
+        XMLChildIndex* index = ChildIndex();
+        if ( index && addThis->ToElement() ) {
+            index->Append( addThis->ToElement() );
+        }
+        return addThis;
+    }
+
+    XMLNode* XMLNode::InsertFirstChild( XMLNode* addThis )
+    {
+        TIXMLASSERT( addThis );
+        if ( addThis->_document != _document ) {
+            TIXMLASSERT( false );
+            return 0;
+        }
+        InsertChildPreamble( addThis );
+
+        if ( _firstChild ) {
+            TIXMLASSERT( _lastChild );
+            TIXMLASSERT( _firstChild->_prev == 0 );
+
+            _firstChild->_prev = addThis;
+            addThis->_next = _firstChild;
+            _firstChild = addThis;
+
+            addThis->_prev = 0;
+        }
+        else {
+            TIXMLASSERT( _lastChild == 0 );
+            _firstChild = _lastChild = addThis;
+
+            addThis->_prev = 0;
+            addThis->_next = 0;
+        }
+        addThis->_parent = this;
+        XMLChildIndex* index = ChildIndex();
+        if ( index && addThis->ToElement() ) {
+            index->Prepend( addThis->ToElement() );
+        }
+        return addThis;
+    }
+
+    XMLNode* XMLNode::InsertAfterChild( XMLNode* afterThis, XMLNode* addThis )
+    {
+        TIXMLASSERT( addThis );
+        if ( addThis->_document != _document ) {
+            TIXMLASSERT( false );
+            return 0;
+        }
+
+        TIXMLASSERT( afterThis );
+
+        if ( afterThis->_parent != this ) {
+            TIXMLASSERT( false );
+            return 0;
+        }
+        if ( afterThis == addThis ) {
+            return addThis;
+        }
+
+        if ( afterThis->_next == 0 ) {
+            //最后一个节点或唯一节点。
+            return InsertEndChild( addThis );
+        }
+        //插入准备
+        InsertChildPreamble( addThis );
+        //插入
+        addThis->_prev = afterThis;
+        addThis->_next = afterThis->_next;
+        afterThis->_next->_prev = addThis;
+        afterThis->_next = addThis;
+        addThis->_parent = this;
+        //插在中间时要找同名的前一个元素，不如让索引下次查找时重建
+        XMLChildIndex* index = ChildIndex();
+        if ( index && addThis->ToElement() ) {
+            index->Clear();
+        }
+        return addThis;
+    }
+
+    void XMLNode::DeleteChild( XMLNode* node )
+    {
+        TIXMLASSERT( node );
+        TIXMLASSERT( node->_document == _document );
+        TIXMLASSERT( node->_parent == this );
+        Unlink( node );
+        TIXMLASSERT(node->_prev == 0);
+        TIXMLASSERT(node->_next == 0);
+        TIXMLASSERT(node->_parent == 0);
+        DeleteNode( node );
+    }
+
+    void XMLNode::DeleteChildren()
+    {
+        XMLChildIndex* index = ChildIndex();
+        if ( index ) {
+            index->Clear();
+        }
+        //单调模式下删除不做任何事，整个子树直接断开；文档析构时已清空，不再访问文档
+        if ( _firstChild && _document->_monotonic ) {
+            _firstChild = _lastChild = 0;
+            return;
+        }
+        //先下到叶子节点再逐个删除，深层的树也不会递归
+        XMLNode* node = this;
+        while( node ) {
+            XMLNode* child = node->_firstChild;
+            if ( !child ) {
+                node = ( node == this ) ? 0 : node->_parent;
+            }
+            else if ( child->_firstChild ) {
+                node = child;
+            }
+            else {
+                TIXMLASSERT( node->_lastChild );
+                node->DeleteChild( child );
+            }
+        }
+        _firstChild = _lastChild = 0;
+    }
+
+    XMLNode* XMLNode::DeepClone(XMLDocument* target) const
+    {
+        XMLNode* clone = this->ShallowClone(target);
+        if (!clone) return 0;
+        //利用递归遍历
+        for (const XMLNode* child = this->FirstChild(); child; child = child->NextSibling()) {
+            XMLNode* childClone = child->DeepClone(target);
+            //内存不足，放弃已复制的部分
+            if (!childClone) {
+                clone->GetDocument()->DeleteNode(clone);
+                return 0;
+            }
+            clone->InsertEndChild(childClone);
+        }
+        return clone;
+    }
+
+    char* XMLText::ParseDeep( char* p, StrPair*, int* curLineNumPtr )
+    {
+        //如果为CData型，则以”]]>“作为结尾标志解析
+        if ( this->CData() ) {
+            p = _value.ParseText( p, "]]>", StrPair::NEEDS_NEWLINE_NORMALIZATION, curLineNumPtr );
+            //错误
+            if ( !p ) {
+                _document->SetError( XML_ERROR_PARSING_CDATA, _parseLineNum, 0 );
+            }
+            return p;
+        }
+        //如果不是，则按照正常规则解析
+        else {
+            int flags = _document->ProcessEntities() ? StrPair::TEXT_ELEMENT : StrPair::TEXT_ELEMENT_LEAVE_ENTITIES;
+            if ( _document->WhitespaceMode() == COLLAPSE_WHITESPACE ) {
+                flags |= StrPair::NEEDS_WHITESPACE_COLLAPSING;
+            }
+            //以“<”作为结束标志
+            p = _value.ParseText( p, "<", flags, curLineNumPtr );
+            //-1，去掉“<”
+            if ( p && *p ) {
+                return p-1;
+            }
+            //错误
+            if ( !p ) {
+                _document->SetError( XML_ERROR_PARSING_TEXT, _parseLineNum, 0 );
+            }
+        }
+        return 0;
+    }
+
+    bool XMLText::Accept( XMLVisitor* visitor ) const
+    {
+        TIXMLASSERT( visitor );
+        return visitor->Visit( *this );
+    }
+
+    XMLNode* XMLText::ShallowClone( XMLDocument* doc ) const
+    {
+        if ( !doc ) {
+            doc = _document;
+        }
+        //复制到text
+        XMLText* text = doc->NewText( Value() );
+        if ( text ) {
+            text->SetCData( this->CData() );
+        }
+        return text;
+    }
+
+    bool XMLText::ShallowEqual( const XMLNode* compare ) const
+    {
+        TIXMLASSERT( compare );
+        const XMLText* text = compare->ToText();
+        return ( text && XMLUtil::StringEqual( text->Value(), Value() ) );
+    }
+
+    char* XMLComment::ParseDeep( char* p, StrPair*, int* curLineNumPtr )
+    {
+        //以"-->"结尾标志解析
+        p = _value.ParseText( p, "-->", StrPair::COMMENT, curLineNumPtr );
+        if ( p == 0 ) {
+            _document->SetError( XML_ERROR_PARSING_COMMENT, _parseLineNum, 0 );
+        }
+        return p;
+    }
+
+    bool XMLComment::Accept( XMLVisitor* visitor ) const
+    {
+        TIXMLASSERT( visitor );
+        return visitor->Visit( *this );
+    }
+
+    XMLNode* XMLComment::ShallowClone( XMLDocument* doc ) const
+    {
+        if ( !doc ) {
+            doc = _document;
+        }
+        //复制到comment
+        XMLComment* comment = doc->NewComment( Value() );
+        return comment;
+    }
+
+    bool XMLComment::ShallowEqual( const XMLNode* compare ) const
+    {
+        TIXMLASSERT( compare );
+        const XMLComment* comment = compare->ToComment();
+        return ( comment && XMLUtil::StringEqual( comment->Value(), Value() ));
+    }
+
+    char* XMLDeclaration::ParseDeep( char* p, StrPair*, int* curLineNumPtr )
+    {
+        //以"?>"为结尾解析
+        p = _value.ParseText( p, "?>", StrPair::NEEDS_NEWLINE_NORMALIZATION, curLineNumPtr );
+        if ( p == 0 ) {
+            _document->SetError( XML_ERROR_PARSING_DECLARATION, _parseLineNum, 0 );
+        }
+        return p;
+    }
+
+    bool XMLDeclaration::Accept( XMLVisitor* visitor ) const
+    {
+        TIXMLASSERT( visitor );
+        return visitor->Visit( *this );
+    }
+
+    XMLNode* XMLDeclaration::ShallowClone( XMLDocument* doc ) const
+    {
+        if ( !doc ) {
+            doc = _document;
+        }
+        //复制到dec
+        XMLDeclaration* dec = doc->NewDeclaration( Value() );
+        return dec;
+    }
+
+    bool XMLDeclaration::ShallowEqual( const XMLNode* compare ) const
+    {
+        TIXMLASSERT( compare );
+        const XMLDeclaration* declaration = compare->ToDeclaration();
+        return ( declaration && XMLUtil::StringEqual( declaration->Value(), Value() ));
+    }
+
+    bool XMLUnknown::Accept( XMLVisitor* visitor ) const
+    {
+        TIXMLASSERT( visitor );
+        return visitor->Visit( *this );
+    }
+
+    char* XMLUnknown::ParseDeep( char* p, StrPair*, int* curLineNumPtr )
+    {
+        //以">"为结尾解析
+        p = _value.ParseText( p, ">", StrPair::NEEDS_NEWLINE_NORMALIZATION, curLineNumPtr );
+        if ( !p ) {
+            _document->SetError( XML_ERROR_PARSING_UNKNOWN, _parseLineNum, 0 );
+        }
+        return p;
+    }
+
+
+    XMLNode* XMLUnknown::ShallowClone( XMLDocument* doc ) const
+    {
+        if ( !doc ) {
+            doc = _document;
+        }
+        XMLUnknown* text = doc->NewUnknown( Value() );
+        return text;
+    }
+
+    bool XMLUnknown::ShallowEqual( const XMLNode* compare ) const
+    {
+        TIXMLASSERT( compare );
+        const XMLUnknown* unknown = compare->ToUnknown();
+        return ( unknown && XMLUtil::StringEqual( unknown->Value(), Value() ));
+    }
+
+    //n为名称表中的副本
+    void XMLAttribute::SetName( const char* n )
+    {
+        _name.SetInternedStr( n );
+    }
+
+    char* XMLAttribute::ParseDeep( char* p, bool processEntities, XMLNameTable* names, int* curLineNumPtr )
+    {
+        //调用字符串解析名称函数
+        p = _name.ParseName( p, names );
+        if ( !p || !*p ) {
+            return 0;
+        }
+
+        //忽略空白
+        p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+        if ( *p != '=' ) {
+            return 0;
+        }
+
+        //定位到文本开头
+        ++p;
+        p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+        //判断是否为双引号或者单引号开头
+        if ( *p != '\"' && *p != '\'' ) {
+            return 0;
+        }
+
+        //结束标志'\0'
+        char endTag[2] = { *p, 0 };
+        //定位到属性开头
+        ++p;
+
+        //解析
+        p = _value.ParseText( p, endTag, processEntities ? StrPair::ATTRIBUTE_VALUE : StrPair::ATTRIBUTE_VALUE_LEAVE_ENTITIES, curLineNumPtr );
+        return p;
+    }
+
+    const char* XMLAttribute::Name() const
+    {
+        return _name.GetStr();
+    }
+
+    const char* XMLAttribute::Value() const
+    {
+        return _value.GetStr();
+    }
+
+
+    XMLError XMLAttribute::QueryIntValue( int* value ) const
+    {
+        if ( XMLUtil::ToInt( Value(), value )) {
+            return XML_SUCCESS;
+        }
+        return XML_WRONG_ATTRIBUTE_TYPE;
+    }
+
+    XMLError XMLAttribute::QueryUnsignedValue( unsigned int* value ) const
+    {
+        if ( XMLUtil::ToUnsigned( Value(), value )) {
+            return XML_SUCCESS;
+        }
+        return XML_WRONG_ATTRIBUTE_TYPE;
+    }
+
+    XMLError XMLAttribute::QueryInt64Value(int64_t* value) const
+    {
+        if (XMLUtil::ToInt64(Value(), value)) {
+            return XML_SUCCESS;
+        }
+        return XML_WRONG_ATTRIBUTE_TYPE;
+    }
+
+    XMLError XMLAttribute::QueryBoolValue( bool* value ) const
+    {
+        if ( XMLUtil::ToBool( Value(), value )) {
+            return XML_SUCCESS;
+        }
+        return XML_WRONG_ATTRIBUTE_TYPE;
+    }
+
+    XMLError XMLAttribute::QueryFloatValue( float* value ) const
+    {
+        if ( XMLUtil::ToFloat( Value(), value )) {
+            return XML_SUCCESS;
+        }
+        return XML_WRONG_ATTRIBUTE_TYPE;
+    }
+
+    XMLError XMLAttribute::QueryDoubleValue( double* value ) const
+    {
+        if ( XMLUtil::ToDouble( Value(), value )) {
+            return XML_SUCCESS;
+        }
+        return XML_WRONG_ATTRIBUTE_TYPE;
+    }
+
+    void XMLAttribute::SetAttribute( const char* v )
+    {
+        _value.SetStr( v, 0, &_document->_strings );
+    }
+
+    void XMLAttribute::SetAttribute( int v )
+    {
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr( v, buf, BUF_SIZE );
+        _value.SetStr( buf, 0, &_document->_strings );
+    }
+
+    void XMLAttribute::SetAttribute( unsigned v )
+    {
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr( v, buf, BUF_SIZE );
+        _value.SetStr( buf, 0, &_document->_strings );
+    }
+
+    void XMLAttribute::SetAttribute(int64_t v)
+    {
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr(v, buf, BUF_SIZE);
+        _value.SetStr( buf, 0, &_document->_strings );
+    }
+
+
+    void XMLAttribute::SetAttribute( bool v )
+    {
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr( v, buf, BUF_SIZE );
+        _value.SetStr( buf, 0, &_document->_strings );
+    }
+
+    void XMLAttribute::SetAttribute( double v )
+    {
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr( v, buf, BUF_SIZE );
+        _value.SetStr( buf, 0, &_document->_strings );
+    }
+
+    void XMLAttribute::SetAttribute( float v )
+    {
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr( v, buf, BUF_SIZE );
+        _value.SetStr( buf, 0, &_document->_strings );
+    }
+
+
+    XMLElement::XMLElement( XMLDocument* doc ) : XMLNode( doc ),
+    _closingType( OPEN ),
+    _rootAttribute( 0 ),
+    _attributeIndex( 0 ),
+    _childIndex( 0 )
+    {
+    }
+
+
+    XMLElement::~XMLElement()
+    {
+        //释放节点
+        while( _rootAttribute ) {
+            XMLAttribute* next = _rootAttribute->_next;
+            DeleteAttribute( _rootAttribute );
+            _rootAttribute = next;
+        }
+        delete _attributeIndex;
+        //子节点在~XMLNode()中删除，那时已不再维护索引
+        delete _childIndex;
+        _childIndex = 0;
+    }
+
+    XMLAttribute* XMLElement::CreateAttribute()
+    {
+        //获取元素大小
+        TIXMLASSERT( sizeof( XMLAttribute ) == _document->_attributePool.ItemSize() );
+        //新建属性并申请内存，内存不足时返回0
+        void* mem = _document->_attributePool.Alloc();
+        if ( !mem ) {
+            return 0;
+        }
+        XMLAttribute* attrib = new (mem) XMLAttribute();
+        //初始化内存地址
+        attrib->_document = _document;
+        _document->_attributePool.SetTracked();
+        return attrib;
+    }
+
+    XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name, const char* value )
+    {
+        //初始化属性表
+        XMLAttribute* last = 0;
+        const char* interned = _document->InternName( name ).Str();
+        if ( !interned ) {
+            return 0;
+        }
+        //检查是否存在属性
+        XMLAttribute* attrib = LookupAttribute( interned, &last );
+        //已有的属性设置失败时保持原值
+        if ( attrib ) {
+            return attrib->_value.SetStr( value, 0, &_document->_strings ) ? attrib : 0;
+        }
+        //如果不存在下一个属性，则创建一个；名称和值都设置好之后再链接
+        attrib = CreateAttribute();
+        if ( !attrib ) {
+            return 0;
+        }
+        attrib->SetName( interned );
+        if ( !attrib->_value.SetStr( value, 0, &_document->_strings ) ) {
+            FreeAttribute( attrib );
+            return 0;
+        }
+        //如果当前属性存在，属性表链接新属性
+        if ( last ) {
+            TIXMLASSERT( last->_next == 0 );
+            last->_next = attrib;
+        }
+        //如果不存在，新属性为根属性
+        else {
+            TIXMLASSERT( _rootAttribute == 0 );
+            _rootAttribute = attrib;
+        }
+        //已建立的索引随之更新
+        if ( _attributeIndex && !_attributeIndex->Empty() ) {
+            _attributeIndex->Insert( attrib );
+        }
+        return attrib;
+    }
+
+    //查找名称为name的属性，name必须是名称表中的副本；找不到时last为属性表的末尾
+    //属性较多时建立索引，之后的查找不再遍历
+    XMLAttribute* XMLElement::LookupAttribute( const char* name, XMLAttribute** last ) const
+    {
+        if ( !_attributeIndex || _attributeIndex->Empty() ) {
+            int count = 0;
+            XMLAttribute* prev = 0;
+            XMLAttribute* a = _rootAttribute;
+            for( ; a && count < TINYXML2_ATTRIBUTE_INDEX_MIN; prev = a, a = a->_next, ++count ) {
+                if ( a->Name() == name ) {
+                    return a;
+                }
+            }
+            if ( !a ) {
+                *last = prev;
+                return 0;
+            }
+            if ( !_attributeIndex ) {
+                _attributeIndex = new XMLAttributeIndex( &_document->_indexBytes );
+                if ( _document->_monotonic ) {
+                    _document->RegisterIndex( this );
+                }
+            }
+            _attributeIndex->Build( _rootAttribute );
+        }
+        XMLAttribute* attrib = _attributeIndex->Find( name );
+        if ( !attrib ) {
+            *last = _attributeIndex->Last();
+        }
+        return attrib;
+    }
+
+    void XMLElement::DeleteAttribute( XMLAttribute* attribute )
+    {
+        if ( attribute == 0 ) {
+            return;
+        }
+        if ( attribute->_document->_monotonic ) {
+            return;
+        }
+        FreeAttribute( attribute );
+    }
+
+    //单调模式下~XMLElement()不释放属性，由这里直接归还内存池
+    void XMLElement::FreeAttributes()
+    {
+        while( _rootAttribute ) {
+            XMLAttribute* next = _rootAttribute->_next;
+            FreeAttribute( _rootAttribute );
+            _rootAttribute = next;
+        }
+    }
+
+    void XMLElement::FreeAttribute( XMLAttribute* attribute )
+    {
+        MemPool* pool = &attribute->_document->_attributePool;
+        //调用析构函数
+        attribute->~XMLAttribute();
+        //释放内存
+        pool->Free( attribute );
+    }
+
+    char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
+    {
+        XMLAttribute* prevAttribute = 0;
+        int count = 0;
+        //属性较多时用文档的索引检查重复，不为每个元素分配内存
+        XMLAttributeIndex& index = _document->_attributeIndex;
+
+        //解析
+        while( p ) {
+            //跳过空白
+            p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+            //如果字符为空，报错
+            if ( !(*p) ) {
+                _document->SetError( XML_ERROR_PARSING_ELEMENT, _parseLineNum, "XMLElement name=%s", Name() );
+                return 0;
+            }
+
+            //解析属性
+            if (XMLUtil::IsNameStartChar( *p ) ) {
+                XMLAttribute* attrib = CreateAttribute();
+                if ( !attrib ) {
+                    return 0;
+                }
+                //获取文档行号
+                attrib->_parseLineNum = _document->_parseCurLineNum;
+                int attrLineNum = attrib->_parseLineNum;
+                //深度解析本行内容
+                p = attrib->ParseDeep( p, _document->ProcessEntities(), &_document->_names, curLineNumPtr );
+                bool duplicate = false;
+                if ( p ) {
+                    if ( count < TINYXML2_ATTRIBUTE_INDEX_MIN ) {
+                        for( XMLAttribute* a = _rootAttribute; a && !duplicate; a = a->_next ) {
+                            duplicate = ( a->Name() == attrib->Name() );
+                        }
+                    }
+                    else {
+                        if ( count == TINYXML2_ATTRIBUTE_INDEX_MIN ) {
+                            index.Build( _rootAttribute );
+                        }
+                        duplicate = !index.Insert( attrib );
+                    }
+                    ++count;
+                }
+                //如果字符为空或者存在属性，首先删除该属性并报错
+                if ( !p || duplicate ) {
+                    DeleteAttribute( attrib );
+                    _document->SetError( XML_ERROR_PARSING_ATTRIBUTE, attrLineNum, "XMLElement name=%s", Name() );
+                    return 0;
+                }
+                //如果存在上一个属性，则链接当前属性
+                if ( prevAttribute ) {
+                    TIXMLASSERT( prevAttribute->_next == 0 );
+                    prevAttribute->_next = attrib;
+                }
+                //否则，新属性为根属性
+                else {
+                    TIXMLASSERT( _rootAttribute == 0 );
+                    _rootAttribute = attrib;
+                }
+                prevAttribute = attrib;
+            }
+            //结束标志1
+            else if ( *p == '>' ) {
+                ++p;
+                break;
+            }
+            //结束标志2
+            else if ( *p == '/' && *(p+1) == '>' ) {
+                _closingType = CLOSED;
+                return p+2;
+            }
+            //其他情况则解析错误
+            else {
+                _document->SetError( XML_ERROR_PARSING_ELEMENT, _parseLineNum, 0 );
+                return 0;
+            }
+        }
+        return p;
+    }
 
-    XMLNode* XMLNode::InsertEndChild( XMLNode* addThis )
+    //只解析标签本身（名称和属性），子节点由XMLDocument::ParseStep()继续解析
+    char* XMLElement::ParseDeep( char* p, StrPair*, int* curLineNumPtr )
     {
-        TIXMLASSERT( addThis );
-        if ( addThis->_document != _document ) {
-            TIXMLASSERT( false );
-            return 0;
+        //读取元素
+        p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+
+        //设置结尾标志
+        if ( *p == '/' ) {
+            _closingType = CLOSING;
+            ++p;
         }
-        //准备插入
-        InsertChildPreamble( addThis );
-        //添加
-        if ( _lastChild ) {
-            TIXMLASSERT( _firstChild );
-            TIXMLASSERT( _lastChild->_next == 0 );
-            _lastChild->_next = addThis;
-            addThis->_prev = _lastChild;
-            _lastChild = addThis;
 
-            addThis->_next = 0;
+        //解析名称
+        p = _value.ParseName( p, &_document->_names );
+        if ( _value.Empty() ) {
+            return 0;
         }
-        //（右）子节点就是（左）子节点
-        else {
-            TIXMLASSERT( _firstChild == 0 );
-            _firstChild = _lastChild = addThis;
 
-            addThis->_prev = 0;
-            addThis->_next = 0;
+        //解析属性
+        return ParseAttributes( p, curLineNumPtr );
+    }
+
+    bool XMLElement::Accept( XMLVisitor* visitor ) const
+    {
+        TIXMLASSERT( visitor );
+        //进入访问者模式
+        if ( visitor->VisitEnter( *this, _rootAttribute ) ) {
+            for ( const XMLNode* node=FirstChild(); node; node=node->NextSibling() ) {
+                if ( !node->Accept( visitor ) ) {
+                    break;
+                }
+            }
         }
-        addThis->_parent = this;
-        return addThis;
+        //退出访问者模式
+        return visitor->VisitExit( *this );
     }
 
-    XMLNode* XMLNode::InsertFirstChild( XMLNode* addThis )
+    const char* XMLElement::Attribute( const char* name, const char* value ) const
     {
-        TIXMLASSERT( addThis );
-        if ( addThis->_document != _document ) {
-            TIXMLASSERT( false );
+        //查找属性
+        const XMLAttribute* a = FindAttribute( name );
+        if ( !a ) {
             return 0;
         }
-        InsertChildPreamble( addThis );
+        //返回值
+        if ( !value || XMLUtil::StringEqual( a->Value(), value )) {
+            return a->Value();
+        }
+        return 0;
+    }
 
-        if ( _firstChild ) {
-            TIXMLASSERT( _lastChild );
-            TIXMLASSERT( _firstChild->_prev == 0 );
+    int XMLElement::IntAttribute(const char* name, int defaultValue) const
+    {
+        int i = defaultValue;
+        QueryIntAttribute(name, &i);
+        return i;
+    }
 
-            _firstChild->_prev = addThis;
-            addThis->_next = _firstChild;
-            _firstChild = addThis;
+    unsigned XMLElement::UnsignedAttribute(const char* name, unsigned defaultValue) const
+    {
+        unsigned i = defaultValue;
+        QueryUnsignedAttribute(name, &i);
+        return i;
+    }
 
-            addThis->_prev = 0;
-        }
-        else {
-            TIXMLASSERT( _lastChild == 0 );
-            _firstChild = _lastChild = addThis;
+    int64_t XMLElement::Int64Attribute(const char* name, int64_t defaultValue) const
+    {
+        int64_t i = defaultValue;
+        QueryInt64Attribute(name, &i);
+        return i;
+    }
 
-            addThis->_prev = 0;
-            addThis->_next = 0;
-        }
-        addThis->_parent = this;
-        return addThis;
+    bool XMLElement::BoolAttribute(const char* name, bool defaultValue) const
+    {
+        bool b = defaultValue;
+        QueryBoolAttribute(name, &b);
+        return b;
     }
 
-    XMLNode* XMLNode::InsertAfterChild( XMLNode* afterThis, XMLNode* addThis )
+    double XMLElement::DoubleAttribute(const char* name, double defaultValue) const
     {
-        TIXMLASSERT( addThis );
-        if ( addThis->_document != _document ) {
-            TIXMLASSERT( false );
-            return 0;
-        }
+        double d = defaultValue;
+        QueryDoubleAttribute(name, &d);
+        return d;
+    }
 
-        TIXMLASSERT( afterThis );
+    float XMLElement::FloatAttribute(const char* name, float defaultValue) const
+    {
+        float f = defaultValue;
+        QueryFloatAttribute(name, &f);
+        return f;
+    }
 
-        if ( afterThis->_parent != this ) {
-            TIXMLASSERT( false );
-            return 0;
-        }
-        if ( afterThis == addThis ) {
-            return addThis;
+    void XMLElement::DeleteAttribute( const char* name )
+    {
+        //文档中没有这个名称时不会有同名的属性
+        const XMLName key = _document->FindName( name );
+        if ( key.Empty() ) {
+            return;
         }
-
-        if ( afterThis->_next == 0 ) {
-            //最后一个节点或唯一节点。
-            return InsertEndChild( addThis );
+        //prev接收属性表
+        XMLAttribute* prev = 0;
+        for( XMLAttribute* a=_rootAttribute; a; a=a->_next ) {
+            //找到属性并断开其链表指针
+            if ( a->Name() == key.Str() ) {
+                if ( prev ) {
+                    prev->_next = a->_next;
+                }
+                else {
+                    _rootAttribute = a->_next;
+                }
+                //索引下次查找时重建
+                if ( _attributeIndex ) {
+                    _attributeIndex->Clear();
+                }
+                //释放
+                DeleteAttribute( a );
+                break;
+            }
+            prev = a;
         }
-        //插入准备
-        InsertChildPreamble( addThis );
-        //插入
-        addThis->_prev = afterThis;
-        addThis->_next = afterThis->_next;
-        afterThis->_next->_prev = addThis;
-        afterThis->_next = addThis;
-        addThis->_parent = this;
-        return addThis;
     }
 
-    void XMLNode::DeleteChild( XMLNode* node )
+    const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
     {
-        TIXMLASSERT( node );
-        TIXMLASSERT( node->_document == _document );
-        TIXMLASSERT( node->_parent == this );
-        Unlink( node );
-        TIXMLASSERT(node->_prev == 0);
-        TIXMLASSERT(node->_next == 0);
-        TIXMLASSERT(node->_parent == 0);
-        DeleteNode( node );
+        return FindAttribute( _document->FindName( name ) );
     }
 
-    void XMLNode::DeleteChildren()
+    const XMLAttribute* XMLElement::FindAttribute( XMLName name ) const
     {
-        while( _firstChild ) {
-            TIXMLASSERT( _lastChild );
-            DeleteChild( _firstChild );
+        if ( name.Empty() ) {
+            return 0;
         }
-        _firstChild = _lastChild = 0;
+        //名称都在名称表中，比较指针即可
+        XMLAttribute* last = 0;
+        return LookupAttribute( name.Str(), &last );
     }
 
-    XMLNode* XMLNode::DeepClone(XMLDocument* target) const
+    const char* XMLElement::GetText() const
     {
-        XMLNode* clone = this->ShallowClone(target);
-        if (!clone) return 0;
-        //利用递归遍历
-        for (const XMLNode* child = this->FirstChild(); child; child = child->NextSibling()) {
-            XMLNode* childClone = child->DeepClone(target);
-            TIXMLASSERT(childClone);
-            clone->InsertEndChild(childClone);
+        if ( FirstChild() && FirstChild()->ToText() ) {
+            return FirstChild()->Value();
         }
-        return clone;
+        return 0;
     }
 
-    char* XMLText::ParseDeep( char* p, StrPair*, int* curLineNumPtr )
+    void XMLElement::SetText( const char* inText )
     {
-        //如果为CData型，则以”]]>“作为结尾标志解析
-        if ( this->CData() ) {
-            p = _value.ParseText( p, "]]>", StrPair::NEEDS_NEWLINE_NORMALIZATION, curLineNumPtr );
-            //错误
-            if ( !p ) {
-                _document->SetError( XML_ERROR_PARSING_CDATA, _parseLineNum, 0 );
-            }
-            return p;
-        }
-        //如果不是，则按照正常规则解析
+        //找到第一个子节点并重新设置值
+        if ( FirstChild() && FirstChild()->ToText() )
+            FirstChild()->SetValue( inText );
+        //直接插入
         else {
-            int flags = _document->ProcessEntities() ? StrPair::TEXT_ELEMENT : StrPair::TEXT_ELEMENT_LEAVE_ENTITIES;
-            if ( _document->WhitespaceMode() == COLLAPSE_WHITESPACE ) {
-                flags |= StrPair::NEEDS_WHITESPACE_COLLAPSING;
-            }
-            //以“<”作为结束标志
-            p = _value.ParseText( p, "<", flags, curLineNumPtr );
-            //-1，去掉“<”
-            if ( p && *p ) {
-                return p-1;
-            }
-            //错误
-            if ( !p ) {
-                _document->SetError( XML_ERROR_PARSING_TEXT, _parseLineNum, 0 );
+            XMLText* theText = GetDocument()->NewText( inText );
+            if ( theText ) {
+                InsertFirstChild( theText );
             }
         }
-        return 0;
     }
 
-    bool XMLText::Accept( XMLVisitor* visitor ) const
+
+    void XMLElement::SetText( int v )
+    {
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr( v, buf, BUF_SIZE );
+        SetText( buf );
+    }
+
+
+    void XMLElement::SetText( unsigned v )
     {
-        TIXMLASSERT( visitor );
-        return visitor->Visit( *this );
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr( v, buf, BUF_SIZE );
+        SetText( buf );
     }
 
-    XMLNode* XMLText::ShallowClone( XMLDocument* doc ) const
+
+    void XMLElement::SetText(int64_t v)
     {
-        if ( !doc ) {
-            doc = _document;
-        }
-        //复制到text
-        XMLText* text = doc->NewText( Value() );
-        text->SetCData( this->CData() );
-        return text;
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr(v, buf, BUF_SIZE);
+        SetText(buf);
     }
 
-    bool XMLText::ShallowEqual( const XMLNode* compare ) const
+
+    void XMLElement::SetText( bool v )
     {
-        TIXMLASSERT( compare );
-        const XMLText* text = compare->ToText();
-        return ( text && XMLUtil::StringEqual( text->Value(), Value() ) );
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr( v, buf, BUF_SIZE );
+        SetText( buf );
     }
 
-    char* XMLComment::ParseDeep( char* p, StrPair*, int* curLineNumPtr )
+
+    void XMLElement::SetText( float v )
     {
-        //以"-->"结尾标志解析
-        p = _value.ParseText( p, "-->", StrPair::COMMENT, curLineNumPtr );
-        if ( p == 0 ) {
-            _document->SetError( XML_ERROR_PARSING_COMMENT, _parseLineNum, 0 );
-        }
-        return p;
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr( v, buf, BUF_SIZE );
+        SetText( buf );
     }
 
-    bool XMLComment::Accept( XMLVisitor* visitor ) const
+
+    void XMLElement::SetText( double v )
     {
-        TIXMLASSERT( visitor );
-        return visitor->Visit( *this );
+        char buf[BUF_SIZE];
+        XMLUtil::ToStr( v, buf, BUF_SIZE );
+        SetText( buf );
     }
 
-    XMLNode* XMLComment::ShallowClone( XMLDocument* doc ) const
+    XMLError XMLElement::QueryIntText( int* ival ) const
     {
-        if ( !doc ) {
-            doc = _document;
+        if ( FirstChild() && FirstChild()->ToText() ) {
+            const char* t = FirstChild()->Value();
+            if ( XMLUtil::ToInt( t, ival ) ) {
+                return XML_SUCCESS;
+            }
+            return XML_CAN_NOT_CONVERT_TEXT;
         }
-        //复制到comment
-        XMLComment* comment = doc->NewComment( Value() );
-        return comment;
+        return XML_NO_TEXT_NODE;
     }
 
-    bool XMLComment::ShallowEqual( const XMLNode* compare ) const
+
+    XMLError XMLElement::QueryUnsignedText( unsigned* uval ) const
     {
-        TIXMLASSERT( compare );
-        const XMLComment* comment = compare->ToComment();
-        return ( comment && XMLUtil::StringEqual( comment->Value(), Value() ));
+        if ( FirstChild() && FirstChild()->ToText() ) {
+            const char* t = FirstChild()->Value();
+            if ( XMLUtil::ToUnsigned( t, uval ) ) {
+                return XML_SUCCESS;
+            }
+            return XML_CAN_NOT_CONVERT_TEXT;
+        }
+        return XML_NO_TEXT_NODE;
     }
 
-    char* XMLDeclaration::ParseDeep( char* p, StrPair*, int* curLineNumPtr )
+
+    XMLError XMLElement::QueryInt64Text(int64_t* ival) const
     {
-        //以"?>"为结尾解析
-        p = _value.ParseText( p, "?>", StrPair::NEEDS_NEWLINE_NORMALIZATION, curLineNumPtr );
-        if ( p == 0 ) {
-            _document->SetError( XML_ERROR_PARSING_DECLARATION, _parseLineNum, 0 );
+        if (FirstChild() && FirstChild()->ToText()) {
+            const char* t = FirstChild()->Value();
+            if (XMLUtil::ToInt64(t, ival)) {
+                return XML_SUCCESS;
+            }
+            return XML_CAN_NOT_CONVERT_TEXT;
         }
-        return p;
+        return XML_NO_TEXT_NODE;
     }
 
-    bool XMLDeclaration::Accept( XMLVisitor* visitor ) const
+
+    XMLError XMLElement::QueryBoolText( bool* bval ) const
     {
-        TIXMLASSERT( visitor );
-        return visitor->Visit( *this );
+        if ( FirstChild() && FirstChild()->ToText() ) {
+            const char* t = FirstChild()->Value();
+            if ( XMLUtil::ToBool( t, bval ) ) {
+                return XML_SUCCESS;
+            }
+            return XML_CAN_NOT_CONVERT_TEXT;
+        }
+        return XML_NO_TEXT_NODE;
     }
 
-    XMLNode* XMLDeclaration::ShallowClone( XMLDocument* doc ) const
+
+    XMLError XMLElement::QueryDoubleText( double* dval ) const
     {
-        if ( !doc ) {
-            doc = _document;
+        if ( FirstChild() && FirstChild()->ToText() ) {
+            const char* t = FirstChild()->Value();
+            if ( XMLUtil::ToDouble( t, dval ) ) {
+                return XML_SUCCESS;
+            }
+            return XML_CAN_NOT_CONVERT_TEXT;
         }
-        //复制到dec
-        XMLDeclaration* dec = doc->NewDeclaration( Value() );
-        return dec;
+        return XML_NO_TEXT_NODE;
     }
 
-    bool XMLDeclaration::ShallowEqual( const XMLNode* compare ) const
+
+    XMLError XMLElement::QueryFloatText( float* fval ) const
     {
-        TIXMLASSERT( compare );
-        const XMLDeclaration* declaration = compare->ToDeclaration();
-        return ( declaration && XMLUtil::StringEqual( declaration->Value(), Value() ));
+        if ( FirstChild() && FirstChild()->ToText() ) {
+            const char* t = FirstChild()->Value();
+            if ( XMLUtil::ToFloat( t, fval ) ) {
+                return XML_SUCCESS;
+            }
+            return XML_CAN_NOT_CONVERT_TEXT;
+        }
+        return XML_NO_TEXT_NODE;
     }
 
-    bool XMLUnknown::Accept( XMLVisitor* visitor ) const
+    int XMLElement::IntText(int defaultValue) const
     {
-        TIXMLASSERT( visitor );
-        return visitor->Visit( *this );
+        int i = defaultValue;
+        QueryIntText(&i);
+        return i;
     }
 
-    char* XMLUnknown::ParseDeep( char* p, StrPair*, int* curLineNumPtr )
+    unsigned XMLElement::UnsignedText(unsigned defaultValue) const
     {
-        //以">"为结尾解析
-        p = _value.ParseText( p, ">", StrPair::NEEDS_NEWLINE_NORMALIZATION, curLineNumPtr );
-        if ( !p ) {
-            _document->SetError( XML_ERROR_PARSING_UNKNOWN, _parseLineNum, 0 );
-        }
-        return p;
+        unsigned i = defaultValue;
+        QueryUnsignedText(&i);
+        return i;
     }
 
+    int64_t XMLElement::Int64Text(int64_t defaultValue) const
+    {
+        int64_t i = defaultValue;
+        QueryInt64Text(&i);
+        return i;
+    }
 
-    XMLNode* XMLUnknown::ShallowClone( XMLDocument* doc ) const
+    bool XMLElement::BoolText(bool defaultValue) const
     {
-        if ( !doc ) {
-            doc = _document;
-        }
-        XMLUnknown* text = doc->NewUnknown( Value() );
-        return text;
+        bool b = defaultValue;
+        QueryBoolText(&b);
+        return b;
     }
 
-    bool XMLUnknown::ShallowEqual( const XMLNode* compare ) const
+    double XMLElement::DoubleText(double defaultValue) const
     {
-        TIXMLASSERT( compare );
-        const XMLUnknown* unknown = compare->ToUnknown();
-        return ( unknown && XMLUtil::StringEqual( unknown->Value(), Value() ));
+        double d = defaultValue;
+        QueryDoubleText(&d);
+        return d;
     }
 
-    void XMLAttribute::SetName( const char* n )
+    float XMLElement::FloatText(float defaultValue) const
     {
-        _name.SetStr( n );
+        float f = defaultValue;
+        QueryFloatText(&f);
+        return f;
     }
 
-    char* XMLAttribute::ParseDeep( char* p, bool processEntities, int* curLineNumPtr )
+    XMLNode* XMLElement::ShallowClone( XMLDocument* doc ) const
     {
-        //调用字符串解析名称函数
-        p = _name.ParseName( p );
-        if ( !p || !*p ) {
-            return 0;
+        if ( !doc ) {
+            doc = _document;
         }
-
-        //忽略空白
-        p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
-        if ( *p != '=' ) {
+        //新建元素列表
+        XMLElement* element = doc->NewElement( Value() );
+        if ( !element ) {
             return 0;
         }
-
-        //定位到文本开头
-        ++p;
-        p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
-        //判断是否为双引号或者单引号开头
-        if ( *p != '\"' && *p != '\'' ) {
-            return 0;
+        //获取名称和值，内存不足时放弃整个元素
+        for( const XMLAttribute* a=FirstAttribute(); a; a=a->Next() ) {
+            if ( !element->FindOrCreateAttribute( a->Name(), a->Value() ) ) {
+                XMLNode::FreeNode( element );
+                return 0;
+            }
         }
+        return element;
+    }
 
-        //结束标志'\0'
-        char endTag[2] = { *p, 0 };
-        //定位到属性开头
-        ++p;
-
-        //解析
-        p = _value.ParseText( p, endTag, processEntities ? StrPair::ATTRIBUTE_VALUE : StrPair::ATTRIBUTE_VALUE_LEAVE_ENTITIES, curLineNumPtr );
-        return p;
+    bool XMLElement::ShallowEqual( const XMLNode* compare ) const
+    {
+        TIXMLASSERT( compare );
+        const XMLElement* other = compare->ToElement();
+        //如果compare不为空，比较名称
+        if ( other && XMLUtil::StringEqual( other->Name(), Name() )) {
+            const XMLAttribute* a=FirstAttribute();
+            const XMLAttribute* b=other->FirstAttribute();
+            //如果a和b都不为空
+            while ( a && b ) {
+                //比较属性值
+                if ( !XMLUtil::StringEqual( a->Value(), b->Value() ) ) {
+                    return false;
+                }
+                a = a->Next();
+                b = b->Next();
+            }
+            if ( a || b ) {
+                return false;
+            }
+            return true;
+        }
+        return false;
     }
 
-    const char* XMLAttribute::Name() const
+    //列表内容必须与'enum XMLError'匹配
+    const char* XMLDocument::_errorNames[XML_ERROR_COUNT] = {
+        "XML_SUCCESS",
+        "XML_NO_ATTRIBUTE",
+        "XML_WRONG_ATTRIBUTE_TYPE",
+        "XML_ERROR_FILE_NOT_FOUND",
+        "XML_ERROR_FILE_COULD_NOT_BE_OPENED",
+        "XML_ERROR_FILE_READ_ERROR",
+        "XML_ERROR_PARSING_ELEMENT",
+        "XML_ERROR_PARSING_ATTRIBUTE",
+        "XML_ERROR_PARSING_TEXT",
+        "XML_ERROR_PARSING_CDATA",
+        "XML_ERROR_PARSING_COMMENT",
+        "XML_ERROR_PARSING_DECLARATION",
+        "XML_ERROR_PARSING_UNKNOWN",
+        "XML_ERROR_EMPTY_DOCUMENT",
+        "XML_ERROR_MISMATCHED_ELEMENT",
+        "XML_ERROR_PARSING",
+        "XML_CAN_NOT_CONVERT_TEXT",
+        "XML_NO_TEXT_NODE",
+        "XML_ELEMENT_DEPTH_EXCEEDED",
+        "XML_ERROR_OUT_OF_MEMORY"
+    };
+
+    void XMLDocument::Parse()
     {
-        return _name.GetStr();
+        char* p = ParseProlog();
+        if ( !p ) {
+            return;
+        }
+        //用_openElements作为父节点栈循环解析，嵌套深度不受调用栈限制
+        ParseSpan( p, _charBuffer + _charBufferSize, true );
     }
 
-    const char* XMLAttribute::Value() const
+    //跳过_charBuffer开头的空白和BOM，返回第一个节点的位置，内容为空时报错并返回0
+    char* XMLDocument::ParseProlog()
     {
-        return _value.GetStr();
+        //判断释放存在节点
+        TIXMLASSERT( NoChildren() );
+        TIXMLASSERT( _charBuffer );
+        //从第一行开始
+        _parseCurLineNum = 1;
+        _parseLineNum = 1;
+        char* p = _charBuffer;
+        p = XMLUtil::SkipWhiteSpace( p, &_parseCurLineNum );
+        p = const_cast<char*>( XMLUtil::ReadBOM( p, &_writeBOM ) );
+        //判断解析内容是否为空
+        if ( !*p ) {
+            SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+            return 0;
+        }
+        return p;
     }
 
 
-    XMLError XMLAttribute::QueryIntValue( int* value ) const
+    void XMLDocument::SetError( XMLError error, int lineNum, const char* format, ... )
     {
-        if ( XMLUtil::ToInt( Value(), value )) {
-            return XML_SUCCESS;
+        TIXMLASSERT( error >= 0 && error < XML_ERROR_COUNT );
+        //内存不足之后的错误都是由它引起的，保留最初的错误
+        if ( _errorID == XML_ERROR_OUT_OF_MEMORY && error != XML_SUCCESS ) {
+            return;
         }
-        return XML_WRONG_ATTRIBUTE_TYPE;
-    }
+        //获取错误ID和行号
+        _errorID = error;
+        _errorLineNum = lineNum;
+        _errorStr.Reset();
 
-    XMLError XMLAttribute::QueryUnsignedValue( unsigned int* value ) const
-    {
-        if ( XMLUtil::ToUnsigned( Value(), value )) {
-            return XML_SUCCESS;
-        }
-        return XML_WRONG_ATTRIBUTE_TYPE;
-    }
+        //默认缓存空间
+        const size_t BUFFER_SIZE = 1000;
+        char buffer[BUFFER_SIZE];
 
-    XMLError XMLAttribute::QueryInt64Value(int64_t* value) const
-    {
-        if (XMLUtil::ToInt64(Value(), value)) {
-            return XML_SUCCESS;
-        }
-        return XML_WRONG_ATTRIBUTE_TYPE;
+        //打印错误
+        TIXMLASSERT(sizeof(error) <= sizeof(int));
+        TIXML_SNPRINTF(buffer, BUFFER_SIZE, "Error=%s ErrorID=%d (0x%x) Line number=%d", ErrorIDToName(error), int(error), int(error), lineNum);
+
+        //如果传入另外的参数，则将其转换为字符串黏贴在buffer后面
+        if (format) {
+          size_t len = strlen(buffer);
+          TIXML_SNPRINTF(buffer + len, BUFFER_SIZE - len, ": ");
+          len = strlen(buffer);
+
+          va_list va;
+          va_start(va, format);
+          TIXML_VSNPRINTF(buffer + len, BUFFER_SIZE - len, format, va);
+          va_end(va);
+      }
+      _errorStr.SetStr(buffer);
     }
 
-    XMLError XMLAttribute::QueryBoolValue( bool* value ) const
+    //new[]分配的缓存的释放函数
+    static void DeleteCharBuffer( char* buffer, size_t )
     {
-        if ( XMLUtil::ToBool( Value(), value )) {
-            return XML_SUCCESS;
-        }
-        return XML_WRONG_ATTRIBUTE_TYPE;
+        delete [] buffer;
     }
 
-    XMLError XMLAttribute::QueryFloatValue( float* value ) const
+    XMLRegionAllocator::XMLRegionAllocator( void* region, size_t size ) :
+        _region( static_cast<char*>( region ) ),
+        _size( region ? size : 0 ),
+        _used( 0 ),
+        _live( 0 )
     {
-        if ( XMLUtil::ToFloat( Value(), value )) {
-            return XML_SUCCESS;
-        }
-        return XML_WRONG_ATTRIBUTE_TYPE;
     }
 
-    XMLError XMLAttribute::QueryDoubleValue( double* value ) const
+    void* XMLRegionAllocator::Allocate( size_t size )
     {
-        if ( XMLUtil::ToDouble( Value(), value )) {
-            return XML_SUCCESS;
+        //按区域中的实际地址对齐
+        const size_t pad = ( ALIGN - reinterpret_cast<size_t>( _region + _used ) % ALIGN ) % ALIGN;
+        size = ( size + ALIGN - 1 ) & ~( (size_t)ALIGN - 1 );
+        if ( size > _size - _used || pad > _size - _used - size ) {
+            return 0;
         }
-        return XML_WRONG_ATTRIBUTE_TYPE;
+        char* mem = _region + _used + pad;
+        _used += pad + size;
+        _live += size;
+        return mem;
     }
 
-    void XMLAttribute::SetAttribute( const char* v )
+    void XMLRegionAllocator::Free( void* mem, size_t size )
     {
-        _value.SetStr( v );
+        size = ( size + ALIGN - 1 ) & ~( (size_t)ALIGN - 1 );
+        TIXMLASSERT( size <= _live );
+        _live -= size;
+        if ( _live == 0 ) {
+            _used = 0;
+        }
+        else if ( static_cast<char*>( mem ) + size == _region + _used ) {
+            _used -= size;
+        }
     }
 
-    void XMLAttribute::SetAttribute( int v )
+    void* XMLDocument::DocumentAllocator::Allocate( size_t size )
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr( v, buf, BUF_SIZE );
-        _value.SetStr( buf );
+        void* mem = target->Allocate( size );
+        if ( !mem ) {
+            document->SetError( XML_ERROR_OUT_OF_MEMORY, document->_parseCurLineNum, "%lu bytes", (unsigned long)size );
+        }
+        return mem;
     }
 
-    void XMLAttribute::SetAttribute( unsigned v )
+    void XMLDocument::DocumentAllocator::Free( void* mem, size_t size )
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr( v, buf, BUF_SIZE );
-        _value.SetStr( buf );
+        target->Free( mem, size );
     }
 
-    void XMLAttribute::SetAttribute(int64_t v)
+    XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode, XMLAllocator* allocator ) :
+    XMLNode( 0 ),
+    _writeBOM( false ),
+    _processEntities( processEntities ),
+    _monotonic( false ),
+    _allocator( allocator ),
+    _documentAllocator(),
+    _memory( 0 ),
+    _errorID(XML_SUCCESS),
+    _whitespaceMode( whitespaceMode ),
+    _errorStr(),
+    _errorLineNum( 0 ),
+    _charBuffer( 0 ),
+    _charBufferSize( 0 ),
+    _charBufferDeleter( 0 ),
+    _allocatedBuffer( 0 ),
+    _allocatedSize( 0 ),
+    _spareBuffer( 0 ),
+    _spareSize( 0 ),
+    _parseCurLineNum( 0 ),
+    _unlinked(),
+    _names(),
+    _indexedElements( 0 ),
+    _indexBytes( 0 ),
+    _pushState( PUSH_IDLE ),
+    _pushInputEnded( false ),
+    _pushStart( 0 ),
+    _pushScan( 0 ),
+    _pushQuote( 0 ),
+    _pushBuffer( 0 ),
+    _pushSize( 0 ),
+    _pushCapacity( 0 ),
+    _parseBlocks(),
+    _openElements(),
+    _openBlocks(),
+    _visitor( 0 ),
+    _visitSkip( INT_MAX ),
+    _parsePrologOnly( true ),
+    _elementPool(),
+    _attributePool(),
+    _textPool(),
+    _commentPool()
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr(v, buf, BUF_SIZE);
-        _value.SetStr(buf);
+        _document = this;
+        if ( _allocator ) {
+            _documentAllocator.document = this;
+            _documentAllocator.target = _allocator;
+            _memory = &_documentAllocator;
+            _names.SetAllocator( _memory );
+            _strings.SetAllocator( _memory );
+            _elementPool.SetAllocator( _memory );
+            _attributePool.SetAllocator( _memory );
+            _textPool.SetAllocator( _memory );
+            _commentPool.SetAllocator( _memory );
+        }
     }
 
 
-    void XMLAttribute::SetAttribute( bool v )
+    XMLDocument::~XMLDocument()
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr( v, buf, BUF_SIZE );
-        _value.SetStr( buf );
+        Clear();
     }
 
-    void XMLAttribute::SetAttribute( double v )
+    XMLError XMLDocument::Parse( const char* p, size_t len )
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr( v, buf, BUF_SIZE );
-        _value.SetStr( buf );
+        Reset();
+        //判断字符串长度
+        if ( len == 0 || !p || !*p ) {
+            SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+            return _errorID;
+        }
+        if ( len == (size_t)(-1) ) {
+            len = strlen( p );
+        }
+        //拷贝一份再原地解析，拷贝由文档负责释放
+        char* buffer = AllocBuffer( len+1 );
+        if ( !buffer ) {
+            return _errorID;
+        }
+        memcpy( buffer, p, len );
+        return ParseInSitu( buffer, len, DeleteCharBuffer );
     }
 
-    void XMLAttribute::SetAttribute( float v )
+    XMLError XMLDocument::ParseInSitu( char* xml, size_t len, BufferDeleter deleter )
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr( v, buf, BUF_SIZE );
-        _value.SetStr( buf );
+        if ( !AdoptBuffer( xml, len, deleter ) ) {
+            return _errorID;
+        }
+        //深度解析
+        Parse();
+        //如果报警，则清空内存池，块留给下次解析
+        if ( Error() ) {
+            DeleteChildren();
+            ReleaseIndexes();
+            ResetPools();
+        }
+        return _errorID;
     }
 
-
-    XMLElement::XMLElement( XMLDocument* doc ) : XMLNode( doc ),
-    _closingType( OPEN ),
-    _rootAttribute( 0 )
+    //清空文档并接管缓存，内容为空时报错并返回false
+    bool XMLDocument::AdoptBuffer( char* xml, size_t len, BufferDeleter deleter )
     {
+        Reset();
+        if ( !xml ) {
+            SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+            return false;
+        }
+        if ( len == (size_t)(-1) ) {
+            len = strlen( xml );
+        }
+        else {
+            xml[len] = 0;
+        }
+        //接管缓存，即使内容为空也由Clear()统一释放
+        TIXMLASSERT( _charBuffer == 0 );
+        _charBuffer = xml;
+        _charBufferSize = len;
+        _charBufferDeleter = deleter;
+        if ( len == 0 || !*xml ) {
+            SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+            return false;
+        }
+        return true;
     }
 
-
-    XMLElement::~XMLElement()
+    //在[p, end)中查找pattern，返回其后的位置，找不到返回0
+    static const char* FindPattern( const char* p, const char* end, const char* pattern, size_t len )
     {
-        //释放节点
-        while( _rootAttribute ) {
-            XMLAttribute* next = _rootAttribute->_next;
-            DeleteAttribute( _rootAttribute );
-            _rootAttribute = next;
+        while ( (size_t)( end - p ) >= len ) {
+            p = static_cast<const char*>( memchr( p, pattern[0], end - p - len + 1 ) );
+            if ( !p ) {
+                return 0;
+            }
+            if ( memcmp( p, pattern, len ) == 0 ) {
+                return p + len;
+            }
+            ++p;
         }
+        return 0;
     }
 
-    XMLAttribute* XMLElement::CreateAttribute()
+    //检查p是否以header开头：1为是，0为否，-1为数据不足无法判断
+    static int MatchHeader( const char* p, size_t avail, const char* header, size_t len )
     {
-        //获取元素大小
-        TIXMLASSERT( sizeof( XMLAttribute ) == _document->_attributePool.ItemSize() );
-        //新建属性并申请内存
-        XMLAttribute* attrib = new (_document->_attributePool.Alloc() ) XMLAttribute();
-        TIXMLASSERT( attrib );
-        //初始化内存地址
-        attrib->_memPool = &_document->_attributePool;
-        attrib->_memPool->SetTracked();
-        return attrib;
+        const size_t n = avail < len ? avail : len;
+        if ( memcmp( p, header, n ) != 0 ) {
+            return 0;
+        }
+        return n == len ? 1 : -1;
     }
 
-    XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
+    //增量解析的记号扫描：返回从p开始的完整记号之后的位置，数据不足时返回0
+    //记号按Identify()的规则划分；记号之后至少还要有一个字节，保证切分处不会被当作文档结尾
+    //*scan记录已扫描的长度，*quote记录标签中未闭合的引号，下一块到达时接着扫描
+    static const char* ScanToken( const char* p, const char* end, size_t* scan, char* quote )
     {
-        //初始化属性表
-        XMLAttribute* last = 0;
-        XMLAttribute* attrib = 0;
-        //检查是否存在属性
-        for( attrib = _rootAttribute;
-            attrib;
-            last = attrib, attrib = attrib->_next ) {
-            if ( XMLUtil::StringEqual( attrib->Name(), name ) ) {
-                break;
+        const size_t avail = end - p;
+        const char* tokenEnd = 0;
+        size_t resume = 0;
+        if ( *p != '<' ) {
+            //文本到下一个'<'为止
+            const char* q = p + *scan;
+            tokenEnd = static_cast<const char*>( memchr( q, '<', end - q ) );
+            if ( !tokenEnd ) {
+                *scan = avail;
+                return 0;
             }
+            resume = tokenEnd - p;
         }
-        //如果不存在下一个属性，则创建一个
-        if ( !attrib ) {
-            attrib = CreateAttribute();
-            TIXMLASSERT( attrib );
-            //如果当前属性存在，属性表链接新属性
-            if ( last ) {
-                TIXMLASSERT( last->_next == 0 );
-                last->_next = attrib;
-            }
-            //如果不存在，新属性为根属性
+        else if ( avail < 2 ) {
+            return 0;
+        }
+        else if ( p[1] == '?' || p[1] == '!' ) {
+            //声明、注释、CDATA和DTD以各自的结束标记为止
+            const char* close = ">";
+            size_t from = 2;
+            if ( p[1] == '?' ) {
+                close = "?>";
+            }
             else {
-                TIXMLASSERT( _rootAttribute == 0 );
-                _rootAttribute = attrib;
+                const int comment = MatchHeader( p, avail, "<!--", 4 );
+                const int cdata = MatchHeader( p, avail, "<![CDATA[", 9 );
+                if ( comment < 0 || cdata < 0 ) {
+                    return 0;
+                }
+                if ( comment ) {
+                    close = "-->";
+                    from = 4;
+                }
+                else if ( cdata ) {
+                    close = "]]>";
+                    from = 9;
+                }
             }
-            attrib->SetName( name );
+            const size_t closeLen = strlen( close );
+            if ( *scan > from ) {
+                from = *scan;
+            }
+            tokenEnd = FindPattern( p + from, end, close, closeLen );
+            if ( !tokenEnd ) {
+                *scan = avail >= from + closeLen ? avail - closeLen + 1 : from;
+                return 0;
+            }
+            resume = tokenEnd - p - closeLen;
         }
-        return attrib;
+        else {
+            //元素标签到引号之外的'>'为止
+            const char* q = p + ( *scan > 1 ? *scan : 1 );
+            char qc = *quote;
+            for ( ; q < end; ++q ) {
+                if ( qc ) {
+                    if ( *q == qc ) {
+                        qc = 0;
+                    }
+                }
+                else if ( *q == '\"' || *q == '\'' ) {
+                    qc = *q;
+                }
+                else if ( *q == '>' ) {
+                    break;
+                }
+            }
+            *quote = qc;
+            if ( q == end ) {
+                *scan = avail;
+                return 0;
+            }
+            tokenEnd = q + 1;
+            resume = q - p;
+        }
+        if ( tokenEnd == end ) {
+            *scan = resume;
+            return 0;
+        }
+        return tokenEnd;
     }
 
-    void XMLElement::DeleteAttribute( XMLAttribute* attribute )
+    XMLError XMLDocument::Parse( const char* xml, size_t len, XMLVisitor* visitor )
     {
-        if ( attribute == 0 ) {
-            return;
+        TIXMLASSERT( visitor );
+        BeginParse( visitor );
+        if ( xml && len == (size_t)(-1) ) {
+            len = strlen( xml );
         }
-        MemPool* pool = attribute->_memPool;
-        //调用析构函数
-        attribute->~XMLAttribute();
-        //释放内存
-        pool->Free( attribute );
+        Feed( xml, len );
+        return Finish();
     }
 
-    char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
+    XMLError XMLDocument::BeginParse( XMLVisitor* visitor )
     {
-        XMLAttribute* prevAttribute = 0;
-
-        //解析
-        while( p ) {
-            //跳过空白
-            p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
-            //如果字符为空，报错
-            if ( !(*p) ) {
-                _document->SetError( XML_ERROR_PARSING_ELEMENT, _parseLineNum, "XMLElement name=%s", Name() );
-                return 0;
-            }
+        Reset();
+        _parseCurLineNum = 1;
+        _parseLineNum = 1;
+        _pushState = PUSH_PROLOG;
+        _visitor = visitor;
+        return _errorID;
+    }
 
-            //解析属性
-            if (XMLUtil::IsNameStartChar( *p ) ) {
-                XMLAttribute* attrib = CreateAttribute();
-                TIXMLASSERT( attrib );
-                //获取文档行号
-                attrib->_parseLineNum = _document->_parseCurLineNum;
-                int attrLineNum = attrib->_parseLineNum;
-                //深度解析本行内容
-                p = attrib->ParseDeep( p, _document->ProcessEntities(), curLineNumPtr );
-                //如果字符为空或者存在属性，首先删除该属性并报错
-                if ( !p || Attribute( attrib->Name() ) ) {
-                    DeleteAttribute( attrib );
-                    _document->SetError( XML_ERROR_PARSING_ATTRIBUTE, attrLineNum, "XMLElement name=%s", Name() );
-                    return 0;
-                }
-                //如果存在上一个属性，则链接当前属性
-                if ( prevAttribute ) {
-                    TIXMLASSERT( prevAttribute->_next == 0 );
-                    prevAttribute->_next = attrib;
-                }
-                //否则，新属性为根属性
-                else {
-                    TIXMLASSERT( _rootAttribute == 0 );
-                    _rootAttribute = attrib;
-                }
-                prevAttribute = attrib;
-            }
-            //结束标志1
-            else if ( *p == '>' ) {
-                ++p;
+    XMLError XMLDocument::Feed( const char* chunk, size_t len )
+    {
+        TIXMLASSERT( _pushState != PUSH_IDLE );
+        if ( _pushState == PUSH_IDLE || _pushState == PUSH_STOPPED || _pushInputEnded || Error() ) {
+            return _errorID;
+        }
+        if ( len == 0 || !chunk ) {
+            return _errorID;
+        }
+        //'\0'之后的数据忽略
+        const char* nul = static_cast<const char*>( memchr( chunk, 0, len ) );
+        if ( nul ) {
+            len = nul - chunk;
+            _pushInputEnded = true;
+        }
+        //分段拷贝解析，流式解析时已解析的数据块随即释放
+        while ( len > 0 && _pushState != PUSH_STOPPED && !Error() ) {
+            const size_t slice = len < (size_t)PUSH_SLICE ? len : (size_t)PUSH_SLICE;
+            if ( !AppendPending( chunk, slice ) ) {
                 break;
             }
-            //结束标志2
-            else if ( *p == '/' && *(p+1) == '>' ) {
-                _closingType = CLOSED;
-                return p+2;
+            ParsePending( false );
+            chunk += slice;
+            len -= slice;
+        }
+        return _errorID;
+    }
+
+    //追加到待处理数据，末尾保留'\0'；分配器没有内存时返回false
+    bool XMLDocument::AppendPending( const char* data, size_t len )
+    {
+        if ( _pushSize + len + 1 > _pushCapacity ) {
+            size_t capacity = _pushCapacity ? _pushCapacity : 256;
+            while ( capacity < _pushSize + len + 1 ) {
+                capacity *= 2;
             }
-            //其他情况则解析错误
-            else {
-                _document->SetError( XML_ERROR_PARSING_ELEMENT, _parseLineNum, 0 );
-                return 0;
+            char* buffer = static_cast<char*>( AllocMemory( _memory, capacity ) );
+            if ( !buffer ) {
+                return false;
             }
+            if ( _pushBuffer ) {
+                memcpy( buffer, _pushBuffer, _pushSize );
+                FreeMemory( _memory, _pushBuffer, _pushCapacity );
+            }
+            _pushBuffer = buffer;
+            _pushCapacity = capacity;
         }
-        return p;
+        memcpy( _pushBuffer + _pushSize, data, len );
+        _pushSize += len;
+        _pushBuffer[_pushSize] = 0;
+        return true;
     }
 
-    char* XMLElement::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr )
+    void XMLDocument::FreePending()
     {
-        //读取元素
-        p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+        if ( _pushBuffer ) {
+            FreeMemory( _memory, _pushBuffer, _pushCapacity );
+        }
+        _pushBuffer = 0;
+        _pushSize = 0;
+        _pushCapacity = 0;
+        _pushStart = 0;
+    }
 
-        //设置结尾标志
-        if ( *p == '/' ) {
-            _closingType = CLOSING;
-            ++p;
+    XMLError XMLDocument::Finish()
+    {
+        TIXMLASSERT( _pushState != PUSH_IDLE );
+        if ( _pushState != PUSH_IDLE && _pushState != PUSH_STOPPED && !Error() ) {
+            //保证有以'\0'结尾的待处理数据
+            if ( AppendPending( "", 0 ) ) {
+                ParsePending( true );
+            }
+        }
+        if ( _visitor && _pushState != PUSH_IDLE && !Error() ) {
+            _visitor->VisitExit( *this );
         }
+        _pushState = PUSH_IDLE;
+        FreePending();
+        _visitor = 0;
+        return _errorID;
+    }
 
-        //解析名称
-        p = _value.ParseName( p );
-        if ( _value.Empty() ) {
-            return 0;
+    void XMLDocument::ParsePending( bool final )
+    {
+        char* data = _pushBuffer + _pushStart;
+        char* const end = _pushBuffer + _pushSize;
+        TIXMLASSERT( *end == 0 );
+        if ( _pushState == PUSH_PROLOG ) {
+            //与Parse()相同：跳过开头的空白，读取BOM；数据不足以判断其后是否还有内容时等待
+            const char* q = XMLUtil::SkipWhiteSpace( data, 0 );
+            if ( !final && ( !*q || ( (unsigned char)*q == TIXML_UTF_LEAD_0 && end - q < 4 ) ) ) {
+                return;
+            }
+            data = XMLUtil::SkipWhiteSpace( data, &_parseCurLineNum );
+            data = const_cast<char*>( XMLUtil::ReadBOM( data, &_writeBOM ) );
+            if ( !*data ) {
+                SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+                return;
+            }
+            _pushStart = data - _pushBuffer;
+            _pushState = PUSH_BODY;
+            //读过BOM之后才进入文档；VisitEnter(文档)返回false时跳过全部节点
+            if ( _visitor && !_visitor->VisitEnter( *this ) ) {
+                _visitSkip = 0;
+            }
         }
 
-        //解析属性
-        p = ParseAttributes( p, curLineNumPtr );
-        if ( !p || !*p || _closingType != OPEN ) {
-            return p;
+        //只把完整的记号交给解析；最后一段包含剩余的全部数据
+        char* cut = end;
+        if ( !final ) {
+            cut = data;
+            const char* next = 0;
+            while ( cut < end && ( next = ScanToken( cut, end, &_pushScan, &_pushQuote ) ) != 0 ) {
+                cut = const_cast<char*>( next );
+                _pushScan = 0;
+                _pushQuote = 0;
+            }
+            if ( cut == data ) {
+                return;
+            }
         }
 
-        p = XMLNode::ParseDeep( p, parentEndTag, curLineNumPtr );
-        return p;
+        //完整的记号拷贝到固定的数据块，DOM中的字符串指向这里
+        //非最后一段末尾放"<>"：文本在此结束，又不会被当作文档结尾
+        const size_t len = cut - data;
+        ParseBlock parseBlock;
+        parseBlock.size = len + 3;
+        parseBlock.mem = static_cast<char*>( AllocMemory( _memory, parseBlock.size ) );
+        if ( !parseBlock.mem ) {
+            //与解析出错时相同
+            AbortParse();
+            DeleteChildren();
+            ReleaseIndexes();
+            ResetPools();
+            return;
+        }
+        char* block = parseBlock.mem;
+        memcpy( block, data, len );
+        block[len] = final ? 0 : '<';
+        block[len + 1] = '>';
+        block[len + 2] = 0;
+        _parseBlocks.Push( parseBlock );
+
+        //已解析的数据超过一半时把剩余部分移到开头
+        _pushStart += len;
+        if ( _pushStart > _pushSize / 2 ) {
+            const size_t rest = _pushSize - _pushStart;
+            memmove( _pushBuffer, _pushBuffer + _pushStart, rest + 1 );
+            _pushSize = rest;
+            _pushStart = 0;
+        }
+
+        const bool more = ParseSpan( block, block + len, final );
+        if ( Error() ) {
+            //与Parse()相同，出错时清空
+            DeleteChildren();
+            ReleaseIndexes();
+            ResetPools();
+        }
+        else if ( !more ) {
+            _pushState = PUSH_STOPPED;
+        }
+        //流式解析时节点用完即删，只需保留未闭合元素所在的数据块
+        if ( _visitor ) {
+            ReleaseParseBlocks();
+        }
     }
 
-    bool XMLElement::Accept( XMLVisitor* visitor ) const
+    void XMLDocument::ReleaseParseBlocks()
     {
-        TIXMLASSERT( visitor );
-        //进入访问者模式
-        if ( visitor->VisitEnter( *this, _rootAttribute ) ) {
-            for ( const XMLNode* node=FirstChild(); node; node=node->NextSibling() ) {
-                if ( !node->Accept( visitor ) ) {
-                    break;
-                }
+        //_openBlocks从外到内不减，依次对照即可
+        int kept = 0;
+        int j = 0;
+        for ( int i = 0; i < _parseBlocks.Size(); ++i ) {
+            bool used = false;
+            while ( j < _openBlocks.Size() && _openBlocks[j] == i ) {
+                _openBlocks[j] = kept;
+                ++j;
+                used = true;
+            }
+            if ( used ) {
+                _parseBlocks[kept++] = _parseBlocks[i];
+            }
+            else {
+                FreeMemory( _memory, _parseBlocks[i].mem, _parseBlocks[i].size );
             }
         }
-        //退出访问者模式
-        return visitor->VisitExit( *this );
+        _parseBlocks.PopArr( _parseBlocks.Size() - kept );
     }
 
-    const char* XMLElement::Attribute( const char* name, const char* value ) const
+    //解析p处的一个节点并检查结构，返回其后的位置；未闭合的元素保存在_openElements中，可以在下一段继续
+    //final为真时end处为文档结尾；出错时未闭合的元素一并删除
+    char* XMLDocument::ParseStep( char* p, const char* end, bool final, ParseEvent* event, XMLNode** node )
     {
-        //查找属性
-        const XMLAttribute* a = FindAttribute( name );
-        if ( !a ) {
-            return 0;
+        TIXMLASSERT( event );
+        TIXMLASSERT( node );
+        *node = 0;
+        *event = PARSE_ERROR;
+        if ( Error() ) {
+            return AbortParse();
+        }
+        //只剩空白时本段结束
+        const char* q = XMLUtil::SkipWhiteSpace( p, 0 );
+        if ( q >= end || !*q ) {
+            p = XMLUtil::SkipWhiteSpace( p, &_parseCurLineNum );
+            if ( final && !_openElements.Empty() ) {
+                //最内层的未闭合元素
+                SetError( XML_ERROR_PARSING, _openElements.PeekTop()->_parseLineNum, 0 );
+                return AbortParse();
+            }
+            *event = PARSE_DONE;
+            return p;
         }
-        //返回值
-        if ( !value || XMLUtil::StringEqual( a->Value(), value )) {
-            return a->Value();
+
+        XMLNode* current = 0;
+        p = Identify( p, &current );
+        TIXMLASSERT( p );
+        if ( !current ) {
+            return AbortParse();
         }
-        return 0;
+        int initialLineNum = current->_parseLineNum;
+        //按Identify()给出的种类解析；元素只解析标签，子节点由调用者继续解析
+        XMLElement* ele = current->ToElement();
+        if ( ele ) {
+            p = ele->ParseDeep( p, 0, &_parseCurLineNum );
+        }
+        else if ( current->ToText() ) {
+            p = current->ToText()->ParseDeep( p, 0, &_parseCurLineNum );
+        }
+        else if ( current->ToComment() ) {
+            p = current->ToComment()->ParseDeep( p, 0, &_parseCurLineNum );
+        }
+        else if ( current->ToDeclaration() ) {
+            p = current->ToDeclaration()->ParseDeep( p, 0, &_parseCurLineNum );
+        }
+        else {
+            TIXMLASSERT( current->ToUnknown() );
+            p = current->ToUnknown()->ParseDeep( p, 0, &_parseCurLineNum );
+        }
+        if ( !p ) {
+            XMLNode::FreeNode( current );
+            if ( !Error() ) {
+                SetError( XML_ERROR_PARSING, initialLineNum, 0 );
+            }
+            return AbortParse();
+        }
+
+        const int depth = _openElements.Size();
+        //声明只能出现在文档开头
+        XMLDeclaration* decl = current->ToDeclaration();
+        if ( decl && !( depth == 0 && _parsePrologOnly ) ) {
+            SetError( XML_ERROR_PARSING_DECLARATION, initialLineNum, "XMLDeclaration value=%s", decl->Value() );
+            XMLNode::FreeNode( current );
+            return AbortParse();
+        }
+        if ( ele && ele->ClosingType() == XMLElement::CLOSING ) {
+            current->_memPool->SetTracked();
+            //文档层的结束标签结束解析，标签交给调用者删除
+            if ( depth == 0 ) {
+                *event = PARSE_STOP;
+                *node = current;
+                return p;
+            }
+            //闭合最内层的元素
+            XMLElement* open = _openElements.Pop();
+            _openBlocks.Pop();
+            const bool mismatch = ele->Name() != open->Name();
+            XMLNode::FreeNode( current );
+            if ( mismatch ) {
+                SetError( XML_ERROR_MISMATCHED_ELEMENT, open->_parseLineNum, "XMLElement name=%s", open->Name() );
+                XMLNode::FreeNode( open );
+                return AbortParse();
+            }
+            *event = PARSE_END;
+            *node = open;
+            return p;
+        }
+        if ( ele && ele->ClosingType() == XMLElement::OPEN ) {
+            //开始标签之后就是文档结尾
+            if ( !*p ) {
+                SetError( XML_ERROR_MISMATCHED_ELEMENT, initialLineNum, "XMLElement name=%s", ele->Name() );
+                XMLNode::FreeNode( current );
+                return AbortParse();
+            }
+            _openElements.Push( ele );
+            _openBlocks.Push( _parseBlocks.Size() - 1 );
+            *event = PARSE_START;
+        }
+        else {
+            *event = PARSE_NODE;
+        }
+        _parsePrologOnly = _parsePrologOnly && ( depth > 0 || decl );
+        *node = current;
+        return p;
     }
 
-    int XMLElement::IntAttribute(const char* name, int defaultValue) const
+    //出错时删除未闭合的元素
+    char* XMLDocument::AbortParse()
     {
-        int i = defaultValue;
-        QueryIntAttribute(name, &i);
-        return i;
+        while ( !_openElements.Empty() ) {
+            XMLNode::FreeNode( _openElements.Pop() );
+        }
+        _openBlocks.Clear();
+        return 0;
     }
 
-    unsigned XMLElement::UnsignedAttribute(const char* name, unsigned defaultValue) const
+    //不递归地解析[p, end)中的全部节点，建立DOM或者交给_visitor
+    //出错或文档层遇到结束标签时返回false，之后的数据不再解析
+    bool XMLDocument::ParseSpan( char* p, const char* end, bool final )
     {
-        unsigned i = defaultValue;
-        QueryUnsignedAttribute(name, &i);
-        return i;
+        for( ;; ) {
+            ParseEvent event = PARSE_ERROR;
+            XMLNode* node = 0;
+            p = ParseStep( p, end, final, &event, &node );
+            if ( event == PARSE_DONE ) {
+                return true;
+            }
+            if ( event == PARSE_STOP || event == PARSE_ERROR ) {
+                XMLNode::FreeNode( node );
+                return false;
+            }
+            TIXMLASSERT( node );
+            const int depth = _openElements.Size();
+            if ( !_visitor ) {
+                //开始标签留在栈上，闭合后再入树
+                if ( event != PARSE_START ) {
+                    XMLNode* parent = depth ? static_cast<XMLNode*>( _openElements.PeekTop() ) : this;
+                    parent->InsertEndChild( node );
+                }
+                continue;
+            }
+            //流式解析：节点不入树，回调后立即删除
+            if ( event == PARSE_START ) {
+                //VisitEnter返回false时跳过子节点
+                const int parentDepth = depth - 1;
+                if ( parentDepth < _visitSkip && !_visitor->VisitEnter( *node->ToElement(), node->ToElement()->FirstAttribute() ) ) {
+                    _visitSkip = depth;
+                }
+                continue;
+            }
+            if ( event == PARSE_END ) {
+                //进入过的元素才退出
+                if ( depth < _visitSkip ) {
+                    _visitSkip = INT_MAX;
+                    if ( !_visitor->VisitExit( *node->ToElement() ) ) {
+                        _visitSkip = depth;
+                    }
+                }
+            }
+            else {
+                //文本以下一个标签的'<'结尾，回调中取值会在那里写入'\0'，回调之后恢复
+                const char next = *p;
+                if ( depth < _visitSkip && !node->Accept( _visitor ) ) {
+                    _visitSkip = depth;
+                }
+                *p = next;
+            }
+            XMLNode::FreeNode( node );
+        }
     }
 
-    int64_t XMLElement::Int64Attribute(const char* name, int64_t defaultValue) const
+    //threads为0时使用全部CPU
+    static int ThreadCount( int threads )
     {
-        int64_t i = defaultValue;
-        QueryInt64Attribute(name, &i);
-        return i;
+        if ( threads <= 0 ) {
+        #ifdef TIXML_USE_THREADS
+            threads = static_cast<int>( sysconf( _SC_NPROCESSORS_ONLN ) );
+        #endif
+            threads = threads > 0 ? threads : 1;
+        }
+        return threads;
     }
 
-    bool XMLElement::BoolAttribute(const char* name, bool defaultValue) const
-    {
-        bool b = defaultValue;
-        QueryBoolAttribute(name, &b);
-        return b;
-    }
+    //任务队列：各线程依次领取[0, count)中的任务，直到领完
+    typedef void (*TaskFunc)( void* context, int index );
+    struct TaskQueue {
+        TaskFunc        run;
+        void*           context;
+        int             count;
+        int             next;           //下一个未领取的任务
+    #ifdef TIXML_USE_THREADS
+        pthread_mutex_t lock;
+    #endif
+    };
 
-    double XMLElement::DoubleAttribute(const char* name, double defaultValue) const
-    {
-        double d = defaultValue;
-        QueryDoubleAttribute(name, &d);
-        return d;
+    static void* RunTaskQueue( void* arg )
+    {
+        TaskQueue* queue = static_cast<TaskQueue*>( arg );
+        for( ;; ) {
+        #ifdef TIXML_USE_THREADS
+            pthread_mutex_lock( &queue->lock );
+            const int index = queue->next++;
+            pthread_mutex_unlock( &queue->lock );
+        #else
+            const int index = queue->next++;
+        #endif
+            if ( index >= queue->count ) {
+                return 0;
+            }
+            queue->run( queue->context, index );
+        }
     }
 
-    float XMLElement::FloatAttribute(const char* name, float defaultValue) const
+    //用threads个线程（含当前线程）执行count个任务，返回时全部完成；无法创建线程时由已有的线程完成
+    static void RunTasks( TaskFunc run, void* context, int count, int threads )
     {
-        float f = defaultValue;
-        QueryFloatAttribute(name, &f);
-        return f;
+        TaskQueue queue;
+        queue.run = run;
+        queue.context = context;
+        queue.count = count;
+        queue.next = 0;
+        if ( threads > count ) {
+            threads = count;
+        }
+    #ifdef TIXML_USE_THREADS
+        pthread_mutex_init( &queue.lock, 0 );
+        pthread_t* workers = new pthread_t[threads > 1 ? threads - 1 : 1];
+        int started = 0;
+        while ( started < threads - 1 && pthread_create( &workers[started], 0, RunTaskQueue, &queue ) == 0 ) {
+            ++started;
+        }
+        RunTaskQueue( &queue );
+        for ( int i = 0; i < started; ++i ) {
+            pthread_join( workers[i], 0 );
+        }
+        delete [] workers;
+        pthread_mutex_destroy( &queue.lock );
+    #else
+        RunTaskQueue( &queue );
+    #endif
     }
 
-    void XMLElement::DeleteAttribute( const char* name )
+    //并行解析的一个分块：先检查切分处并数出行数，再在片段文档中解析，最后改挂到最终的文档
+    struct XMLDocument::ParseChunk {
+        enum Stage {
+            SCAN,
+            PARSE,
+            RETARGET
+        };
+        XMLDocument*    fragment;       //片段文档，提供内存池、名称表、元素栈和错误状态
+        XMLDocument*    target;         //最终的文档
+        char*           start;          //分块起点，总是记号边界上的'<'
+        char*           end;            //分块终点，即下一块的起点
+        bool            last;           //最后一块到文档结尾为止
+        Stage           stage;          //当前阶段
+        int             lines;          //第一阶段：分块中的换行数
+        bool            ok;             //本阶段的结果
+    };
+
+    //每个分块一个线程
+    void XMLDocument::RunChunk( void* chunks, int index )
     {
-        //prev接收属性表
-        XMLAttribute* prev = 0;
-        for( XMLAttribute* a=_rootAttribute; a; a=a->_next ) {
-            //找到属性并断开其链表指针
-            if ( XMLUtil::StringEqual( name, a->Name() ) ) {
-                if ( prev ) {
-                    prev->_next = a->_next;
-                }
-                else {
-                    _rootAttribute = a->_next;
-                }
-                //释放
-                DeleteAttribute( a );
+        ParseChunk* chunk = static_cast<ParseChunk*>( chunks ) + index;
+        switch ( chunk->stage ) {
+            case ParseChunk::SCAN:
+                //最后一块不必检查，行数也用不到
+                chunk->ok = chunk->last || ScanChunk( chunk->start, chunk->end, &chunk->lines );
+                break;
+            case ParseChunk::PARSE:
+                chunk->ok = chunk->fragment->ParseFragment( chunk->start, chunk->end, chunk->last );
+                break;
+            case ParseChunk::RETARGET:
+                chunk->fragment->RetargetFragment( chunk->target );
                 break;
-            }
-            prev = a;
         }
     }
 
-    const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
+    //从p开始查找可以切分的位置：'<'后是名称或'/'，且前一个非空白字符是'>'
+    //注释、CDATA和属性值中也可能出现这样的位置，由ScanChunk()检查，返回0表示找不到
+    static char* FindChunkStart( char* p, const char* end )
     {
-        //遍历属性表
-        for( XMLAttribute* a = _rootAttribute; a; a = a->_next ) {
-            if ( XMLUtil::StringEqual( a->Name(), name ) ) {
-                return a;
+        while ( p < end ) {
+            p = static_cast<char*>( memchr( p, '<', end - p ) );
+            if ( !p ) {
+                return 0;
+            }
+            if ( p[1] != '!' && p[1] != '?' ) {
+                const char* q = p - 1;
+                while ( XMLUtil::IsWhiteSpace( *q ) ) {
+                    --q;
+                }
+                if ( *q == '>' ) {
+                    return p;
+                }
             }
+            ++p;
         }
         return 0;
     }
 
-    const char* XMLElement::GetText() const
+    //按记号扫描[p, end)并数出换行数；最后一个记号恰好在end结束时返回true
+    //分块起点是真正的记号边界时，解析就不会越过end读写下一块的数据
+    bool XMLDocument::ScanChunk( const char* p, const char* end, int* lines )
     {
-        if ( FirstChild() && FirstChild()->ToText() ) {
-            return FirstChild()->Value();
+        *lines = 0;
+        for ( const char* q = p; ( q = static_cast<const char*>( memchr( q, LF, end - q ) ) ) != 0; ++q ) {
+            ++*lines;
         }
-        return 0;
+        while ( p < end ) {
+            size_t scan = 0;
+            char quote = 0;
+            p = ScanToken( p, end + 1, &scan, &quote );
+            if ( !p ) {
+                return false;
+            }
+        }
+        return p == end;
     }
 
-    void XMLElement::SetText( const char* inText )
+    //把各块移开，每块从新的CHUNK_ALIGN对齐处开始，块之间不共用对齐块
+    //SIMD扫描只做对齐读取，这样各线程读到的都是本块的字节，不会读到其他线程正在写入的数据
+    //块末尾放"<>"：文本在此结束，又不会被当作文档结尾，与增量解析的数据块相同
+    void XMLDocument::SeparateChunks( ParseChunk* chunks, int count )
     {
-        //找到第一个子节点并重新设置值
-        if ( FirstChild() && FirstChild()->ToText() )
-            FirstChild()->SetValue( inText );
-        //直接插入
-        else {
-            XMLText* theText = GetDocument()->NewText( inText );
-            InsertFirstChild( theText );
+        //之后的块后移得更多，从后往前移动
+        char* dest = chunks[0].start;
+        DynArray<char*, 16> starts;
+        for ( int i = 0; i < count; ++i ) {
+            if ( i > 0 ) {
+                const uintptr_t address = reinterpret_cast<uintptr_t>( dest ) + 2;
+                dest = reinterpret_cast<char*>( ( address + CHUNK_ALIGN ) & ~(uintptr_t)( CHUNK_ALIGN - 1 ) );
+            }
+            starts.Push( dest );
+            dest += chunks[i].end - chunks[i].start;
+        }
+        TIXMLASSERT( dest + 1 <= _charBuffer + _allocatedSize );
+        for ( int i = count - 1; i >= 0; --i ) {
+            ParseChunk& chunk = chunks[i];
+            const size_t len = chunk.end - chunk.start;
+            memmove( starts[i], chunk.start, len );
+            chunk.start = starts[i];
+            chunk.end = starts[i] + len;
+            if ( chunk.last ) {
+                *chunk.end = 0;
+            }
+            else {
+                chunk.end[0] = '<';
+                chunk.end[1] = '>';
+                chunk.end[2] = 0;
+            }
         }
+        _charBufferSize = dest - _charBuffer;
     }
 
-
-    void XMLElement::SetText( int v )
+    //片段文档解析[p, end)：顶层节点按顺序挂在片段文档下，其中闭合外层元素的结束标签原样保留，
+    //未闭合的元素留在_openElements中，由LinkFragment()与前后的片段拼接
+    bool XMLDocument::ParseFragment( char* p, const char* end, bool last )
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr( v, buf, BUF_SIZE );
-        SetText( buf );
+        for( ;; ) {
+            ParseEvent event = PARSE_ERROR;
+            XMLNode* node = 0;
+            p = ParseStep( p, end, false, &event, &node );
+            if ( event == PARSE_DONE ) {
+                return last || p == end;
+            }
+            if ( event == PARSE_ERROR ) {
+                return false;
+            }
+            if ( event == PARSE_STOP ) {
+                InsertEndChild( node );
+            }
+            else if ( event != PARSE_START ) {
+                XMLNode* parent = _openElements.Empty() ? static_cast<XMLNode*>( this ) : _openElements.PeekTop();
+                parent->InsertEndChild( node );
+            }
+        }
     }
 
-
-    void XMLElement::SetText( unsigned v )
-    {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr( v, buf, BUF_SIZE );
-        SetText( buf );
+    //把片段中的全部节点改挂到target：文档指针、内存池和名称
+    //片段的名称表已经Merge()到target的名称表中，名称改为指向target中的副本
+    void XMLDocument::RetargetFragment( XMLDocument* target )
+    {
+        for ( int i = -1; i < _openElements.Size(); ++i ) {
+            //-1表示片段文档下的顶层节点
+            XMLNode* root = ( i < 0 ) ? static_cast<XMLNode*>( this ) : _openElements[i];
+            XMLNode* node = root;
+            for( ;; ) {
+                if ( node != this ) {
+                    node->_document = target;
+                    if ( node->_memPool == &_elementPool ) {
+                        node->_memPool = &target->_elementPool;
+                        node->_value.SetInternedStr( XMLNameTable::Forward( node->_value.GetStr() ) );
+                        for ( XMLAttribute* a = node->ToElement()->_rootAttribute; a; a = a->_next ) {
+                            a->_document = target;
+                            a->_name.SetInternedStr( XMLNameTable::Forward( a->_name.GetStr() ) );
+                        }
+                    }
+                    else if ( node->_memPool == &_textPool ) {
+                        node->_memPool = &target->_textPool;
+                    }
+                    else {
+                        TIXMLASSERT( node->_memPool == &_commentPool );
+                        node->_memPool = &target->_commentPool;
+                    }
+                }
+                //先序遍历，不递归
+                if ( node->_firstChild ) {
+                    node = node->_firstChild;
+                    continue;
+                }
+                while ( node != root && !node->_next ) {
+                    node = node->_parent;
+                }
+                if ( node == root ) {
+                    break;
+                }
+                node = node->_next;
+            }
+        }
     }
 
-
-    void XMLElement::SetText(int64_t v)
+    //按顺序把片段接到文档上，与ParseSpan()建立DOM的方式相同；结束标签不匹配时返回false
+    bool XMLDocument::LinkFragment( XMLDocument* fragment )
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr(v, buf, BUF_SIZE);
-        SetText(buf);
+        XMLNode* node = fragment->_firstChild;
+        fragment->_firstChild = fragment->_lastChild = 0;
+        while ( node ) {
+            XMLNode* next = node->_next;
+            node->_parent = node->_prev = node->_next = 0;
+            XMLElement* ele = node->ToElement();
+            if ( ele && ele->ClosingType() == XMLElement::CLOSING ) {
+                //剩下的节点由DiscardNodes()丢弃
+                if ( _openElements.Empty() || ele->Name() != _openElements.PeekTop()->Name() ) {
+                    return false;
+                }
+                XMLNode::FreeNode( node );
+                node = _openElements.Pop();
+            }
+            XMLNode* parent = _openElements.Empty() ? static_cast<XMLNode*>( this ) : _openElements.PeekTop();
+            parent->InsertEndChild( node );
+            node = next;
+        }
+        for ( int i = 0; i < fragment->_openElements.Size(); ++i ) {
+            _openElements.Push( fragment->_openElements[i] );
+        }
+        fragment->_openElements.Clear();
+        //未闭合的元素已交给本文档的元素栈，不再是片段中的未链接节点
+        for ( int i = 0; i < fragment->_unlinked.Size(); ++i ) {
+            fragment->_unlinked[i]->_unlinkedIndex = -1;
+        }
+        fragment->_unlinked.Clear();
+        return true;
     }
 
-
-    void XMLElement::SetText( bool v )
+    //丢弃全部节点：解析出的节点都在内存池中，且解析期间不分配其他内存，可以整块释放而不逐个析构
+    void XMLDocument::DiscardNodes( bool keepMemory )
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr( v, buf, BUF_SIZE );
-        SetText( buf );
+        _firstChild = _lastChild = 0;
+        _openElements.Clear();
+        _unlinked.Clear();
+        if ( keepMemory ) {
+            ResetPools();
+            return;
+        }
+        _elementPool.Clear();
+        _attributePool.Clear();
+        _textPool.Clear();
+        _commentPool.Clear();
     }
 
-
-    void XMLElement::SetText( float v )
+    //池中的项都已不再使用，回收但保留内存
+    void XMLDocument::ResetPools()
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr( v, buf, BUF_SIZE );
-        SetText( buf );
+        _elementPool.Reset();
+        _attributePool.Reset();
+        _textPool.Reset();
+        _commentPool.Reset();
     }
 
+    //分配由文档释放的缓存，Reset()留下的缓存够大时直接使用
+    char* XMLDocument::AllocBuffer( size_t size )
+    {
+        if ( !_spareBuffer || _spareSize < size ) {
+            if ( _spareBuffer ) {
+                FreeMemory( _memory, _spareBuffer, _spareSize );
+            }
+            _spareSize = 0;
+            _spareBuffer = static_cast<char*>( AllocMemory( _memory, size ) );
+            if ( !_spareBuffer ) {
+                return 0;
+            }
+            _spareSize = size;
+        }
+        char* buffer = _spareBuffer;
+        _allocatedBuffer = buffer;
+        _allocatedSize = _spareSize;
+        _spareBuffer = 0;
+        _spareSize = 0;
+        return buffer;
+    }
+
+    XMLMemoryStats XMLDocument::MemoryStats() const
+    {
+        XMLMemoryStats stats;
+        stats.elements = _elementPool.Stats();
+        stats.attributes = _attributePool.Stats();
+        stats.texts = _textPool.Stats();
+        stats.comments = _commentPool.Stats();
+        stats.charBuffer = _spareSize;
+        if ( _charBufferDeleter ) {
+            stats.charBuffer += ( _charBuffer == _allocatedBuffer ) ? _allocatedSize : _charBufferSize + 1;
+        }
+        //增量解析的数据
+        stats.charBuffer += _pushCapacity;
+        for ( int i = 0; i < _parseBlocks.Size(); ++i ) {
+            stats.charBuffer += _parseBlocks[i].size;
+        }
+        stats.strings = _strings.Bytes() + _errorStr.OwnedBytes();
+        stats.names = _names.Bytes();
+        stats.indexes = _indexBytes + _attributeIndex.Bytes();
+        stats.total = stats.elements.bytes + stats.attributes.bytes + stats.texts.bytes + stats.comments.bytes
+            + stats.charBuffer + stats.strings + stats.names + stats.indexes;
+        return stats;
+    }
+
+    size_t XMLDocument::SubtreeFootprint( const XMLNode* node ) const
+    {
+        TIXMLASSERT( !node || node->_document == this );
+        size_t bytes = 0;
+        const XMLNode* n = node;
+        while ( n ) {
+            //文档节点不在内存池中
+            bytes += n->_memPool ? n->_memPool->ItemSize() : 0;
+            bytes += n->_value.OwnedBytes();
+            const XMLElement* element = n->ToElement();
+            if ( element ) {
+                for ( const XMLAttribute* a = element->_rootAttribute; a; a = a->_next ) {
+                    bytes += _attributePool.ItemSize() + a->_value.OwnedBytes();
+                }
+                if ( element->_attributeIndex ) {
+                    bytes += element->_attributeIndex->Bytes();
+                }
+                if ( element->_childIndex ) {
+                    bytes += element->_childIndex->Bytes();
+                }
+            }
+            //先序遍历，不递归
+            if ( n->_firstChild ) {
+                n = n->_firstChild;
+                continue;
+            }
+            while ( n != node && !n->_next ) {
+                n = n->_parent;
+            }
+            n = ( n == node ) ? 0 : n->_next;
+        }
+        return bytes;
+    }
 
-    void XMLElement::SetText( double v )
+    //登记单调模式下建立了索引的元素；不同元素的查找可能在多个线程中同时登记，用比较交换压入链表
+    void XMLDocument::RegisterIndex( const XMLElement* element )
     {
-        char buf[BUF_SIZE];
-        XMLUtil::ToStr( v, buf, BUF_SIZE );
-        SetText( buf );
+        IndexedElement* record = new IndexedElement;
+        record->element = element;
+        IndexedElement* head;
+        do {
+            head = _indexedElements;
+            record->next = head;
+        } while ( !TIXML_ATOMIC_CAS( &_indexedElements, head, record ) );
     }
 
-    XMLError XMLElement::QueryIntText( int* ival ) const
+    //释放单调模式下元素建立的索引，同一元素可能登记两次，已删除的元素登记为0
+    void XMLDocument::ReleaseIndexes()
     {
-        if ( FirstChild() && FirstChild()->ToText() ) {
-            const char* t = FirstChild()->Value();
-            if ( XMLUtil::ToInt( t, ival ) ) {
-                return XML_SUCCESS;
+        while ( _indexedElements ) {
+            IndexedElement* record = _indexedElements;
+            _indexedElements = record->next;
+            const XMLElement* element = record->element;
+            if ( element ) {
+                delete element->_attributeIndex;
+                element->_attributeIndex = 0;
+                delete element->_childIndex;
+                element->_childIndex = 0;
             }
-            return XML_CAN_NOT_CONVERT_TEXT;
+            delete record;
         }
-        return XML_NO_TEXT_NODE;
     }
 
-
-    XMLError XMLElement::QueryUnsignedText( unsigned* uval ) const
+    XMLError XMLDocument::ParseParallel( const char* xml, size_t nBytes, int threads )
     {
-        if ( FirstChild() && FirstChild()->ToText() ) {
-            const char* t = FirstChild()->Value();
-            if ( XMLUtil::ToUnsigned( t, uval ) ) {
-                return XML_SUCCESS;
+        if ( xml && nBytes == (size_t)(-1) ) {
+            nBytes = strlen( xml );
+        }
+        threads = ThreadCount( threads );
+        const size_t most = xml ? nBytes / TINYXML2_PARALLEL_MIN_CHUNK : 0;
+        if ( most < (size_t)threads ) {
+            threads = static_cast<int>( most );
+        }
+        //片段文档的内存池会并入本文档，调用者的分配器也不要求线程安全
+        if ( threads < 2 || _allocator ) {
+            return Parse( xml, nBytes );
+        }
+
+        Reset();
+        //每块之后留出间隔，见SeparateChunks()
+        char* buffer = AllocBuffer( nBytes + 1 + threads * CHUNK_GAP );
+        if ( !buffer ) {
+            return _errorID;
+        }
+        memcpy( buffer, xml, nBytes );
+        if ( !AdoptBuffer( buffer, nBytes, DeleteCharBuffer ) ) {
+            return _errorID;
+        }
+        char* p = ParseProlog();
+        if ( !p ) {
+            return _errorID;
+        }
+        //遇到'\0'时与Parse()一样忽略其后的数据
+        char* const end = p + strlen( p );
+
+        //切分
+        DynArray<ParseChunk, 16> chunks;
+        const size_t step = ( end - p ) / threads;
+        char* start = p;
+        for ( int i = 0; i < threads; ++i ) {
+            char* next = 0;
+            if ( i + 1 < threads ) {
+                next = FindChunkStart( p + step * ( i + 1 ), p + step * ( i + 2 ) );
+                if ( !next || next <= start ) {
+                    continue;
+                }
+            }
+            ParseChunk chunk;
+            chunk.fragment = 0;
+            chunk.target = this;
+            chunk.start = start;
+            chunk.end = next ? next : end;
+            chunk.last = !next;
+            chunk.stage = ParseChunk::SCAN;
+            chunk.lines = 0;
+            chunk.ok = false;
+            chunks.Push( chunk );
+            start = next;
+        }
+
+        //第一阶段：检查切分处，数出各块的起始行
+        RunTasks( RunChunk, chunks.Mem(), chunks.Size(), chunks.Size() );
+        bool ok = true;
+        for ( int i = 0; i < chunks.Size() && ok; ++i ) {
+            ok = chunks[i].ok;
+        }
+        if ( ok ) {
+            SeparateChunks( chunks.Mem(), chunks.Size() );
+        }
+        int line = _parseCurLineNum;
+        for ( int i = 0; i < chunks.Size() && ok; ++i ) {
+            ParseChunk& chunk = chunks[i];
+            chunk.stage = ParseChunk::PARSE;
+            chunk.fragment = new XMLDocument( _processEntities, _whitespaceMode );
+            chunk.fragment->_parseCurLineNum = line;
+            chunk.fragment->_parsePrologOnly = ( i == 0 );
+            line += chunk.lines;
+        }
+        //第二阶段：各自解析
+        if ( ok ) {
+            RunTasks( RunChunk, chunks.Mem(), chunks.Size(), chunks.Size() );
+            for ( int i = 0; i < chunks.Size() && ok; ++i ) {
+                ok = chunks[i].ok;
             }
-            return XML_CAN_NOT_CONVERT_TEXT;
         }
-        return XML_NO_TEXT_NODE;
+        //第三阶段：合并名称表后各自改挂，然后依次拼接
+        if ( ok ) {
+            for ( int i = 0; i < chunks.Size(); ++i ) {
+                _names.Merge( chunks[i].fragment->_names );
+                chunks[i].stage = ParseChunk::RETARGET;
+            }
+            RunTasks( RunChunk, chunks.Mem(), chunks.Size(), chunks.Size() );
+            for ( int i = 0; i < chunks.Size(); ++i ) {
+                XMLDocument* fragment = chunks[i].fragment;
+                _elementPool.Adopt( fragment->_elementPool );
+                _attributePool.Adopt( fragment->_attributePool );
+                _textPool.Adopt( fragment->_textPool );
+                _commentPool.Adopt( fragment->_commentPool );
+            }
+            for ( int i = 0; i < chunks.Size() && ok; ++i ) {
+                ok = LinkFragment( chunks[i].fragment );
+            }
+            ok = ok && _openElements.Empty();
+            _parseCurLineNum = chunks.PeekTop().fragment->_parseCurLineNum;
+        }
+        for ( int i = 0; i < chunks.Size(); ++i ) {
+            if ( chunks[i].fragment ) {
+                chunks[i].fragment->DiscardNodes();
+                delete chunks[i].fragment;
+            }
+        }
+        if ( ok ) {
+            return _errorID;
+        }
+        //猜测的切分处不在记号边界上，或者文档有错误：整体重新用Parse()解析，结果和错误信息完全相同
+        DiscardNodes();
+        return Parse( xml, nBytes );
+    }
+
+    XMLReader::XMLReader( bool processEntities, Whitespace whitespaceMode ) :
+        _document( processEntities, whitespaceMode ),
+        _p( 0 ),
+        _next( 0 ),
+        _type( END_DOCUMENT ),
+        _node( 0 ),
+        _ownsNode( false ),
+        _closePending( false ),
+        _depth( 0 )
+    {
     }
 
+    XMLReader::~XMLReader()
+    {
+        //未删除的节点都是未链接节点，由_document析构时删除
+    }
 
-    XMLError XMLElement::QueryInt64Text(int64_t* ival) const
+    XMLError XMLReader::Open( const char* xml, size_t len )
     {
-        if (FirstChild() && FirstChild()->ToText()) {
-            const char* t = FirstChild()->Value();
-            if (XMLUtil::ToInt64(t, ival)) {
-                return XML_SUCCESS;
+        if ( !xml ) {
+            return OpenInSitu( 0, 0, 0 );
+        }
+        if ( len == (size_t)(-1) ) {
+            len = strlen( xml );
+        }
+        char* buffer = _document.AllocBuffer( len+1 );
+        memcpy( buffer, xml, len );
+        return OpenInSitu( buffer, len, DeleteCharBuffer );
+    }
+
+    XMLError XMLReader::OpenInSitu( char* xml, size_t len, XMLDocument::BufferDeleter deleter )
+    {
+        //Clear()会删除上一次留下的节点
+        _p = 0;
+        _next = 0;
+        _type = END_DOCUMENT;
+        _node = 0;
+        _ownsNode = false;
+        _closePending = false;
+        _depth = 0;
+        if ( _document.AdoptBuffer( xml, len, deleter ) ) {
+            _p = _document.ParseProlog();
+            if ( _p ) {
+                _next = *_p;
             }
-            return XML_CAN_NOT_CONVERT_TEXT;
         }
-        return XML_NO_TEXT_NODE;
+        return _document.ErrorID();
     }
 
+    void XMLReader::Release()
+    {
+        if ( _ownsNode ) {
+            _document.DeleteNode( _node );
+            _node = 0;
+        }
+        //自闭合元素等着作为END_ELEMENT再返回一次
+        if ( !_closePending ) {
+            _node = 0;
+        }
+        _ownsNode = false;
+    }
 
-    XMLError XMLElement::QueryBoolText( bool* bval ) const
+    XMLReader::TokenType XMLReader::Next()
     {
-        if ( FirstChild() && FirstChild()->ToText() ) {
-            const char* t = FirstChild()->Value();
-            if ( XMLUtil::ToBool( t, bval ) ) {
-                return XML_SUCCESS;
+        Release();
+        if ( _closePending ) {
+            _closePending = false;
+            _ownsNode = true;
+            _type = END_ELEMENT;
+            return _type;
+        }
+        if ( !_p ) {
+            _type = END_DOCUMENT;
+            return _type;
+        }
+        //恢复上一个文本取值时写入的'\0'
+        *_p = _next;
+        XMLDocument::ParseEvent event = XMLDocument::PARSE_ERROR;
+        XMLNode* node = 0;
+        char* p = _document.ParseStep( _p, _document._charBuffer + _document._charBufferSize, true, &event, &node );
+        if ( event == XMLDocument::PARSE_DONE || event == XMLDocument::PARSE_STOP || event == XMLDocument::PARSE_ERROR ) {
+            if ( node ) {
+                _document.DeleteNode( node );
             }
-            return XML_CAN_NOT_CONVERT_TEXT;
+            _p = 0;
+            _type = END_DOCUMENT;
+            return _type;
         }
-        return XML_NO_TEXT_NODE;
+        TIXMLASSERT( node );
+        _p = p;
+        _next = *p;
+        _node = node;
+        _depth = _document._openElements.Size();
+        if ( event == XMLDocument::PARSE_START ) {
+            //开始标签留在_document的栈上，结束时再删除
+            --_depth;
+            _type = START_ELEMENT;
+        }
+        else if ( event == XMLDocument::PARSE_END ) {
+            _ownsNode = true;
+            _type = END_ELEMENT;
+        }
+        else if ( node->ToElement() ) {
+            _closePending = true;
+            _type = START_ELEMENT;
+        }
+        else {
+            _ownsNode = true;
+            if ( node->ToText() ) {
+                _type = TEXT;
+            }
+            else if ( node->ToComment() ) {
+                _type = COMMENT;
+            }
+            else if ( node->ToDeclaration() ) {
+                _type = DECLARATION;
+            }
+            else {
+                _type = UNKNOWN;
+            }
+        }
+        return _type;
     }
 
-
-    XMLError XMLElement::QueryDoubleText( double* dval ) const
+    bool XMLReader::SkipSubtree()
     {
-        if ( FirstChild() && FirstChild()->ToText() ) {
-            const char* t = FirstChild()->Value();
-            if ( XMLUtil::ToDouble( t, dval ) ) {
-                return XML_SUCCESS;
+        if ( _type != START_ELEMENT ) {
+            return false;
+        }
+        if ( !_closePending ) {
+            //只按记号边界扫描，直到匹配的结束标签，不建立节点
+            char* p = _p;
+            *p = _next;
+            const char* end = _document._charBuffer + _document._charBufferSize + 1;
+            int depth = 1;
+            for( ;; ) {
+                size_t scan = 0;
+                char quote = 0;
+                const char* next = ScanToken( p, end, &scan, &quote );
+                if ( !next ) {
+                    break;
+                }
+                if ( p[0] == '<' ) {
+                    if ( p[1] == '/' ) {
+                        if ( --depth == 0 ) {
+                            break;
+                        }
+                    }
+                    else if ( p[1] != '!' && p[1] != '?' && next[-2] != '/' ) {
+                        ++depth;
+                    }
+                }
+                p = const_cast<char*>( next );
             }
-            return XML_CAN_NOT_CONVERT_TEXT;
+            //补上跳过部分的行数
+            for ( const char* c = _p; c < p; ++c ) {
+                if ( *c == LF ) {
+                    ++_document._parseCurLineNum;
+                }
+            }
+            _p = p;
+            _next = *p;
         }
-        return XML_NO_TEXT_NODE;
+        //结束标签仍按正常规则解析并检查是否匹配
+        return Next() == END_ELEMENT;
     }
 
+    const char* XMLReader::Name() const
+    {
+        const XMLElement* element = ToElement();
+        return element ? element->Name() : 0;
+    }
 
-    XMLError XMLElement::QueryFloatText( float* fval ) const
+    const char* XMLReader::Value() const
     {
-        if ( FirstChild() && FirstChild()->ToText() ) {
-            const char* t = FirstChild()->Value();
-            if ( XMLUtil::ToFloat( t, fval ) ) {
-                return XML_SUCCESS;
-            }
-            return XML_CAN_NOT_CONVERT_TEXT;
-        }
-        return XML_NO_TEXT_NODE;
+        return _node ? _node->Value() : 0;
     }
 
-    int XMLElement::IntText(int defaultValue) const
+    const XMLElement* XMLReader::ToElement() const
     {
-        int i = defaultValue;
-        QueryIntText(&i);
-        return i;
+        return _node ? _node->ToElement() : 0;
     }
 
-    unsigned XMLElement::UnsignedText(unsigned defaultValue) const
+    const XMLAttribute* XMLReader::FirstAttribute() const
     {
-        unsigned i = defaultValue;
-        QueryUnsignedText(&i);
-        return i;
+        const XMLElement* element = ToElement();
+        return element ? element->FirstAttribute() : 0;
     }
 
-    int64_t XMLElement::Int64Text(int64_t defaultValue) const
+    const char* XMLReader::Attribute( const char* name, const char* value ) const
     {
-        int64_t i = defaultValue;
-        QueryInt64Text(&i);
-        return i;
+        const XMLElement* element = ToElement();
+        return element ? element->Attribute( name, value ) : 0;
     }
 
-    bool XMLElement::BoolText(bool defaultValue) const
+    bool XMLReader::CData() const
     {
-        bool b = defaultValue;
-        QueryBoolText(&b);
-        return b;
+        const XMLText* text = _node ? _node->ToText() : 0;
+        return text && text->CData();
     }
 
-    double XMLElement::DoubleText(double defaultValue) const
+    int XMLReader::LineNum() const
     {
-        double d = defaultValue;
-        QueryDoubleText(&d);
-        return d;
+        return _node ? _node->GetLineNum() : 0;
     }
 
-    float XMLElement::FloatText(float defaultValue) const
+    XMLCompactDocument::XMLCompactDocument( bool processEntities, Whitespace whitespaceMode ) :
+        _reader( processEntities, whitespaceMode ),
+        _buffer( 0 )
     {
-        float f = defaultValue;
-        QueryFloatText(&f);
-        return f;
     }
 
-    XMLNode* XMLElement::ShallowClone( XMLDocument* doc ) const
+    XMLError XMLCompactDocument::Parse( const char* xml, size_t nBytes )
     {
-        if ( !doc ) {
-            doc = _document;
+        ClearNodes();
+        if ( xml && nBytes == (size_t)(-1) ) {
+            nBytes = strlen( xml );
         }
-        //新建元素列表
-        XMLElement* element = doc->NewElement( Value() );
-        //获取名称和值
-        for( const XMLAttribute* a=FirstAttribute(); a; a=a->Next() ) {
-            element->SetAttribute( a->Name(), a->Value() );
+        if ( _reader.Open( xml, nBytes ) != XML_SUCCESS ) {
+            return ErrorID();
         }
-        return element;
-    }
+        _buffer = _reader._document._charBuffer;
 
-    bool XMLElement::ShallowEqual( const XMLNode* compare ) const
-    {
-        TIXMLASSERT( compare );
-        const XMLElement* other = compare->ToElement();
-        //如果compare不为空，比较名称
-        if ( other && XMLUtil::StringEqual( other->Name(), Name() )) {
-            const XMLAttribute* a=FirstAttribute();
-            const XMLAttribute* b=other->FirstAttribute();
-            //如果a和b都不为空
-            while ( a && b ) {
-                //比较属性值
-                if ( !XMLUtil::StringEqual( a->Value(), b->Value() ) ) {
-                    return false;
+        //未闭合的节点和它们最后一个子节点
+        DynArray<uint32_t, 64> open;
+        DynArray<uint32_t, 64> last;
+        open.Push( AddNode( DOCUMENT, NONE, 0, 0 ) );
+        last.Push( NONE );
+        for( ;; ) {
+            const XMLReader::TokenType token = _reader.Next();
+            if ( token == XMLReader::END_DOCUMENT ) {
+                break;
+            }
+            if ( token == XMLReader::END_ELEMENT ) {
+                open.Pop();
+                last.Pop();
+                continue;
+            }
+            //下标是32位，数组大小是int
+            if ( _type.Size() == INT_MAX ) {
+                _reader._document.SetError( XML_ERROR_PARSING, _reader.LineNum(), "XMLCompactDocument: too many nodes" );
+                break;
+            }
+            NodeType type = UNKNOWN;
+            switch ( token ) {
+                case XMLReader::START_ELEMENT:
+                    type = ELEMENT;
+                    break;
+                case XMLReader::TEXT:
+                    type = _reader.CData() ? CDATA : TEXT;
+                    break;
+                case XMLReader::COMMENT:
+                    type = COMMENT;
+                    break;
+                case XMLReader::DECLARATION:
+                    type = DECLARATION;
+                    break;
+                default:
+                    break;
+            }
+            const uint32_t node = AddNode( type, open.PeekTop(), &last[ last.Size() - 1 ], _reader.LineNum() );
+            if ( type == ELEMENT ) {
+                //属性连续存放，记录起点和数量
+                _name[node] = InternName( _reader.Name() );
+                _offset[node] = AttributeCount();
+                for ( const XMLAttribute* a = _reader.FirstAttribute(); a; a = a->Next() ) {
+                    const char* value = a->Value();
+                    const size_t length = strlen( value );
+                    if ( _attributeName.Size() == INT_MAX ) {
+                        _reader._document.SetError( XML_ERROR_PARSING, _reader.LineNum(), "XMLCompactDocument: too many attributes" );
+                        break;
+                    }
+                    if ( !CheckLength( length ) ) {
+                        break;
+                    }
+                    _attributeName.Push( InternName( a->Name() ) );
+                    _attributeOffset.Push( Offset( value ) );
+                    _attributeLength.Push( static_cast<uint32_t>( length ) );
                 }
-                a = a->Next();
-                b = b->Next();
+                if ( Error() ) {
+                    break;
+                }
+                _length[node] = AttributeCount() - static_cast<uint32_t>( _offset[node] );
+                open.Push( node );
+                last.Push( NONE );
             }
-            if ( a || b ) {
-                return false;
+            else {
+                //内容已在缓存中就地解码
+                const char* value = _reader.Value();
+                const size_t length = strlen( value );
+                if ( !CheckLength( length ) ) {
+                    break;
+                }
+                _offset[node] = Offset( value );
+                _length[node] = static_cast<uint32_t>( length );
             }
-            return true;
         }
-        return false;
+        if ( Error() ) {
+            ClearNodes();
+            return ErrorID();
+        }
+        //数组按倍数增长，建立完成后释放多余的容量
+        _type.Shrink();
+        _name.Shrink();
+        _firstChild.Shrink();
+        _nextSibling.Shrink();
+        _parent.Shrink();
+        _lineNum.Shrink();
+        _offset.Shrink();
+        _length.Shrink();
+        _attributeName.Shrink();
+        _attributeOffset.Shrink();
+        _attributeLength.Shrink();
+        //文本后面的'\0'会被XMLReader恢复成'<'，解析完成后补上
+        for ( int i = 0; i < _type.Size(); ++i ) {
+            if ( _type[i] == TEXT ) {
+                _buffer[ _offset[i] + _length[i] ] = 0;
+            }
+        }
+        return XML_SUCCESS;
+    }
+
+    void XMLCompactDocument::Clear()
+    {
+        ClearNodes();
+        //释放缓存，不留错误
+        _reader.OpenInSitu( 0, 0, 0 );
+        _reader._document.ClearError();
+    }
+
+    void XMLCompactDocument::ClearNodes()
+    {
+        _buffer = 0;
+        _type.Clear();
+        _name.Clear();
+        _firstChild.Clear();
+        _nextSibling.Clear();
+        _parent.Clear();
+        _lineNum.Clear();
+        _offset.Clear();
+        _length.Clear();
+        _attributeName.Clear();
+        _attributeOffset.Clear();
+        _attributeLength.Clear();
+        _names.Clear();
+        _nameSlots.Clear();
+    }
+
+    //lastChild是parent当前的最后一个子节点，链接后更新为新节点
+    uint32_t XMLCompactDocument::AddNode( NodeType type, uint32_t parent, uint32_t* lastChild, int lineNum )
+    {
+        const uint32_t node = NodeCount();
+        _type.Push( static_cast<unsigned char>( type ) );
+        _name.Push( NO_NAME );
+        _firstChild.Push( NONE );
+        _nextSibling.Push( NONE );
+        _parent.Push( parent );
+        _lineNum.Push( lineNum );
+        _offset.Push( 0 );
+        _length.Push( 0 );
+        //文档节点没有父节点
+        if ( lastChild ) {
+            if ( *lastChild != NONE ) {
+                _nextSibling[ *lastChild ] = node;
+            }
+            else {
+                _firstChild[parent] = node;
+            }
+            *lastChild = node;
+        }
+        return node;
     }
 
-    //列表内容必须与'enum XMLError'匹配
-    const char* XMLDocument::_errorNames[XML_ERROR_COUNT] = {
-        "XML_SUCCESS",
-        "XML_NO_ATTRIBUTE",
-        "XML_WRONG_ATTRIBUTE_TYPE",
-        "XML_ERROR_FILE_NOT_FOUND",
-        "XML_ERROR_FILE_COULD_NOT_BE_OPENED",
-        "XML_ERROR_FILE_READ_ERROR",
-        "XML_ERROR_PARSING_ELEMENT",
-        "XML_ERROR_PARSING_ATTRIBUTE",
-        "XML_ERROR_PARSING_TEXT",
-        "XML_ERROR_PARSING_CDATA",
-        "XML_ERROR_PARSING_COMMENT",
-        "XML_ERROR_PARSING_DECLARATION",
-        "XML_ERROR_PARSING_UNKNOWN",
-        "XML_ERROR_EMPTY_DOCUMENT",
-        "XML_ERROR_MISMATCHED_ELEMENT",
-        "XML_ERROR_PARSING",
-        "XML_CAN_NOT_CONVERT_TEXT",
-        "XML_NO_TEXT_NODE",
-        "XML_ELEMENT_DEPTH_EXCEEDED"
-    };
+    uint32_t XMLCompactDocument::LastChild( uint32_t node ) const
+    {
+        uint32_t child = _firstChild[node];
+        while ( child != NONE && _nextSibling[child] != NONE ) {
+            child = _nextSibling[child];
+        }
+        return child;
+    }
 
-    void XMLDocument::Parse()
+    uint32_t XMLCompactDocument::PreviousSibling( uint32_t node ) const
     {
-        //判断释放存在节点
-        TIXMLASSERT( NoChildren() );
-        TIXMLASSERT( _charBuffer );
-        //从第一行开始
-        _parseCurLineNum = 1;
-        _parseLineNum = 1;
-        char* p = _charBuffer;
-        p = XMLUtil::SkipWhiteSpace( p, &_parseCurLineNum );
-        p = const_cast<char*>( XMLUtil::ReadBOM( p, &_writeBOM ) );
-        //判断解析内容是否为空
-        if ( !*p ) {
-            SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
-            return;
+        if ( node == NONE ) {
+            return NONE;
+        }
+        uint32_t prev = NONE;
+        for ( uint32_t sibling = _firstChild[ _parent[node] ]; sibling != node; sibling = _nextSibling[sibling] ) {
+            prev = sibling;
+        }
+        return prev;
+    }
+
+    uint64_t XMLCompactDocument::Offset( const char* str ) const
+    {
+        TIXMLASSERT( str >= _buffer && str <= _buffer + _reader._document._charBufferSize );
+        return static_cast<uint64_t>( str - _buffer );
+    }
+
+    //长度是32位，超出时设置错误
+    bool XMLCompactDocument::CheckLength( size_t length )
+    {
+        if ( length > (size_t)0xffffffffu ) {
+            _reader._document.SetError( XML_ERROR_PARSING, _reader.LineNum(), "XMLCompactDocument: string exceeds 4GB" );
+            return false;
+        }
+        return true;
+    }
+
+    //名称指针来自_reader的名称表，同名的指针相同，按指针散列
+    uint32_t XMLCompactDocument::InternName( const char* name )
+    {
+        if ( ( _names.Size() + 1 ) * 2 > _nameSlots.Size() ) {
+            const int capacity = _nameSlots.Size() ? _nameSlots.Size() * 2 : 64;
+            _nameSlots.Clear();
+            memset( _nameSlots.PushArr( capacity ), 0, capacity * sizeof( uint32_t ) );
+            for ( int id = 0; id < _names.Size(); ++id ) {
+                int i = HashPointer( _names[id], capacity - 1 );
+                while ( _nameSlots[i] ) {
+                    i = ( i + 1 ) & ( capacity - 1 );
+                }
+                _nameSlots[i] = id + 1;
+            }
         }
-        //深度解析
-        ParseDeep(p, 0, &_parseCurLineNum );
+        const int mask = _nameSlots.Size() - 1;
+        int i = HashPointer( name, mask );
+        while ( _nameSlots[i] ) {
+            if ( _names[ _nameSlots[i] - 1 ] == name ) {
+                return _nameSlots[i] - 1;
+            }
+            i = ( i + 1 ) & mask;
+        }
+        _names.Push( name );
+        _nameSlots[i] = _names.Size();
+        return _names.Size() - 1;
     }
 
+    uint32_t XMLCompactDocument::FindName( const char* name ) const
+    {
+        const XMLName key = _reader._document.FindName( name );
+        if ( key.Empty() || _nameSlots.Empty() ) {
+            return NO_NAME;
+        }
+        const int mask = _nameSlots.Size() - 1;
+        for ( int i = HashPointer( key.Str(), mask ); _nameSlots[i]; i = ( i + 1 ) & mask ) {
+            if ( _names[ _nameSlots[i] - 1 ] == key.Str() ) {
+                return _nameSlots[i] - 1;
+            }
+        }
+        return NO_NAME;
+    }
 
-    void XMLDocument::SetError( XMLError error, int lineNum, const char* format, ... )
+    size_t XMLCompactDocument::BytesUsed() const
     {
-        TIXMLASSERT( error >= 0 && error < XML_ERROR_COUNT );
-        //获取错误ID和行号
-        _errorID = error;
-        _errorLineNum = lineNum;
-        _errorStr.Reset();
+        return _type.Capacity() * sizeof( unsigned char )
+            + ( _name.Capacity() + _firstChild.Capacity() + _nextSibling.Capacity() + _parent.Capacity()
+                + _length.Capacity() + _attributeName.Capacity() + _attributeLength.Capacity()
+                + _nameSlots.Capacity() ) * sizeof( uint32_t )
+            + ( _offset.Capacity() + _attributeOffset.Capacity() ) * sizeof( uint64_t )
+            + _lineNum.Capacity() * sizeof( int )
+            + _names.Capacity() * sizeof( const char* );
+    }
 
-        //默认缓存空间
-        size_t BUFFER_SIZE = 1000;
-        char* buffer = new char[BUFFER_SIZE];
+    XMLCompactNode XMLCompactDocument::Root() const
+    {
+        return NodeCount() ? XMLCompactNode( this, NONE ) : XMLCompactNode();
+    }
 
-        //打印错误
-        TIXMLASSERT(sizeof(error) <= sizeof(int));
-        TIXML_SNPRINTF(buffer, BUFFER_SIZE, "Error=%s ErrorID=%d (0x%x) Line number=%d", ErrorIDToName(error), int(error), int(error), lineNum);
+    XMLCompactNode XMLCompactDocument::RootElement() const
+    {
+        return Root().FirstChildElement();
+    }
 
-        //如果传入另外的参数，则将其转换为字符串黏贴在buffer后面
-        if (format) {
-          size_t len = strlen(buffer);
-          TIXML_SNPRINTF(buffer + len, BUFFER_SIZE - len, ": ");
-          len = strlen(buffer);
+    const char* XMLCompactDocument::Name( uint32_t node ) const
+    {
+        return ( _type[node] == ELEMENT ) ? _names[ _name[node] ] : 0;
+    }
 
-          va_list va;
-          va_start(va, format);
-          TIXML_VSNPRINTF(buffer + len, BUFFER_SIZE - len, format, va);
-          va_end(va);
-      }
-      _errorStr.SetStr(buffer);
-      //释放
-      delete[] buffer;
+    const char* XMLCompactDocument::Value( uint32_t node ) const
+    {
+        switch ( _type[node] ) {
+            case DOCUMENT:
+                return 0;
+            case ELEMENT:
+                return Name( node );
+            default:
+                return _buffer + _offset[node];
+        }
     }
 
-    void XMLDocument::PushDepth()
+    uint32_t XMLCompactDocument::ValueLength( uint32_t node ) const
     {
-        _parsingDepth++;
-        //如果等于最大深度，则警告
-        if (_parsingDepth == TINYXML2_MAX_ELEMENT_DEPTH) {
-            SetError(XML_ELEMENT_DEPTH_EXCEEDED, _parseCurLineNum, "Element nesting is too deep." );
+        switch ( _type[node] ) {
+            case DOCUMENT:
+                return 0;
+            case ELEMENT:
+                return static_cast<uint32_t>( strlen( Name( node ) ) );
+            default:
+                return _length[node];
         }
     }
 
-    void XMLDocument::PopDepth()
+    uint32_t XMLCompactDocument::FirstChildElement( uint32_t node, const char* name ) const
     {
-        TIXMLASSERT(_parsingDepth > 0);
-        --_parsingDepth;
+        const uint32_t id = name ? FindName( name ) : NO_NAME;
+        if ( name && id == NO_NAME ) {
+            return NONE;
+        }
+        //只读遍历用到的数组
+        for ( uint32_t child = _firstChild[node]; child != NONE; child = _nextSibling[child] ) {
+            if ( _type[child] == ELEMENT && ( !name || _name[child] == id ) ) {
+                return child;
+            }
+        }
+        return NONE;
     }
 
-    XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
-    XMLNode( 0 ),
-    _writeBOM( false ),
-    _processEntities( processEntities ),
-    _errorID(XML_SUCCESS),
-    _whitespaceMode( whitespaceMode ),
-    _errorStr(),
-    _errorLineNum( 0 ),
-    _charBuffer( 0 ),
-    _parseCurLineNum( 0 ),
-    _parsingDepth(0),
-    _unlinked(),
-    _elementPool(),
-    _attributePool(),
-    _textPool(),
-    _commentPool()
+    uint32_t XMLCompactDocument::NextSiblingElement( uint32_t node, const char* name ) const
     {
-        _document = this;
+        const uint32_t id = name ? FindName( name ) : NO_NAME;
+        if ( name && id == NO_NAME ) {
+            return NONE;
+        }
+        for ( uint32_t sibling = _nextSibling[node]; sibling != NONE; sibling = _nextSibling[sibling] ) {
+            if ( _type[sibling] == ELEMENT && ( !name || _name[sibling] == id ) ) {
+                return sibling;
+            }
+        }
+        return NONE;
     }
 
+    uint32_t XMLCompactDocument::FirstAttribute( uint32_t element ) const
+    {
+        return ( _type[element] == ELEMENT ) ? static_cast<uint32_t>( _offset[element] ) : 0;
+    }
 
-    XMLDocument::~XMLDocument()
+    uint32_t XMLCompactDocument::AttributeCount( uint32_t element ) const
     {
-        Clear();
+        return ( _type[element] == ELEMENT ) ? _length[element] : 0;
     }
 
-    XMLError XMLDocument::Parse( const char* p, size_t len )
+    const char* XMLCompactDocument::Attribute( uint32_t element, const char* name ) const
     {
-        Clear();
-        //判断字符串长度
-        if ( len == 0 || !p || !*p ) {
-            SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
-            return _errorID;
-        }
-        if ( len == (size_t)(-1) ) {
-            len = strlen( p );
+        const uint32_t id = name ? FindName( name ) : NO_NAME;
+        if ( id == NO_NAME ) {
+            return 0;
         }
-        //初始化_charBuffer
-        TIXMLASSERT( _charBuffer == 0 );
-        _charBuffer = new char[ len+1 ];
-        //把字符串拷贝到_charBuffer
-        memcpy( _charBuffer, p, len );
-        _charBuffer[len] = 0;
-        //深度解析
-        Parse();
-        //如果报警，则清空内存池
-        if ( Error() ) {
-            DeleteChildren();
-            _elementPool.Clear();
-            _attributePool.Clear();
-            _textPool.Clear();
-            _commentPool.Clear();
+        const uint32_t end = FirstAttribute( element ) + AttributeCount( element );
+        for ( uint32_t a = FirstAttribute( element ); a < end; ++a ) {
+            if ( _attributeName[a] == id ) {
+                return AttributeValue( a );
+            }
         }
-        return _errorID;
-    }   
+        return 0;
+    }
 
     //辅助打开文件函数
     static FILE* callfopen( const char* filepath, const char* mode )
@@ -1899,7 +5527,7 @@ namespace tinyxml2{
             return _errorID;
         }
 
-        Clear();
+        Reset();
         //打开二进制文件
         FILE* fp = callfopen( filename, "rb" );
         if ( !fp ) {
@@ -1930,9 +5558,49 @@ namespace tinyxml2{
         }
     };
 
+#if defined(TIXML_USE_MMAP)
+    //映射长度：内容加终止符，按页对齐
+    static size_t MappedLength( size_t size )
+    {
+        const size_t page = (size_t)sysconf( _SC_PAGESIZE );
+        return ( size + 1 + page - 1 ) / page * page;
+    }
+
+    //内存映射缓存的释放函数
+    static void UnmapCharBuffer( char* buffer, size_t size )
+    {
+        munmap( buffer, MappedLength( size ) );
+    }
+
+    //把普通文件私有映射为可写缓存，失败返回0
+    //先映射一段匿名零页，再把文件覆盖映射到开头，文件之后的字节保证为0，可作为终止符
+    //MAP_PRIVATE写时复制，解析时的原地修改不会写回文件
+    static char* MapFile( FILE* fp, size_t size )
+    {
+        const int fd = fileno( fp );
+        struct stat st;
+        if ( fd < 0 || fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) || (size_t)st.st_size != size ) {
+            return 0;
+        }
+        const size_t length = MappedLength( size );
+        void* region = mmap( 0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( region == MAP_FAILED ) {
+            return 0;
+        }
+        void* mapped = mmap( region, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0 );
+        if ( mapped == MAP_FAILED ) {
+            munmap( region, length );
+            return 0;
+        }
+        //顺序访问提示，内核预读，缺页与解析重叠
+        madvise( mapped, size, MADV_SEQUENTIAL );
+        return static_cast<char*>( mapped );
+    }
+#endif
+
     XMLError XMLDocument::LoadFile( FILE* fp )
     {
-        Clear();
+        Reset();
         //定位到文件开头
         fseek( fp, 0, SEEK_SET );
         //文件读取错误
@@ -1967,8 +5635,26 @@ namespace tinyxml2{
 
         const size_t size = filelength;
         TIXMLASSERT( _charBuffer == 0 );
+#if defined(TIXML_USE_MMAP)
+        //大文件直接映射，省去堆缓存和整份拷贝
+        if ( size >= TINYXML2_MMAP_THRESHOLD ) {
+            char* mapped = MapFile( fp, size );
+            if ( mapped ) {
+                _charBuffer = mapped;
+                _charBufferSize = size;
+                _charBufferDeleter = UnmapCharBuffer;
+                Parse();
+                return _errorID;
+            }
+        }
+#endif
         //初始化_charBuffer
-        _charBuffer = new char[size+1];
+        _charBuffer = AllocBuffer( size+1 );
+        if ( !_charBuffer ) {
+            return _errorID;
+        }
+        _charBufferSize = size;
+        _charBufferDeleter = DeleteCharBuffer;
         //将文件读到_charBuffer
         size_t read = fread( _charBuffer, 1, size, fp );
         if ( read != size ) {
@@ -2013,6 +5699,220 @@ namespace tinyxml2{
         return _errorID;
     }
 
+    //批量处理的参数，每个任务处理其中一个文档
+    struct BatchJob {
+        XMLDocument* const* documents;
+        const char* const*  names;          //文件名或者数据
+        const size_t*       lengths;        //数据长度，0表示整个数组都按strlen计算
+        bool                compact;
+        XMLError*           results;
+    };
+
+    static void RunLoadFile( void* context, int index )
+    {
+        BatchJob* job = static_cast<BatchJob*>( context );
+        const XMLError error = job->documents[index]->LoadFile( job->names[index] );
+        if ( job->results ) {
+            job->results[index] = error;
+        }
+    }
+
+    static void RunParse( void* context, int index )
+    {
+        BatchJob* job = static_cast<BatchJob*>( context );
+        const size_t len = job->lengths ? job->lengths[index] : (size_t)(-1);
+        const XMLError error = job->documents[index]->Parse( job->names[index], len );
+        if ( job->results ) {
+            job->results[index] = error;
+        }
+    }
+
+    static void RunSaveFile( void* context, int index )
+    {
+        BatchJob* job = static_cast<BatchJob*>( context );
+        const XMLError error = job->documents[index]->SaveFile( job->names[index], job->compact );
+        if ( job->results ) {
+            job->results[index] = error;
+        }
+    }
+
+    //出错的文档数
+    static int CountErrors( XMLDocument* const* documents, int count )
+    {
+        int errors = 0;
+        for ( int i = 0; i < count; ++i ) {
+            if ( documents[i]->Error() ) {
+                ++errors;
+            }
+        }
+        return errors;
+    }
+
+    int XMLDocument::LoadFiles( XMLDocument* const* documents, const char* const* filenames, int count, XMLError* results, int threads )
+    {
+        BatchJob job = { documents, filenames, 0, false, results };
+        RunTasks( RunLoadFile, &job, count, ThreadCount( threads ) );
+        return CountErrors( documents, count );
+    }
+
+    int XMLDocument::ParseBuffers( XMLDocument* const* documents, const char* const* xmls, const size_t* nBytes, int count, XMLError* results, int threads )
+    {
+        BatchJob job = { documents, xmls, nBytes, false, results };
+        RunTasks( RunParse, &job, count, ThreadCount( threads ) );
+        return CountErrors( documents, count );
+    }
+
+    int XMLDocument::SaveFiles( XMLDocument* const* documents, const char* const* filenames, int count, bool compact, XMLError* results, int threads )
+    {
+        BatchJob job = { documents, filenames, 0, compact, results };
+        RunTasks( RunSaveFile, &job, count, ThreadCount( threads ) );
+        return CountErrors( documents, count );
+    }
+
+    //每个线程一个，放在线程局部存储中，同时链入池的缓存链表，以便池析构时释放
+    struct XMLDocumentPool::Cache {
+        XMLDocumentPool*            pool;
+        DynArray<XMLDocument*, 8>   documents;
+        Cache*                      prev;
+        Cache*                      next;
+    };
+
+    struct XMLDocumentPool::Local {
+    #ifdef TIXML_USE_THREADS
+        pthread_key_t               key;
+        pthread_mutex_t             lock;       //保护缓存链表
+    #endif
+        Cache*                      caches;
+    };
+
+    XMLDocumentPool::XMLDocumentPool( bool processEntities, Whitespace whitespaceMode ) :
+        _processEntities( processEntities ),
+        _whitespaceMode( whitespaceMode ),
+        _maxDocuments( 4 ),
+        _maxBytes( 16 * 1024 * 1024 ),
+        _local( new Local() )
+    {
+        _local->caches = 0;
+    #ifdef TIXML_USE_THREADS
+        //线程结束时释放其缓存
+        pthread_key_create( &_local->key, DeleteCache );
+        pthread_mutex_init( &_local->lock, 0 );
+    #endif
+    }
+
+    XMLDocumentPool::~XMLDocumentPool()
+    {
+    #ifdef TIXML_USE_THREADS
+        //之后结束的线程不再调用DeleteCache()
+        pthread_key_delete( _local->key );
+    #endif
+        while ( _local->caches ) {
+            DeleteCache( _local->caches );
+        }
+    #ifdef TIXML_USE_THREADS
+        pthread_mutex_destroy( &_local->lock );
+    #endif
+        delete _local;
+    }
+
+    void XMLDocumentPool::SetLimits( int maxDocuments, size_t maxBytes )
+    {
+        _maxDocuments = maxDocuments;
+        _maxBytes = maxBytes;
+    }
+
+    XMLDocumentPool::Cache* XMLDocumentPool::LocalCache()
+    {
+    #ifdef TIXML_USE_THREADS
+        Cache* cache = static_cast<Cache*>( pthread_getspecific( _local->key ) );
+    #else
+        Cache* cache = _local->caches;
+    #endif
+        if ( cache ) {
+            return cache;
+        }
+        cache = new Cache();
+        cache->pool = this;
+        cache->prev = 0;
+    #ifdef TIXML_USE_THREADS
+        pthread_setspecific( _local->key, cache );
+        pthread_mutex_lock( &_local->lock );
+    #endif
+        cache->next = _local->caches;
+        if ( cache->next ) {
+            cache->next->prev = cache;
+        }
+        _local->caches = cache;
+    #ifdef TIXML_USE_THREADS
+        pthread_mutex_unlock( &_local->lock );
+    #endif
+        return cache;
+    }
+
+    //从缓存链表中取下并删除缓存的文档
+    void XMLDocumentPool::DeleteCache( void* arg )
+    {
+        Cache* cache = static_cast<Cache*>( arg );
+        Local* local = cache->pool->_local;
+    #ifdef TIXML_USE_THREADS
+        pthread_mutex_lock( &local->lock );
+    #endif
+        if ( cache->prev ) {
+            cache->prev->next = cache->next;
+        }
+        else {
+            local->caches = cache->next;
+        }
+        if ( cache->next ) {
+            cache->next->prev = cache->prev;
+        }
+    #ifdef TIXML_USE_THREADS
+        pthread_mutex_unlock( &local->lock );
+    #endif
+        while ( !cache->documents.Empty() ) {
+            delete cache->documents.Pop();
+        }
+        delete cache;
+    }
+
+    XMLDocument* XMLDocumentPool::Acquire()
+    {
+        Cache* cache = LocalCache();
+        if ( !cache->documents.Empty() ) {
+            return cache->documents.Pop();
+        }
+        return new XMLDocument( _processEntities, _whitespaceMode );
+    }
+
+    void XMLDocumentPool::Release( XMLDocument* document )
+    {
+        if ( !document ) {
+            return;
+        }
+        //只缓存本池建立的文档：设置相同，不使用分配器；其他文档直接删除
+        TIXMLASSERT( document->ProcessEntities() == _processEntities );
+        TIXMLASSERT( document->WhitespaceMode() == _whitespaceMode );
+        TIXMLASSERT( !document->Allocator() );
+        if ( document->ProcessEntities() != _processEntities || document->WhitespaceMode() != _whitespaceMode || document->Allocator() ) {
+            delete document;
+            return;
+        }
+        //恢复新建文档的设置，下一个取出者不受上一个使用者的影响
+        document->SetMonotonic( false );
+        document->SetPoolBlockSize( TINYXML2_POOL_BLOCK_SIZE );
+        document->Reset();
+        Cache* cache = LocalCache();
+        if ( cache->documents.Size() >= _maxDocuments ) {
+            delete document;
+            return;
+        }
+        //保留的内存超出限制时全部释放，名称表也不再保留
+        if ( document->MemoryStats().total > _maxBytes ) {
+            document->ClearNames();
+        }
+        cache->documents.Push( document );
+    }
+
     void XMLDocument::Print( XMLPrinter* streamer ) const
     {
         if ( streamer ) {
@@ -2040,35 +5940,66 @@ namespace tinyxml2{
     XMLElement* XMLDocument::NewElement( const char* name )
     {
         XMLElement* ele = CreateUnlinkedNode<XMLElement>( _elementPool );
-        ele->SetName( name );
+        if ( ele ) {
+            ele->SetName( name );
+            //名称没有内存保存时不留下空名称的节点，下同
+            if ( !ele->Name() ) {
+                XMLNode::FreeNode( ele );
+                return 0;
+            }
+        }
         return ele;
     }
 
     XMLComment* XMLDocument::NewComment( const char* str )
     {
         XMLComment* comment = CreateUnlinkedNode<XMLComment>( _commentPool );
-        comment->SetValue( str );
+        if ( comment ) {
+            comment->SetValue( str );
+            if ( !comment->Value() ) {
+                XMLNode::FreeNode( comment );
+                return 0;
+            }
+        }
         return comment;
     }
 
     XMLText* XMLDocument::NewText( const char* str )
     {
         XMLText* text = CreateUnlinkedNode<XMLText>( _textPool );
-        text->SetValue( str );
+        if ( text ) {
+            text->SetValue( str );
+            if ( !text->Value() ) {
+                XMLNode::FreeNode( text );
+                return 0;
+            }
+        }
         return text;
     }
 
     XMLDeclaration* XMLDocument::NewDeclaration( const char* str )
     {
         XMLDeclaration* dec = CreateUnlinkedNode<XMLDeclaration>( _commentPool );
-        dec->SetValue( str ? str : "xml version=\"1.0\" encoding=\"UTF-8\"" );
+        if ( dec ) {
+            dec->SetValue( str ? str : "xml version=\"1.0\" encoding=\"UTF-8\"" );
+            if ( !dec->Value() ) {
+                XMLNode::FreeNode( dec );
+                return 0;
+            }
+        }
         return dec;
     }
 
     XMLUnknown* XMLDocument::NewUnknown( const char* str )
     {
         XMLUnknown* unk = CreateUnlinkedNode<XMLUnknown>( _commentPool );
-        unk->SetValue( str );
+        if ( unk ) {
+            unk->SetValue( str );
+            if ( !unk->Value() ) {
+                XMLNode::FreeNode( unk );
+                return 0;
+            }
+        }
         return unk;
     }
 
@@ -2112,13 +6043,100 @@ namespace tinyxml2{
 
     void Clear();
 
+    void XMLDocument::SetMonotonic( bool monotonic )
+    {
+        if ( monotonic != _monotonic ) {
+            Clear();
+            _monotonic = monotonic;
+        }
+    }
+
     void XMLDocument::Clear()
     {
-        //删除孩子节点
-        DeleteChildren();
-        //删除未链接节点
-        while( _unlinked.Size()) {
-            DeleteNode(_unlinked[0]);
+        ClearDocument( false );
+        if ( _spareBuffer ) {
+            FreeMemory( _memory, _spareBuffer, _spareSize );
+        }
+        _spareBuffer = 0;
+        _spareSize = 0;
+    }
+
+    void XMLDocument::Reset()
+    {
+        //只能从头重用的分配器（如XMLRegionAllocator）要求全部归还，解析多次不会累积；其他分配器和new一样保留内存
+        if ( _allocator && _allocator->ReleaseOnReset() ) {
+            ClearNames();
+            return;
+        }
+        //连续Reset()时（例如归还文档池后再解析）保留的内存不变，用过文档时只保留这次用到的部分
+        const bool used = _charBuffer || _strings.Used() || _elementPool.Watermark() || _attributePool.Watermark()
+            || _textPool.Watermark() || _commentPool.Watermark();
+        if ( used ) {
+            if ( !_elementPool.Watermark() ) {
+                _elementPool.Clear();
+            }
+            if ( !_attributePool.Watermark() ) {
+                _attributePool.Clear();
+            }
+            if ( !_textPool.Watermark() ) {
+                _textPool.Clear();
+            }
+            if ( !_commentPool.Watermark() ) {
+                _commentPool.Clear();
+            }
+            if ( !_strings.Used() ) {
+                _strings.Clear();
+            }
+            //这次没有用上次留下的缓存
+            if ( _spareBuffer ) {
+                FreeMemory( _memory, _spareBuffer, _spareSize );
+                _spareBuffer = 0;
+                _spareSize = 0;
+            }
+        }
+        //AllocBuffer()分配的缓存比这次的数据大得不多时留给下次使用
+        if ( _charBuffer && _charBuffer == _allocatedBuffer && _charBufferDeleter == DeleteCharBuffer
+            && _allocatedSize / TINYXML2_RETAIN_FACTOR <= _charBufferSize + 1 ) {
+            _spareBuffer = _charBuffer;
+            _spareSize = _allocatedSize;
+            _allocatedBuffer = 0;
+            _charBufferDeleter = 0;
+        }
+        ClearDocument( true );
+    }
+
+    void XMLDocument::SetPoolBlockSize( int bytes )
+    {
+        _elementPool.SetBlockSize( bytes );
+        _attributePool.SetBlockSize( bytes );
+        _textPool.SetBlockSize( bytes );
+        _commentPool.SetBlockSize( bytes );
+    }
+
+    void XMLDocument::ClearDocument( bool keepMemory )
+    {
+        if ( _monotonic ) {
+            //节点、属性和字符串都不需要析构，索引是仅有的其他内存
+            ReleaseIndexes();
+            DiscardNodes( keepMemory );
+        }
+        else {
+            //删除孩子节点
+            DeleteChildren();
+            //删除未链接节点
+            while( _unlinked.Size()) {
+                DeleteNode(_unlinked[0]);
+            }
+            if ( keepMemory ) {
+                ResetPools();
+            }
+        }
+        //节点都已删除，设置的字符串一起释放
+        if ( keepMemory ) {
+            _strings.Reset();
+        }
+        else {
+            _strings.Clear();
         }
 
     //DEBUG调试错误
@@ -2127,10 +6145,32 @@ namespace tinyxml2{
     #endif
         //清空错误
         ClearError();
-        //释放缓存
-        delete [] _charBuffer;
+        //释放缓存，调用者持有的缓存不释放；AllocBuffer()分配的缓存按分配的方式释放
+        if ( _charBuffer && _charBuffer == _allocatedBuffer && _charBufferDeleter == DeleteCharBuffer ) {
+            FreeMemory( _memory, _charBuffer, _allocatedSize );
+            _allocatedBuffer = 0;
+        }
+        else if ( _charBufferDeleter ) {
+            _charBufferDeleter( _charBuffer, _charBufferSize );
+        }
         _charBuffer = 0;
-        _parsingDepth = 0;
+        _charBufferSize = 0;
+        _charBufferDeleter = 0;
+        //未闭合元素已作为未链接节点删除
+        _openElements.Clear();
+        _openBlocks.Clear();
+        _visitor = 0;
+        _visitSkip = INT_MAX;
+        _parsePrologOnly = true;
+        while ( !_parseBlocks.Empty() ) {
+            const ParseBlock block = _parseBlocks.Pop();
+            FreeMemory( _memory, block.mem, block.size );
+        }
+        FreePending();
+        _pushState = PUSH_IDLE;
+        _pushInputEnded = false;
+        _pushScan = 0;
+        _pushQuote = 0;
 
     //跟踪
     #if 0
@@ -2163,10 +6203,38 @@ namespace tinyxml2{
         target->Clear();
         //复制到目标
         for (const XMLNode* node = this->FirstChild(); node; node = node->NextSibling()) {
-          target->InsertEndChild(node->DeepClone(target));
+          XMLNode* clone = node->DeepClone(target);
+          if (!clone) {
+              return;
+          }
+          target->InsertEndChild(clone);
       }
     }
 
+    XMLName XMLDocument::InternName( const char* name )
+    {
+        if ( !name ) {
+            return XMLName();
+        }
+        return XMLName( _names.Intern( name, strlen( name ) ) );
+    }
+
+    void XMLDocument::ClearNames()
+    {
+        //节点的名称都指向名称表，先删除节点；节点都已删除，内存池也一起释放
+        Clear();
+        DiscardNodes();
+        _names.Clear();
+    }
+
+    XMLName XMLDocument::FindName( const char* name ) const
+    {
+        if ( !name ) {
+            return XMLName();
+        }
+        return XMLName( _names.Find( name, strlen( name ) ) );
+    }
+
     char* XMLDocument::Identify( char* p, XMLNode** node )
     {
         TIXMLASSERT( node );
@@ -2196,51 +6264,52 @@ namespace tinyxml2{
         TIXMLASSERT( sizeof( XMLComment ) == sizeof( XMLUnknown ) );        
         TIXMLASSERT( sizeof( XMLComment ) == sizeof( XMLDeclaration ) );    
         XMLNode* returnNode = 0;
+        //报告第一个非空白字符的行
+        const int lineNum = _parseCurLineNum;
         
         //匹配开始标记
         if ( XMLUtil::StringEqual( p, xmlHeader, xmlHeaderLen ) ) {
             returnNode = CreateUnlinkedNode<XMLDeclaration>( _commentPool );
-            returnNode->_parseLineNum = _parseCurLineNum;
             p += xmlHeaderLen;
         }
         //匹配注释标记
         else if ( XMLUtil::StringEqual( p, commentHeader, commentHeaderLen ) ) {
             returnNode = CreateUnlinkedNode<XMLComment>( _commentPool );
-            returnNode->_parseLineNum = _parseCurLineNum;
             p += commentHeaderLen;
         }
         //匹配cdata标记
         else if ( XMLUtil::StringEqual( p, cdataHeader, cdataHeaderLen ) ) {
             XMLText* text = CreateUnlinkedNode<XMLText>( _textPool );
+            if ( text ) {
+                text->SetCData( true );
+            }
             returnNode = text;
-            returnNode->_parseLineNum = _parseCurLineNum;
             p += cdataHeaderLen;
-            text->SetCData( true );
         }
         //匹配dtd标记
         else if ( XMLUtil::StringEqual( p, dtdHeader, dtdHeaderLen ) ) {
             returnNode = CreateUnlinkedNode<XMLUnknown>( _commentPool );
-            returnNode->_parseLineNum = _parseCurLineNum;
             p += dtdHeaderLen;
         }
         //匹配元素标记
         else if ( XMLUtil::StringEqual( p, elementHeader, elementHeaderLen ) ) {
             returnNode =  CreateUnlinkedNode<XMLElement>( _elementPool );
-            returnNode->_parseLineNum = _parseCurLineNum;
             p += elementHeaderLen;
         }
         //其他清空按文本内容处理
         else {
             returnNode = CreateUnlinkedNode<XMLText>( _textPool );
-            //报告第一个非空白字符的行
-            returnNode->_parseLineNum = _parseCurLineNum; 
             p = start;  // 备份
             _parseCurLineNum = startLine;
         }
 
-        TIXMLASSERT( returnNode );
         TIXMLASSERT( p );
         *node = returnNode;
+        //内存不足，错误已经设置
+        if ( !returnNode ) {
+            return p;
+        }
+        returnNode->_parseLineNum = lineNum;
         return p;
     }
 
@@ -2248,13 +6317,18 @@ namespace tinyxml2{
     {
         TIXMLASSERT(node);
         TIXMLASSERT(node->_parent == 0);
-        //如果没有父节点则删除
-        for (int i = 0; i < _unlinked.Size(); ++i) {
-            if (node == _unlinked[i]) {
-                _unlinked.SwapRemove(i);
-                break;
-            }
+        //节点记录了自己的位置，用最后一个节点填补空位
+        const int i = node->_unlinkedIndex;
+        if ( i < 0 ) {
+            return;
+        }
+        TIXMLASSERT( _unlinked[i] == node );
+        XMLNode* last = _unlinked.Pop();
+        if ( last != node ) {
+            _unlinked[i] = last;
+            last->_unlinkedIndex = i;
         }
+        node->_unlinkedIndex = -1;
     }
 
     void XMLPrinter::PrintString( const char* p, bool restricted )
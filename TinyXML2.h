@@ -13,12 +13,23 @@
 //诊断宏，判断是否为零值
 #define TIXMLASSERT( x )	{}	
 
-//限制元素深度，避免堆栈溢出
+//已废弃：解析不再递归，元素深度不受限制；保留此常量只为兼容引用它的代码
 static const int TINYXML2_MAX_ELEMENT_DEPTH = 100;
 
+//内存池每块的默认大小（字节），可以用XMLDocument::SetPoolBlockSize()修改
+#ifndef TINYXML2_POOL_BLOCK_SIZE
+#define TINYXML2_POOL_BLOCK_SIZE (4 * 1024)
+#endif
+
+//XMLDocument::Reset()保留的内存超过这次用量的倍数，超过时按这次的用量重新分配，一次很大的解析不会让之后的小解析一直占着峰值内存
+#ifndef TINYXML2_RETAIN_FACTOR
+#define TINYXML2_RETAIN_FACTOR 4
+#endif
+
 namespace tinyxml2{
 	//以下是文档解析需要实现的类,需要提前声明
 	class XMLDocument;
+    class XMLNode;
     class XMLElement;
     class XMLAttribute;
     class XMLComment;
@@ -26,6 +37,12 @@ namespace tinyxml2{
     class XMLDeclaration;
     class XMLUnknown;
     class XMLPrinter;
+    class XMLReader;
+    class XMLCompactDocument;
+    class StrArena;
+    class XMLNameTable;
+    class XMLAttributeIndex;
+    class XMLChildIndex;
     
     //警告，需匹配相应的名称
     enum XMLError {
@@ -48,9 +65,74 @@ namespace tinyxml2{
         XML_CAN_NOT_CONVERT_TEXT,
         XML_NO_TEXT_NODE,
         XML_ELEMENT_DEPTH_EXCEEDED,
+        XML_ERROR_OUT_OF_MEMORY,
 
         XML_ERROR_COUNT
     };
+
+    //内存分配器：文档的内存池、解析缓存、字符串分配区和名称表从这里分配，索引和各种小数组仍用new
+    //分配失败时返回0，文档报告XML_ERROR_OUT_OF_MEMORY。分配器应比使用它的文档存在得久，不要求线程安全
+    class TINYXML2_LIB XMLAllocator
+    {
+    public:
+        virtual ~XMLAllocator() {}
+        virtual void* Allocate( size_t size ) = 0;
+        //size与分配时相同
+        virtual void Free( void* mem, size_t size ) = 0;
+        //为true时文档在XMLDocument::Reset()中把内存全部归还，用于只能从头重用的分配器；默认保留内存重复使用
+        virtual bool ReleaseOnReset() const {
+            return false;
+        }
+    };
+
+    //allocator为0时用new和delete
+    inline void* AllocMemory( XMLAllocator* allocator, size_t size ) {
+        return allocator ? allocator->Allocate( size ) : new char[size];
+    }
+
+    inline void FreeMemory( XMLAllocator* allocator, void* mem, size_t size ) {
+        if ( allocator ) {
+            allocator->Free( mem, size );
+        }
+        else {
+            delete [] static_cast<char*>( mem );
+        }
+    }
+
+    //固定区域：从调用者提供的内存中顺序分配，用完后分配失败，不向系统申请
+    //释放的内存在区域末尾时才收回，分配的内存全部释放后从头开始；Reset()收回全部，调用前使用它的文档应已析构或Clear()
+    class TINYXML2_LIB XMLRegionAllocator : public XMLAllocator
+    {
+    public:
+        //code
+        XMLRegionAllocator( void* region, size_t size );
+
+        virtual void* Allocate( size_t size );
+        virtual void Free( void* mem, size_t size );
+        //中间释放的内存不能重用，使用它的文档每次解析前全部归还
+        virtual bool ReleaseOnReset() const {
+            return true;
+        }
+
+        void Reset() {
+            _used = 0;
+            _live = 0;
+        }
+        size_t Used() const {
+            return _used;
+        }
+        size_t Size() const {
+            return _size;
+        }
+
+    private:
+        //code
+        enum { ALIGN = 2 * sizeof( void* ) };
+        char*   _region;
+        size_t  _size;
+        size_t  _used;
+        size_t  _live;      //尚未释放的字节数
+    };
     
     //code
     class StrPair{
@@ -90,7 +172,9 @@ namespace tinyxml2{
              _start = const_cast<char*>(str);
          }
 
-         void SetStr( const char* str, int flags=0 );
+         //arena不为0时复制到分配区中，之前放在分配区中的字符串够长时原地覆盖；分配区没有内存时不改变
+         //内存不足时返回false，原来的字符串不变
+         bool SetStr( const char* str, int flags=0, StrArena* arena=0 );
 
         const char* GetStr();
 		
@@ -100,10 +184,16 @@ namespace tinyxml2{
 
         char* ParseText( char* in, const char* endTag, int strFlags, int* curLineNumPtr );
 
-        char* ParseName( char* in );
+        //名称保存到names中，本对象指向names中的副本
+        char* ParseName( char* in, XMLNameTable* names );
 
         void TransferTo( StrPair* other );
 
+        //自己分配的（堆上或分配区中的）字符串的字节数，指向缓存或名称表时为0
+        size_t OwnedBytes() const {
+            return ( _flags & ( NEEDS_DELETE | IN_ARENA ) ) ? _end - _start + 1 : 0;
+        }
+
 	private:
 		//code
 		int     _flags;
@@ -111,11 +201,11 @@ namespace tinyxml2{
 		char*   _end;
 		enum {
     		NEEDS_FLUSH = 0x100,
-    		NEEDS_DELETE = 0x200
+    		NEEDS_DELETE = 0x200,
+    		IN_ARENA = 0x400		//内存属于分配区，不单独释放
 		};
         StrPair( const StrPair& other );            // 不需要实现
         void operator=( const StrPair& other );     // 不需要实现，使用TransferTo()替代
-        void CollapseWhitespace();
 	};
 
     template <class T, int INITIAL_SIZE>
@@ -203,6 +293,18 @@ namespace tinyxml2{
             --_size;
         }
 
+        //释放多余的容量
+        void Shrink() {
+            if ( _mem == _pool || _allocated == _size ) {
+                return;
+            }
+            T* newMem = ( _size <= INITIAL_SIZE ) ? _pool : new T[_size];
+            memcpy( newMem, _mem, sizeof(T)*_size );
+            delete [] _mem;
+            _mem = newMem;
+            _allocated = ( _size <= INITIAL_SIZE ) ? INITIAL_SIZE : _size;
+        }
+
         T* Mem()    {
             TIXMLASSERT( _mem );
             return _mem;
@@ -246,6 +348,225 @@ namespace tinyxml2{
         int _size;                  //元素数量
     };
 
+    //分配区：从大块内存中顺序分配，不单独释放，Clear()时整体释放
+    class StrArena
+    {
+    public:
+        //code
+        StrArena();
+        ~StrArena();
+
+        //按指针大小对齐，分配器没有内存时返回0
+        char* Alloc( size_t size );
+        void Clear();
+        //块从allocator分配，应在分配之前设置
+        void SetAllocator( XMLAllocator* allocator ) {
+            _allocator = allocator;
+        }
+        //丢弃分配的内容但保留内存，块数多于一个时合并成一块，之后同样的用量不再分配
+        //保留的块超过这次用量的TINYXML2_RETAIN_FACTOR倍时按这次的用量重新分配
+        void Reset();
+        //上次Clear()或Reset()之后分配过
+        bool Used() const {
+            return _used > 0;
+        }
+        //占用的内存字节数
+        size_t Bytes() const {
+            return _bytes;
+        }
+
+    private:
+        //code
+        StrArena( const StrArena& );            //不实现
+        void operator=( const StrArena& );      //不实现
+
+        enum { BLOCK_SIZE = 4096 };
+        struct Block {
+            char*   mem;
+            size_t  size;
+        };
+        char* NewBlock( size_t size );
+
+        DynArray<Block, 8>      _blocks;        //存储块
+        XMLAllocator*           _allocator;
+        char*                   _cursor;        //当前块中的空闲位置
+        size_t                  _available;     //当前块剩余的字节数
+        size_t                  _used;          //上次Clear()或Reset()之后分配的字节数
+        size_t                  _reserved;      //Reset()分配的唯一一块的大小，0表示没有
+        size_t                  _bytes;         //全部块的大小之和
+    };
+
+    //名称表：每个名称只保存一份，同名的元素和属性共用同一个指针，比较名称只需比较指针
+    //名称保存到表析构或Clear()为止，前面留有一个指针的位置，用来记录合并到其他表后的副本
+    class XMLNameTable
+    {
+    public:
+        //code
+        XMLNameTable();
+        ~XMLNameTable();
+
+        //返回名称在表中的副本，没有时加入；分配器没有内存时返回0
+        const char* Intern( const char* str, size_t len );
+        //返回名称在表中的副本，没有时返回0
+        const char* Find( const char* str, size_t len ) const;
+        //释放全部名称，之前返回的副本都失效
+        void Clear();
+
+        //把other中的名称全部加入本表，之后Forward()返回other中的名称在本表中的副本
+        void Merge( XMLNameTable& other );
+        static const char* Forward( const char* name ) {
+            return reinterpret_cast<const char* const*>( name )[-1];
+        }
+        //占用的内存字节数
+        size_t Bytes() const {
+            return _capacity * sizeof( Slot ) + _arena.Bytes();
+        }
+        void SetAllocator( XMLAllocator* allocator ) {
+            _allocator = allocator;
+            _arena.SetAllocator( allocator );
+        }
+
+    private:
+        //code
+        XMLNameTable( const XMLNameTable& );        //不实现
+        void operator=( const XMLNameTable& );      //不实现
+
+        struct Slot {
+            const char* str;
+            unsigned    hash;
+            unsigned    length;
+        };
+        static unsigned Hash( const char* str, size_t len );
+        const Slot* Lookup( const char* str, size_t len, unsigned hash ) const;
+        const char* Store( const char* str, size_t len );
+        bool Grow();
+
+        Slot*                   _slots;         //开放寻址的散列表，容量为2的幂
+        int                     _capacity;
+        int                     _count;
+        StrArena                _arena;         //名称的存储
+        XMLAllocator*           _allocator;     //散列表的分配器
+    };
+
+    //属性索引：按名称指针散列，属性较多的元素用它代替遍历属性表
+    //Clear()只改变标记，不清零也不释放，可以反复用于不同的元素
+    class XMLAttributeIndex
+    {
+    public:
+        //code
+        //usage不为0时，索引占用的内存计入*usage
+        explicit XMLAttributeIndex( size_t* usage = 0 );
+        ~XMLAttributeIndex();
+
+        void Clear();
+        bool Empty() const {
+            return _count == 0;
+        }
+        //清空后按顺序加入first开始的全部属性
+        void Build( XMLAttribute* first );
+        //加入属性，同名属性已存在时返回false
+        bool Insert( XMLAttribute* attrib );
+        //name必须是名称表中的副本
+        XMLAttribute* Find( const char* name ) const;
+        //最后加入的属性，即属性表的末尾
+        XMLAttribute* Last() const {
+            return _last;
+        }
+        //占用的内存字节数
+        size_t Bytes() const {
+            return sizeof( *this ) + _capacity * sizeof( Slot );
+        }
+
+    private:
+        //code
+        XMLAttributeIndex( const XMLAttributeIndex& );      //不实现
+        void operator=( const XMLAttributeIndex& );         //不实现
+
+        struct Slot {
+            const char*     name;
+            XMLAttribute*   attrib;
+            unsigned        stamp;          //与_stamp不同的槽为空
+        };
+        int Lookup( const char* name ) const;
+        void Grow();
+
+        Slot*           _slots;             //开放寻址的散列表，容量为2的幂
+        int             _capacity;
+        int             _count;
+        unsigned        _stamp;
+        XMLAttribute*   _last;
+        size_t*         _usage;
+    };
+
+    //子元素索引：按名称记录同名子元素的有序链表，子节点很多的元素用它代替遍历
+    //只记录元素；由XMLNode的插入和断开操作维护，Clear()之后失效，下次按名称查找时重建
+    class XMLChildIndex
+    {
+    public:
+        //code
+        //usage不为0时，索引占用的内存计入*usage
+        explicit XMLChildIndex( size_t* usage = 0 );
+        ~XMLChildIndex();
+
+        void Clear();
+        bool Valid() const {
+            return _valid;
+        }
+        //按顺序加入parent的全部子元素
+        void Build( const XMLNode* parent );
+        void Append( XMLElement* element );
+        void Prepend( XMLElement* element );
+        void Remove( const XMLElement* element );
+
+        //name必须是名称表中的副本
+        XMLElement* First( const char* name ) const;
+        XMLElement* Last( const char* name ) const;
+        //与element同名的前后兄弟元素
+        XMLElement* Next( const XMLElement* element ) const;
+        XMLElement* Previous( const XMLElement* element ) const;
+        //占用的内存字节数
+        size_t Bytes() const {
+            return sizeof( *this ) + _capacity * ( sizeof( NameSlot ) + sizeof( ChildSlot ) );
+        }
+
+    private:
+        //code
+        XMLChildIndex( const XMLChildIndex& );      //不实现
+        void operator=( const XMLChildIndex& );     //不实现
+
+        struct NameSlot {
+            const char*         name;       //0表示空槽
+            XMLElement*         first;
+            XMLElement*         last;
+        };
+        struct ChildSlot {
+            const XMLElement*   child;      //0表示空槽
+            XMLElement*         prev;       //同名的前一个元素
+            XMLElement*         next;       //同名的后一个元素
+        };
+        NameSlot* FindName( const char* name ) const;
+        NameSlot* AddName( const char* name );
+        ChildSlot* FindChild( const XMLElement* element ) const;
+        ChildSlot* AddChild( const XMLElement* element );
+        void Grow();
+
+        NameSlot*       _names;             //开放寻址的散列表，两表容量相同且为2的幂
+        ChildSlot*      _children;
+        int             _capacity;
+        int             _nameCount;
+        int             _childCount;
+        bool            _valid;
+        size_t*         _usage;
+    };
+
+    //内存池的统计
+    struct XMLPoolStats {
+        int     current;        //正在使用的项数
+        int     watermark;      //上次Clear()或Reset()之后同时使用的最大项数
+        int     blocks;         //块数
+        size_t  bytes;          //全部块占用的字节数
+    };
+
     class MemPool
     {
     public:
@@ -262,8 +583,8 @@ namespace tinyxml2{
     class MemPoolT : public MemPool{
     public:
         //code
-        enum { ITEMS_PER_BLOCK = (4 * 1024) / ITEM_SIZE };
-        MemPoolT() : _blockPtrs(), _root(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)  {}
+        MemPoolT() : _blockPtrs(), _allocator(0), _itemsPerBlock( BlockItems( TINYXML2_POOL_BLOCK_SIZE ) ), _root(0), _next(0), _end(0),
+            _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)  {}
         ~MemPoolT() {
             MemPoolT< ITEM_SIZE >::Clear();
         }
@@ -271,17 +592,71 @@ namespace tinyxml2{
         void Clear() {
             // 删除块
             while( !_blockPtrs.Empty()) {
-                Block* lastBlock = _blockPtrs.Pop();
-                delete lastBlock;
+                FreeBlock( _blockPtrs.Pop() );
             }
             //初始化
             _root = 0;
+            _next = _end = 0;
             _currentAllocs = 0;
             _nAllocs = 0;
             _maxAllocs = 0;
             _nUntracked = 0;
         }
 
+        //所有项都已不再使用时回收，保留内存；块数多于一个时按这次的最大分配数合并成一块，之后同样规模的使用不再分配
+        //这次没有分配过时不变；保留的容量超过这次最大分配数的TINYXML2_RETAIN_FACTOR倍时按这次的用量重新分配
+        void Reset() {
+            int capacity = 0;
+            for ( int i = 0; i < _blockPtrs.Size(); ++i ) {
+                capacity += _blockPtrs[i].count;
+            }
+            const int keep = _maxAllocs > _itemsPerBlock ? _maxAllocs : _itemsPerBlock;
+            if ( _maxAllocs && ( _blockPtrs.Size() > 1 || capacity < _maxAllocs || capacity / TINYXML2_RETAIN_FACTOR > keep ) ) {
+                while( !_blockPtrs.Empty()) {
+                    FreeBlock( _blockPtrs.Pop() );
+                }
+                //分配失败时留到Alloc()时再分配
+                _next = _end = 0;
+                NewBlock( keep );
+            }
+            else if ( capacity ) {
+                _next = _blockPtrs[0].items;
+                _end = _next + capacity;
+            }
+            _root = 0;
+            _currentAllocs = 0;
+            _maxAllocs = 0;
+            _nUntracked = 0;
+        }
+
+        //之后新分配的块的大小（字节），已有的块不变
+        void SetBlockSize( int bytes ) {
+            _itemsPerBlock = BlockItems( bytes );
+        }
+
+        //块从allocator分配，应在分配之前设置
+        void SetAllocator( XMLAllocator* allocator ) {
+            _allocator = allocator;
+        }
+
+        //全部块占用的内存字节数
+        size_t Bytes() const {
+            size_t bytes = 0;
+            for ( int i = 0; i < _blockPtrs.Size(); ++i ) {
+                bytes += _blockPtrs[i].count * sizeof( Item );
+            }
+            return bytes;
+        }
+
+        XMLPoolStats Stats() const {
+            XMLPoolStats stats;
+            stats.current = _currentAllocs;
+            stats.watermark = _maxAllocs;
+            stats.blocks = _blockPtrs.Size();
+            stats.bytes = Bytes();
+            return stats;
+        }
+
         virtual int ItemSize() const    {
             return ITEM_SIZE;
         }
@@ -290,23 +665,25 @@ namespace tinyxml2{
             return _currentAllocs;
         }
 
+        int Watermark() const       {
+            return _maxAllocs;
+        }
+
+        //分配器没有内存时返回0
         virtual void* Alloc() {
-            if ( !_root ) {
+            //先用释放的项，再从最后一块中顺序取
+            Item* result = _root;
+            if ( result ) {
+                _root = result->next;
+            }
+            else {
                 // 需要一个新的块
-                Block* block = new Block();
-                _blockPtrs.Push( block );
-                //把块的内容复制到节点
-                Item* blockItems = block->items;
-                for( int i = 0; i < ITEMS_PER_BLOCK - 1; ++i ) {
-                    blockItems[i].next = &(blockItems[i + 1]);
+                if ( _next == _end && !NewBlock( _itemsPerBlock ) ) {
+                    return 0;
                 }
-                blockItems[ITEMS_PER_BLOCK - 1].next = 0;
-                _root = blockItems;
+                result = _next++;
             }
-            //设置结果为常量
-            Item* const result = _root;
             TIXMLASSERT( result != 0 );
-            _root = _root->next;
 
             //更新状态
             ++_currentAllocs;
@@ -349,6 +726,39 @@ namespace tinyxml2{
             return _nUntracked;
         }
 
+        //接管other的全部块，other中已分配的项由调用者改指到本池
+        void Adopt( MemPoolT& other ) {
+            TIXMLASSERT( _allocator == other._allocator );
+            for ( int i = 0; i < other._blockPtrs.Size(); ++i ) {
+                _blockPtrs.Push( other._blockPtrs[i] );
+            }
+            //other最后一块中未用过的项放进空闲链表
+            for ( Item* item = other._next; item != other._end; ++item ) {
+                item->next = other._root;
+                other._root = item;
+            }
+            //空闲链表接到本池的前面
+            if ( other._root ) {
+                Item* last = other._root;
+                while ( last->next ) {
+                    last = last->next;
+                }
+                last->next = _root;
+                _root = other._root;
+            }
+            _currentAllocs += other._currentAllocs;
+            _nAllocs += other._nAllocs;
+            _maxAllocs += other._maxAllocs;
+            _nUntracked += other._nUntracked;
+            other._blockPtrs.Clear();
+            other._root = 0;
+            other._next = other._end = 0;
+            other._currentAllocs = 0;
+            other._nAllocs = 0;
+            other._maxAllocs = 0;
+            other._nUntracked = 0;
+        }
+
     private:
         //code
         MemPoolT( const MemPoolT& );        //不实现
@@ -360,12 +770,40 @@ namespace tinyxml2{
         };
 
         struct Block {
-            Item items[ITEMS_PER_BLOCK];
+            Item*   items;
+            int     count;
         };
+
+        static int BlockItems( int bytes ) {
+            return bytes > ITEM_SIZE ? bytes / ITEM_SIZE : 1;
+        }
+
+        //新块中的项不串成链表，由Alloc()顺序取用
+        bool NewBlock( int count ) {
+            Block block;
+            block.items = static_cast<Item*>( AllocMemory( _allocator, count * sizeof( Item ) ) );
+            if ( !block.items ) {
+                return false;
+            }
+            block.count = count;
+            _blockPtrs.Push( block );
+            _next = block.items;
+            _end = _next + count;
+            return true;
+        }
+
+        void FreeBlock( const Block& block ) {
+            FreeMemory( _allocator, block.items, block.count * sizeof( Item ) );
+        }
+
         //定义一个动态数组
-        DynArray< Block*, 10 > _blockPtrs;
+        DynArray< Block, 10 > _blockPtrs;
+        XMLAllocator* _allocator;   //0表示用new
+        int _itemsPerBlock;         //每块的项数
         //定义根节点
         Item* _root;
+        Item* _next;                //最后一块中未用过的项
+        Item* _end;
 
         int _currentAllocs;         //当前分配数
         int _nAllocs;               //分配总次数
@@ -418,22 +856,19 @@ namespace tinyxml2{
             return ( p & 0x80 ) != 0;
         }
 
+        //查表判断空白，不依赖区域设置
         static bool IsWhiteSpace( char p ){
-            return !IsUTF8Continuation(p) && isspace( static_cast<unsigned char>(p) );
+            return ( _charClass[static_cast<unsigned char>(p)] & CHAR_WHITESPACE ) != 0;
         }
         
         static const char* SkipWhiteSpace( const char* p, int* curLineNumPtr )  {
             TIXMLASSERT( p );
-            
-            //如果是空白，则需考虑换行
-            while( IsWhiteSpace(*p) ) {
-                if (curLineNumPtr && *p == '\n') {
-                    ++(*curLineNumPtr);
-                }
-                ++p;
+            //多数位置没有空白，直接返回
+            if ( !IsWhiteSpace(*p) ) {
+                return p;
             }
-            TIXMLASSERT( p );
-            return p;
+            //如果是空白，则需考虑换行
+            return SkipWhiteSpaceRun( p, curLineNumPtr );
         }
 
         static char* SkipWhiteSpace( char* p, int* curLineNumPtr )              {
@@ -441,21 +876,14 @@ namespace tinyxml2{
             return const_cast<char*>( SkipWhiteSpace( const_cast<const char*>(p), curLineNumPtr ) );
         }
 
+        //字母、':'、'_'以及所有>=128的字节
         inline static bool IsNameStartChar( unsigned char ch ) {
-            if ( ch >= 128 ) {
-                return true;
-            }
-            if ( isalpha( ch ) ) {
-                return true;
-            }
-            return ch == ':' || ch == '_';
+            return ( _charClass[ch] & CHAR_NAME_START ) != 0;
         }
 
+        //名称起始字符、十进制数字、'.'和'-'
         inline static bool IsNameChar( unsigned char ch ) {
-            return IsNameStartChar( ch )
-            || isdigit( ch )        //检查是否为十进制数字
-            || ch == '.'
-            || ch == '-';
+            return ( _charClass[ch] & CHAR_NAME ) != 0;
         }
 
         inline static bool StringEqual( const char* p, const char* q, int nChar=INT_MAX )  {
@@ -482,6 +910,8 @@ namespace tinyxml2{
         static void ToStr( double v, char* buffer, int bufferSize );
         static void ToStr(int64_t v, char* buffer, int bufferSize);
 
+        //不依赖区域设置；整个字符串（前后空白除外）必须是一个十进制数，溢出时失败
+        //浮点数还接受inf、infinity和nan，结果是正确舍入的
         static bool ToInt( const char* str, int* value );
         static bool ToUnsigned( const char* str, unsigned* value );
         static bool ToBool( const char* str, bool* value );
@@ -491,11 +921,51 @@ namespace tinyxml2{
 
     private:
         //code
+        //字符分类标记
+        enum {
+            CHAR_WHITESPACE = 0x01,
+            CHAR_NAME_START = 0x02,
+            CHAR_NAME       = 0x04
+        };
+
+        static const char* SkipWhiteSpaceRun( const char* p, int* curLineNumPtr );
+
+        static const unsigned char _charClass[256];     //字符分类表
         static const char* writeBoolTrue;
         static const char* writeBoolFalse;
     
     };
 
+    //名称键：由XMLDocument::InternName()取得，同一文档中同名的键相等
+    //用键查找元素和属性时只比较指针，键在文档析构或ClearNames()之前一直有效
+    class TINYXML2_LIB XMLName
+    {
+        friend class XMLDocument;
+        friend class XMLElement;
+    public:
+        XMLName() : _str( 0 ) {}
+
+        const char* Str() const {
+            return _str;
+        }
+
+        bool Empty() const {
+            return _str == 0;
+        }
+
+        bool operator==( const XMLName& other ) const {
+            return _str == other._str;
+        }
+
+        bool operator!=( const XMLName& other ) const {
+            return _str != other._str;
+        }
+
+    private:
+        explicit XMLName( const char* str ) : _str( str ) {}
+        const char* _str;
+    };
+
     class TINYXML2_LIB XMLNode{
         
         friend class XMLDocument;
@@ -608,6 +1078,15 @@ namespace tinyxml2{
             return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->PreviousSiblingElement( name ) );
         }
 
+        //按名称键查找，只比较指针；空键（如FindName()找不到的名称）不匹配任何元素，查找任意元素用name为0
+        const XMLElement*   PreviousSiblingElement( XMLName name ) const;
+
+        XMLElement* PreviousSiblingElement( XMLName name ) {
+            return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->PreviousSiblingElement( name ) );
+        }
+
+        //子节点较多的元素在第一次按名称查找时建立子元素索引，之后的按名称查找不再遍历
+        //建立索引会修改元素，不要在多个线程中同时查找同一元素的子元素；不同元素可以同时查找
         const XMLElement* FirstChildElement( const char* name = 0 ) const;
 
         XMLElement* FirstChildElement( const char* name = 0 )   {
@@ -615,6 +1094,12 @@ namespace tinyxml2{
             return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->FirstChildElement( name ));
         }
 
+        const XMLElement* FirstChildElement( XMLName name ) const;
+
+        XMLElement* FirstChildElement( XMLName name )   {
+            return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->FirstChildElement( name ));
+        }
+
         const XMLElement* LastChildElement( const char* name = 0 ) const;
 
         XMLElement* LastChildElement( const char* name = 0 )    {
@@ -622,6 +1107,12 @@ namespace tinyxml2{
             return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->LastChildElement(name) );
         }
 
+        const XMLElement* LastChildElement( XMLName name ) const;
+
+        XMLElement* LastChildElement( XMLName name )    {
+            return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->LastChildElement(name) );
+        }
+
         const XMLNode*  NextSibling() const                     {
             return _next;
         }
@@ -636,6 +1127,12 @@ namespace tinyxml2{
             return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->NextSiblingElement( name ) );
         }
 
+        const XMLElement*   NextSiblingElement( XMLName name ) const;
+
+        XMLElement* NextSiblingElement( XMLName name )  {
+            return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->NextSiblingElement( name ) );
+        }
+
 
         XMLNode* InsertEndChild( XMLNode* addThis );
 
@@ -668,12 +1165,11 @@ namespace tinyxml2{
         explicit XMLNode( XMLDocument* );
         virtual ~XMLNode();
 
-        virtual char* ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr);
-
         XMLDocument*    _document;
         XMLNode*        _parent;
         mutable StrPair _value;             //被mutable修饰的变量，将永远处于可变的状态，包括const修饰下
         int             _parseLineNum;
+        int             _unlinkedIndex;     //在文档_unlinked中的位置，-1表示已链接
         //节点
         XMLNode*        _firstChild;
         XMLNode*        _lastChild;
@@ -686,10 +1182,14 @@ namespace tinyxml2{
         void Unlink( XMLNode* child );
 
         static void DeleteNode( XMLNode* node );
+        static void FreeNode( XMLNode* node );
 
         void InsertChildPreamble( XMLNode* insertThis ) const;
 
-        const XMLElement* ToElementWithName( const char* name ) const;
+        const XMLElement* ToElementWithName( XMLName name ) const;
+        static const XMLElement* FirstElement( const XMLNode* node, bool forward );
+        XMLChildIndex* ChildIndex() const;
+        XMLChildIndex* BuildChildIndex() const;
 
         XMLNode( const XMLNode& );              //无需实现
         XMLNode& operator=( const XMLNode& );   //无需实现
@@ -843,6 +1343,8 @@ namespace tinyxml2{
     class TINYXML2_LIB XMLAttribute
     {
         friend class XMLElement;
+        friend class XMLDocument;
+        friend class XMLAttributeIndex;
     public:
         //code
         const char* Name() const;
@@ -922,7 +1424,7 @@ namespace tinyxml2{
     private:
         //code
 
-        XMLAttribute() : _name(), _value(),_parseLineNum( 0 ), _next( 0 ), _memPool( 0 ) {}
+        XMLAttribute() : _name(), _value(),_parseLineNum( 0 ), _next( 0 ), _document( 0 ) {}
 
         virtual ~XMLAttribute() {}
 
@@ -931,20 +1433,21 @@ namespace tinyxml2{
 
         void SetName( const char* name );
 
-        char* ParseDeep( char* p, bool processEntities, int* curLineNumPtr );
+        char* ParseDeep( char* p, bool processEntities, XMLNameTable* names, int* curLineNumPtr );
 
         enum { BUF_SIZE = 200 };        //内存池大小
         mutable StrPair _name;
         mutable StrPair _value;
         int             _parseLineNum;
         XMLAttribute*   _next;
-        MemPool*        _memPool;
+        XMLDocument*    _document;          //内存池和字符串分配区所在的文档
         
     };
 
     class TINYXML2_LIB XMLElement: public XMLNode
     {
         friend class XMLDocument;
+        friend class XMLNode;
     public:
         //code
         enum ElementClosingType {
@@ -971,6 +1474,8 @@ namespace tinyxml2{
 
         virtual bool Accept( XMLVisitor* visitor ) const;
 
+        //属性较多的元素在第一次按名称查找属性时建立属性索引，Attribute()、FindAttribute()和Query*Attribute()都会
+        //建立索引会修改元素，不要在多个线程中同时查找同一元素的属性；不同元素可以同时查找
         const char* Attribute( const char* name, const char* value=0 ) const;
 
         XMLError QueryIntAttribute( const char* name, int* value ) const
@@ -1072,39 +1577,45 @@ namespace tinyxml2{
           return QueryFloatAttribute( name, value );
         }
 
+        //内存不足时不添加属性，已有的属性保持原值
         void SetAttribute( const char* name, const char* value )    {
-            XMLAttribute* a = FindOrCreateAttribute( name );
-            a->SetAttribute( value );
+            FindOrCreateAttribute( name, value );
         }
 
         void SetAttribute( const char* name, int value )            {
-            XMLAttribute* a = FindOrCreateAttribute( name );
-            a->SetAttribute( value );
+            char buf[BUF_SIZE];
+            XMLUtil::ToStr( value, buf, BUF_SIZE );
+            FindOrCreateAttribute( name, buf );
         }
 
         void SetAttribute( const char* name, unsigned value )       {
-            XMLAttribute* a = FindOrCreateAttribute( name );
-            a->SetAttribute( value );
+            char buf[BUF_SIZE];
+            XMLUtil::ToStr( value, buf, BUF_SIZE );
+            FindOrCreateAttribute( name, buf );
         }
 
         void SetAttribute(const char* name, int64_t value) {
-          XMLAttribute* a = FindOrCreateAttribute(name);
-          a->SetAttribute(value);
+          char buf[BUF_SIZE];
+          XMLUtil::ToStr( value, buf, BUF_SIZE );
+          FindOrCreateAttribute( name, buf );
         }
 
         void SetAttribute( const char* name, bool value )           {
-            XMLAttribute* a = FindOrCreateAttribute( name );
-            a->SetAttribute( value );
+            char buf[BUF_SIZE];
+            XMLUtil::ToStr( value, buf, BUF_SIZE );
+            FindOrCreateAttribute( name, buf );
         }
 
         void SetAttribute( const char* name, double value )     {
-            XMLAttribute* a = FindOrCreateAttribute( name );
-            a->SetAttribute( value );
+            char buf[BUF_SIZE];
+            XMLUtil::ToStr( value, buf, BUF_SIZE );
+            FindOrCreateAttribute( name, buf );
         }
 
         void SetAttribute( const char* name, float value )      {
-            XMLAttribute* a = FindOrCreateAttribute( name );
-            a->SetAttribute( value );
+            char buf[BUF_SIZE];
+            XMLUtil::ToStr( value, buf, BUF_SIZE );
+            FindOrCreateAttribute( name, buf );
         }
 
         void DeleteAttribute( const char* name );
@@ -1113,7 +1624,10 @@ namespace tinyxml2{
             return _rootAttribute;
         }
 
+        //可能建立属性索引，见Attribute()
         const XMLAttribute* FindAttribute( const char* name ) const;
+        //按名称键查找，只比较指针
+        const XMLAttribute* FindAttribute( XMLName name ) const;
 
         const char* GetText() const;
 
@@ -1178,14 +1692,20 @@ namespace tinyxml2{
         XMLAttribute* CreateAttribute();
 
         static void DeleteAttribute( XMLAttribute* attribute );
+        static void FreeAttribute( XMLAttribute* attribute );
+        void FreeAttributes();
 
-        XMLAttribute* FindOrCreateAttribute( const char* name );
+        //设置name属性的值，没有时新建；内存不足时返回0，新属性不会留在属性表中
+        XMLAttribute* FindOrCreateAttribute( const char* name, const char* value );
+        XMLAttribute* LookupAttribute( const char* name, XMLAttribute** last ) const;
 
         char* ParseAttributes( char* p, int* curLineNumPtr );
 
         enum { BUF_SIZE = 200 };
         ElementClosingType _closingType;        //元素展开状态
         XMLAttribute* _rootAttribute;           //属性列表
+        mutable XMLAttributeIndex* _attributeIndex;     //属性较多时，第一次查找时建立的索引
+        mutable XMLChildIndex* _childIndex;             //子节点较多时，第一次按名称查找子元素时建立的索引
         
     };
 
@@ -1195,6 +1715,19 @@ namespace tinyxml2{
         COLLAPSE_WHITESPACE
     };
 
+    //文档的内存统计，见XMLDocument::MemoryStats()
+    struct XMLMemoryStats {
+        XMLPoolStats    elements;       //元素
+        XMLPoolStats    attributes;     //属性
+        XMLPoolStats    texts;          //文本
+        XMLPoolStats    comments;       //注释、声明和未知节点
+        size_t          charBuffer;     //文档所有的解析数据缓存，含Reset()保留的和增量解析的数据块、待处理数据
+        size_t          strings;        //自己分配的字符串：SetValue()、SetAttribute()等设置的字符串所在的分配区和错误描述
+        size_t          names;          //名称表
+        size_t          indexes;        //元素的属性索引和子元素索引，以及解析时检查重复属性的索引
+        size_t          total;          //以上之和；不含未链接节点表、未闭合元素栈等与节点数或深度成正比的小数组
+    };
+
     class TINYXML2_LIB XMLDocument : public XMLNode{
         friend class XMLElement;
         friend class XMLNode;
@@ -1202,12 +1735,22 @@ namespace tinyxml2{
         friend class XMLComment;
         friend class XMLDeclaration;
         friend class XMLUnknown;
+        friend class XMLReader;
+        friend class XMLDocumentPool;
+        friend class XMLCompactDocument;
+        friend class XMLAttribute;
     public:
         //code
 
-        XMLDocument( bool processEntities = true, Whitespace whitespaceMode = PRESERVE_WHITESPACE );
+        //allocator不为0时，内存池、解析缓存、增量解析的数据、字符串和名称表从它分配，见XMLAllocator
+        //分配器的ReleaseOnReset()为true时，文档在Parse()等开始时把内存全部还给分配器，XMLRegionAllocator因此可以从头重用
+        XMLDocument( bool processEntities = true, Whitespace whitespaceMode = PRESERVE_WHITESPACE, XMLAllocator* allocator = 0 );
         ~XMLDocument();
 
+        XMLAllocator* Allocator() const {
+            return _allocator;
+        }
+
         virtual XMLDocument* ToDocument()               {
             TIXMLASSERT( this == _document );
             return this;
@@ -1220,6 +1763,32 @@ namespace tinyxml2{
 
         XMLError Parse( const char* xml, size_t nBytes=(size_t)(-1) );
 
+        //缓存释放函数，size为内容长度（不含终止符）
+        typedef void (*BufferDeleter)( char* buffer, size_t size );
+
+        //原地解析：直接在调用者的可写缓存中解析，不做拷贝，DOM中的字符串指向该缓存
+        //缓存至少要有nBytes+1字节，xml[nBytes]会被写成终止符；nBytes缺省时按strlen计算
+        //deleter为0时缓存仍归调用者所有，须在Clear()或析构之前保持有效；
+        //否则文档接管缓存，并在Clear()或析构时调用deleter释放
+        XMLError ParseInSitu( char* xml, size_t nBytes=(size_t)(-1), BufferDeleter deleter=0 );
+
+        //流式解析：不建立DOM，边解析边调用visitor，调用顺序与Accept()相同
+        //传给visitor的节点只在回调期间有效，元素只有名称和属性，没有父节点和子节点
+        //数据按固定大小分段解析，占用的内存只与嵌套深度和单个记号的长度有关；出错时已经发出的回调不会撤回，也不再调用VisitExit(文档)
+        XMLError Parse( const char* xml, size_t nBytes, XMLVisitor* visitor );
+
+        //多线程解析：在标签边界处把数据切成threads块同时解析，再按顺序拼接成一棵树
+        //threads为0时使用全部CPU；数据较小时退回Parse()
+        //切分处猜错或者文档有错误时整体重新用Parse()解析，结果和错误信息与Parse()完全相同
+        XMLError ParseParallel( const char* xml, size_t nBytes=(size_t)(-1), int threads=0 );
+
+        //增量解析：BeginParse()之后把数据分块交给Feed()，最后调用Finish()
+        //每块到达时就解析其中完整的部分，未完整的记号留到下一块，结果与一次性Parse()相同
+        //Feed()遇到'\0'时与Parse()一样忽略其后的数据；给出visitor时按流式解析处理
+        XMLError BeginParse( XMLVisitor* visitor=0 );
+        XMLError Feed( const char* chunk, size_t len );
+        XMLError Finish();
+
         XMLError LoadFile( const char* filename );
 
         XMLError LoadFile( FILE* );
@@ -1228,6 +1797,13 @@ namespace tinyxml2{
 
         XMLError SaveFile( FILE* fp, bool compact = false );
 
+        //批量处理：用threads个线程（0为全部CPU）处理count个互不相同的文档，第i个文档对应第i个文件名或数据
+        //每个文档的结果见其ErrorID()，results不为0时另外写入results[i]；返回出错的文档数
+        static int LoadFiles( XMLDocument* const* documents, const char* const* filenames, int count, XMLError* results=0, int threads=0 );
+        //nBytes为0时按strlen计算每份数据的长度
+        static int ParseBuffers( XMLDocument* const* documents, const char* const* xmls, const size_t* nBytes, int count, XMLError* results=0, int threads=0 );
+        static int SaveFiles( XMLDocument* const* documents, const char* const* filenames, int count, bool compact=false, XMLError* results=0, int threads=0 );
+
         bool ProcessEntities() const        {
             return _processEntities;
         }
@@ -1236,6 +1812,13 @@ namespace tinyxml2{
             return _whitespaceMode;
          }
 
+        //单调模式：删除节点和属性时只从树上断开，不析构也不回收内存，Clear()和析构时整块释放而不遍历树
+        //适合建立或解析后用一次就丢弃的文档；删除后的节点不能再使用。切换模式会先Clear()
+        void SetMonotonic( bool monotonic );
+        bool Monotonic() const {
+            return _monotonic;
+        }
+
          //如果此文档具有UTF8标记，则返回true
         bool HasBOM() const {
             return _writeBOM;
@@ -1271,7 +1854,10 @@ namespace tinyxml2{
         void DeleteNode( XMLNode* node );
 
         void ClearError() {
-            SetError(XML_SUCCESS, 0, 0);
+            //已经清空时不再格式化错误描述，反复解析时不分配内存
+            if ( _errorID != XML_SUCCESS || _errorLineNum != 0 || _errorStr.Empty() ) {
+                SetError(XML_SUCCESS, 0, 0);
+            }
         }
 
         bool Error() const {
@@ -1295,9 +1881,29 @@ namespace tinyxml2{
         }
 
         void Clear();
+        //与Clear()相同但保留内存：内存池按最大用量合并成一块，设置过的字符串和Parse()、LoadFile()拷贝数据的缓存也保留容量
+        //分配器的ReleaseOnReset()为true时不保留，与ClearNames()相同，全部还给分配器，之前取得的名称键失效
+        //反复解析大小相近的文档时，之后的解析不再分配内存。Parse()等开始时也会调用，Clear()和析构时才全部释放
+        //只保留这次用到的部分，超过用量TINYXML2_RETAIN_FACTOR倍的按这次的用量重新分配；上次Reset()之后没有用过文档时保持不变
+        void Reset();
+        //之后内存池新分配的块的大小（字节），默认为TINYXML2_POOL_BLOCK_SIZE
+        void SetPoolBlockSize( int bytes );
+
+        //当前的内存占用，只汇总各部分的计数，不遍历树
+        XMLMemoryStats MemoryStats() const;
+        //估计node及其后代占用的内存：节点和属性在内存池中的大小，加上自己分配的字符串和索引；名称由名称表共用，不计入
+        size_t SubtreeFootprint( const XMLNode* node ) const;
 
         void DeepCopy(XMLDocument* target) const;
 
+        //取得名称键，名称不在名称表中时加入；同一文档中同名的键相等，Clear()之后仍然有效
+        XMLName InternName( const char* name );
+        //Clear()之后再释放内存池和名称表，文档不再占有任何内存。名称表只增不减，解析的名称不断变化的长期文档用它收回内存；之前取得的键全部失效
+        void ClearNames();
+        //只查找不加入，文档中没有出现过的名称返回空键，用空键查找元素和属性都找不到
+        //不修改文档，可以在多个线程中同时调用
+        XMLName FindName( const char* name ) const;
+
         char* Identify( char* p, XMLNode** node );
 
         void MarkInUse(XMLNode*);
@@ -1318,39 +1924,110 @@ namespace tinyxml2{
         XMLDocument( const XMLDocument& );
         void operator=( const XMLDocument& );
         void Parse();
+        char* ParseProlog();
+        bool AdoptBuffer( char* xml, size_t len, BufferDeleter deleter );
+        char* AllocBuffer( size_t size );
+        void ClearDocument( bool keepMemory );
+        void ResetPools();
         void SetError( XMLError error, int lineNum, const char* format, ... );
 
-        class DepthTracker {
+        //增量解析状态
+        enum PushState {
+            PUSH_IDLE,          //未在增量解析
+            PUSH_PROLOG,        //等待开头的空白和BOM
+            PUSH_BODY,          //解析节点
+            PUSH_STOPPED        //文档层遇到结束标签，之后的数据全部忽略
+        };
+        //Feed()每次拷贝并解析的最大字节数，大块数据分段处理，待处理数据不随块大小增长
+        enum { PUSH_SLICE = 64 * 1024 };
+        //ParseStep()解析出的节点种类
+        enum ParseEvent {
+            PARSE_START,        //开始标签，元素已入栈
+            PARSE_END,          //结束标签，闭合的元素已出栈
+            PARSE_NODE,         //叶子节点或自闭合元素
+            PARSE_DONE,         //本段数据解析完毕
+            PARSE_STOP,         //文档层遇到结束标签，解析结束
+            PARSE_ERROR         //出错
+        };
+        void ParsePending( bool final );
+        char* ParseStep( char* p, const char* end, bool final, ParseEvent* event, XMLNode** node );
+        char* AbortParse();
+        bool ParseSpan( char* p, const char* end, bool final );
+        void ReleaseParseBlocks();
+        bool AppendPending( const char* data, size_t len );
+        void FreePending();
+
+        //转给调用者的分配器，分配失败时设置XML_ERROR_OUT_OF_MEMORY
+        class DocumentAllocator : public XMLAllocator {
         public:
-            //构造函数
-            explicit DepthTracker(XMLDocument * document) {
-                this->_document = document;
-                document->PushDepth();
-            }
-            ~DepthTracker() {
-                //降低深度
-                _document->PopDepth();
-            }
-        private:
-            XMLDocument * _document;
+            XMLDocument*    document;
+            XMLAllocator*   target;
+            virtual void* Allocate( size_t size );
+            virtual void Free( void* mem, size_t size );
         };
 
-        void PushDepth();
-        void PopDepth();
+        struct ParseChunk;
+        static void RunChunk( void* chunks, int index );
+        static bool ScanChunk( const char* p, const char* end, int* lines );
+        //并行解析时块之间的间隔：对齐到CHUNK_ALIGN，加上块末尾的"<>"和'\0'
+        enum { CHUNK_ALIGN = 64, CHUNK_GAP = CHUNK_ALIGN + 3 };
+        void SeparateChunks( ParseChunk* chunks, int count );
+        bool ParseFragment( char* p, const char* end, bool last );
+        void RetargetFragment( XMLDocument* target );
+        bool LinkFragment( XMLDocument* fragment );
+        void DiscardNodes( bool keepMemory = false );
+        void RegisterIndex( const XMLElement* element );
+        void ReleaseIndexes();
 
         template<class NodeType, int PoolElementSize>
         NodeType* CreateUnlinkedNode( MemPoolT<PoolElementSize>& pool );
 
         bool                                _writeBOM;          //是否写入
         bool                                _processEntities;   //实体
+        bool                                _monotonic;         //单调模式，见SetMonotonic()
+        XMLAllocator*                       _allocator;         //调用者的分配器，0表示用new
+        DocumentAllocator                   _documentAllocator;
+        XMLAllocator*                       _memory;            //内存池等使用的分配器，_allocator为0时也为0
         XMLError                            _errorID;           //错误ID
         Whitespace                          _whitespaceMode;    //空白
         mutable StrPair                     _errorStr;          //错误字符
         int                                 _errorLineNum;      //错误行号
         char*                               _charBuffer;        //字符缓存区
+        size_t                              _charBufferSize;    //缓存内容长度
+        BufferDeleter                       _charBufferDeleter; //缓存释放函数，0表示不归文档所有
+        const char*                         _allocatedBuffer;   //AllocBuffer()最近分配的缓存
+        size_t                              _allocatedSize;     //及其容量
+        char*                               _spareBuffer;       //Reset()留下的缓存
+        size_t                              _spareSize;         //及其容量
         int                                 _parseCurLineNum;   //当前解析行
-        int                                 _parsingDepth;      //解析深度  
         DynArray<XMLNode*, 10>              _unlinked;          //未链接节点
+        XMLNameTable                        _names;             //元素名和属性名
+        StrArena                            _strings;           //SetValue()、SetAttribute()等设置的字符串，Clear()时释放
+        XMLAttributeIndex                   _attributeIndex;    //解析属性较多的元素时检查重复属性
+        struct IndexedElement {
+            const XMLElement*   element;
+            IndexedElement*     next;
+        };
+        IndexedElement*                     _indexedElements;   //单调模式下建立过索引的元素，Clear()时释放其索引
+        size_t                              _indexBytes;        //元素的索引占用的内存，多个线程查找时原子地增减
+        PushState                           _pushState;         //增量解析状态
+        bool                                _pushInputEnded;    //已读到'\0'，不再接收数据
+        size_t                              _pushStart;         //待处理数据中第一个未解析字节
+        size_t                              _pushScan;          //当前记号已扫描的长度
+        char                                _pushQuote;         //当前标签中未闭合的引号
+        char*                               _pushBuffer;        //尚未成形的待处理数据，末尾保持'\0'，从_memory分配
+        size_t                              _pushSize;          //待处理数据的长度
+        size_t                              _pushCapacity;      //及其容量
+        struct ParseBlock {
+            char*   mem;
+            size_t  size;
+        };
+        DynArray<ParseBlock, 10>            _parseBlocks;       //增量解析中已固定的数据块，从_memory分配
+        DynArray<XMLElement*, 10>           _openElements;      //尚未闭合的元素
+        DynArray<int, 10>                   _openBlocks;        //未闭合元素所在的数据块
+        XMLVisitor*                         _visitor;           //流式解析的访问者
+        int                                 _visitSkip;         //不小于该深度的回调被跳过
+        bool                                _parsePrologOnly;   //文档层目前只有声明
         MemPoolT< sizeof(XMLElement) >      _elementPool;       //元素内存池
         MemPoolT< sizeof(XMLAttribute) >    _attributePool;     //属性内存池
         MemPoolT< sizeof(XMLText) >         _textPool;          //文本内存池
@@ -1364,14 +2041,347 @@ namespace tinyxml2{
     {
         TIXMLASSERT( sizeof( NodeType ) == PoolElementSize );
         TIXMLASSERT( sizeof( NodeType ) == pool.ItemSize() );
-        //创建节点并分配空间
-        NodeType* returnNode = new (pool.Alloc()) NodeType( this );
-        TIXMLASSERT( returnNode );
+        //创建节点并分配空间，内存不足时返回0
+        void* mem = pool.Alloc();
+        if ( !mem ) {
+            return 0;
+        }
+        NodeType* returnNode = new (mem) NodeType( this );
         returnNode->_memPool = &pool;
+        returnNode->_unlinkedIndex = _unlinked.Size();
         _unlinked.Push(returnNode);
         return returnNode;
     }
 
+    //文档池：每个线程缓存归还的文档，取出时已经Reset()，内存池、字符串和缓存保留上次用过的容量
+    //Acquire()和Release()可以在多个线程中同时调用；池应在所有使用它的线程不再使用后析构
+    class TINYXML2_LIB XMLDocumentPool
+    {
+    public:
+        //code
+        XMLDocumentPool( bool processEntities = true, Whitespace whitespaceMode = PRESERVE_WHITESPACE );
+        ~XMLDocumentPool();
+
+        //每个线程最多缓存的文档数，和每个缓存的文档最多保留的内存字节数；应在使用池之前设置
+        //缓存已满时归还的文档被删除，保留的内存超出限制的文档先ClearNames()释放全部内存再缓存
+        void SetLimits( int maxDocuments, size_t maxBytes );
+
+        //取出一个空文档，当前线程没有缓存的文档时新建
+        XMLDocument* Acquire();
+        //归还Acquire()取出的文档，放入当前线程的缓存，可以不是取出它的线程
+        //单调模式和内存池块大小恢复为默认值；设置与本池不同或使用分配器的文档不是本池的，直接删除
+        void Release( XMLDocument* document );
+
+    private:
+        //code
+        XMLDocumentPool( const XMLDocumentPool& );      //不实现
+        void operator=( const XMLDocumentPool& );       //不实现
+
+        struct Cache;
+        struct Local;
+        Cache* LocalCache();
+        static void DeleteCache( void* cache );
+
+        bool                _processEntities;   //新建文档的设置
+        Whitespace          _whitespaceMode;
+        int                 _maxDocuments;      //每个线程最多缓存的文档数
+        size_t              _maxBytes;          //每个缓存的文档最多保留的内存
+        Local*              _local;             //线程局部存储和全部线程的缓存
+    };
+
+    //拉取式解析器：由调用者逐个取出记号，不建立DOM，也没有回调
+    //名称、属性和文本直接指向缓存中的数据，只在取下一个记号之前有效
+    class TINYXML2_LIB XMLReader
+    {
+        friend class XMLCompactDocument;
+    public:
+        //code
+        enum TokenType {
+            START_ELEMENT,      //开始标签，自闭合元素之后紧跟一个END_ELEMENT
+            END_ELEMENT,        //结束标签
+            TEXT,               //文本或CDATA
+            COMMENT,            //注释
+            DECLARATION,        //声明
+            UNKNOWN,            //DTD等
+            END_DOCUMENT        //文档结束，出错时也返回它，用Error()区分
+        };
+
+        XMLReader( bool processEntities = true, Whitespace whitespaceMode = PRESERVE_WHITESPACE );
+        ~XMLReader();
+
+        //拷贝一份数据后开始读取
+        XMLError Open( const char* xml, size_t nBytes=(size_t)(-1) );
+        //直接在调用者的缓存中读取，规则同XMLDocument::ParseInSitu()
+        XMLError OpenInSitu( char* xml, size_t nBytes=(size_t)(-1), XMLDocument::BufferDeleter deleter=0 );
+
+        //取下一个记号，检查规则与XMLDocument::Parse()相同
+        TokenType Next();
+
+        //当前为START_ELEMENT时跳过它的全部子节点，停在匹配的END_ELEMENT上
+        //子树内部只按记号边界扫描，不建立节点，也不检查其中的结构
+        bool SkipSubtree();
+
+        TokenType Type() const {
+            return _type;
+        }
+
+        //元素名，非元素返回0
+        const char* Name() const;
+        //文本、注释、声明的内容，元素返回名称
+        const char* Value() const;
+        //当前元素的临时视图，只有名称和属性
+        const XMLElement* ToElement() const;
+        const XMLAttribute* FirstAttribute() const;
+        const char* Attribute( const char* name, const char* value=0 ) const;
+        bool CData() const;
+
+        //外层未闭合元素的数量
+        int Depth() const {
+            return _depth;
+        }
+
+        //元素的行号为开始标签所在行
+        int LineNum() const;
+
+        bool Error() const {
+            return _document.Error();
+        }
+
+        XMLError ErrorID() const {
+            return _document.ErrorID();
+        }
+
+        const char* ErrorStr() const {
+            return _document.ErrorStr();
+        }
+
+        int ErrorLineNum() const {
+            return _document.ErrorLineNum();
+        }
+
+    private:
+        //code
+        XMLReader( const XMLReader& );
+        void operator=( const XMLReader& );
+        void Release();
+
+        XMLDocument _document;      //提供内存池、缓存、错误信息和元素栈
+        char*       _p;             //下一个记号的位置，0表示已结束
+        char        _next;          //_p处原来的字节，取文本的值时可能被改写为'\0'
+        TokenType   _type;          //当前记号
+        XMLNode*    _node;          //当前记号的节点
+        bool        _ownsNode;      //读取下一个记号前是否删除_node
+        bool        _closePending;  //自闭合元素还要返回END_ELEMENT
+        int         _depth;         //当前深度
+    };
+
+    class XMLCompactNode;
+
+    //紧凑的只读DOM：节点和属性按数组存放（结构数组），用32位下标互相引用
+    //字符串是指向解析缓存的64位偏移和32位长度，名称是名称编号；遍历用到的字段与其余字段分开存放
+    //只记录向前的链接，LastChild()和PreviousSibling()需要遍历兄弟节点
+    //由XMLReader逐个记号建立：XMLReader为当前记号在内存池中临时建立一个节点，读下一个记号时删除，不建立XMLNode树
+    //输入大小不限，但节点数和属性数不能超过INT_MAX，单个字符串不能达到4GB，否则报XML_ERROR_PARSING
+    class TINYXML2_LIB XMLCompactDocument
+    {
+    public:
+        //code
+        enum NodeType {
+            DOCUMENT,
+            ELEMENT,
+            TEXT,
+            CDATA,
+            COMMENT,
+            DECLARATION,
+            UNKNOWN
+        };
+        //空下标：文档节点的下标是0，它不是任何节点的子节点或兄弟
+        enum { NONE = 0 };
+
+        XMLCompactDocument( bool processEntities = true, Whitespace whitespaceMode = PRESERVE_WHITESPACE );
+
+        XMLError Parse( const char* xml, size_t nBytes=(size_t)(-1) );
+        void Clear();
+
+        XMLCompactNode Root() const;
+        XMLCompactNode RootElement() const;
+
+        //包括文档节点
+        uint32_t NodeCount() const {
+            return static_cast<uint32_t>( _type.Size() );
+        }
+        uint32_t AttributeCount() const {
+            return static_cast<uint32_t>( _attributeName.Size() );
+        }
+        //数组占用的字节数，不含解析缓存和名称表
+        size_t BytesUsed() const;
+
+        bool Error() const {
+            return _reader.Error();
+        }
+        XMLError ErrorID() const {
+            return _reader.ErrorID();
+        }
+        const char* ErrorStr() const {
+            return _reader.ErrorStr();
+        }
+        int ErrorLineNum() const {
+            return _reader.ErrorLineNum();
+        }
+
+        //按下标访问，下标必须小于NodeCount()
+        NodeType Type( uint32_t node ) const {
+            return static_cast<NodeType>( _type[node] );
+        }
+        uint32_t Parent( uint32_t node ) const {
+            return _parent[node];
+        }
+        uint32_t FirstChild( uint32_t node ) const {
+            return _firstChild[node];
+        }
+        uint32_t LastChild( uint32_t node ) const;
+        uint32_t NextSibling( uint32_t node ) const {
+            return _nextSibling[node];
+        }
+        uint32_t PreviousSibling( uint32_t node ) const;
+        int LineNum( uint32_t node ) const {
+            return _lineNum[node];
+        }
+        //元素名，其他节点返回0
+        const char* Name( uint32_t node ) const;
+        //元素返回名称，文档返回0，其他节点返回内容
+        const char* Value( uint32_t node ) const;
+        uint32_t ValueLength( uint32_t node ) const;
+
+        //name为0时匹配任意元素
+        uint32_t FirstChildElement( uint32_t node, const char* name = 0 ) const;
+        uint32_t NextSiblingElement( uint32_t node, const char* name = 0 ) const;
+
+        //元素的属性是连续的一段下标[FirstAttribute(), FirstAttribute() + AttributeCount())
+        uint32_t FirstAttribute( uint32_t element ) const;
+        uint32_t AttributeCount( uint32_t element ) const;
+        const char* AttributeName( uint32_t attribute ) const {
+            return _names[ _attributeName[attribute] ];
+        }
+        const char* AttributeValue( uint32_t attribute ) const {
+            return _buffer + _attributeOffset[attribute];
+        }
+        uint32_t AttributeValueLength( uint32_t attribute ) const {
+            return _attributeLength[attribute];
+        }
+        const char* Attribute( uint32_t element, const char* name ) const;
+
+    private:
+        //code
+        XMLCompactDocument( const XMLCompactDocument& );    //不实现
+        void operator=( const XMLCompactDocument& );        //不实现
+
+        enum { NO_NAME = 0xffffffffu };
+        void ClearNodes();
+        uint32_t AddNode( NodeType type, uint32_t parent, uint32_t* lastChild, int lineNum );
+        uint64_t Offset( const char* str ) const;
+        bool CheckLength( size_t length );
+        uint32_t InternName( const char* name );
+        uint32_t FindName( const char* name ) const;
+
+        XMLReader                   _reader;            //解析器，持有解析缓存和名称表
+        char*                       _buffer;
+
+        //遍历用到的字段
+        DynArray<unsigned char, 16> _type;
+        DynArray<uint32_t, 16>      _name;              //元素的名称编号
+        DynArray<uint32_t, 16>      _firstChild;
+        DynArray<uint32_t, 16>      _nextSibling;
+        //其余字段
+        DynArray<uint32_t, 16>      _parent;
+        DynArray<int, 16>           _lineNum;
+        DynArray<uint64_t, 16>      _offset;            //内容的偏移，元素是第一个属性的下标
+        DynArray<uint32_t, 16>      _length;            //内容的长度，元素是属性的数量
+
+        DynArray<uint32_t, 16>      _attributeName;
+        DynArray<uint64_t, 16>      _attributeOffset;
+        DynArray<uint32_t, 16>      _attributeLength;
+
+        DynArray<const char*, 16>   _names;             //名称编号对应的名称，指向_reader的名称表
+        DynArray<uint32_t, 16>      _nameSlots;         //名称指针到编号的散列表，存放编号+1，0为空槽
+    };
+
+    //XMLCompactDocument中节点的句柄，不指向节点时Valid()返回false，各方法返回空句柄或0
+    class TINYXML2_LIB XMLCompactNode
+    {
+    public:
+        //code
+        XMLCompactNode() : _document( 0 ), _index( 0 ) {}
+        XMLCompactNode( const XMLCompactDocument* document, uint32_t index ) : _document( document ), _index( index ) {}
+
+        bool Valid() const {
+            return _document != 0;
+        }
+        uint32_t Index() const {
+            return _index;
+        }
+        XMLCompactDocument::NodeType Type() const {
+            return _document ? _document->Type( _index ) : XMLCompactDocument::DOCUMENT;
+        }
+        XMLCompactNode Parent() const {
+            //文档节点的下标就是NONE，它的子节点的父节点也是NONE
+            return ( _document && _index != XMLCompactDocument::NONE ) ? XMLCompactNode( _document, _document->Parent( _index ) ) : XMLCompactNode();
+        }
+        XMLCompactNode FirstChild() const {
+            return _document ? Link( _document->FirstChild( _index ) ) : XMLCompactNode();
+        }
+        XMLCompactNode LastChild() const {
+            return _document ? Link( _document->LastChild( _index ) ) : XMLCompactNode();
+        }
+        XMLCompactNode NextSibling() const {
+            return _document ? Link( _document->NextSibling( _index ) ) : XMLCompactNode();
+        }
+        XMLCompactNode PreviousSibling() const {
+            return _document ? Link( _document->PreviousSibling( _index ) ) : XMLCompactNode();
+        }
+        XMLCompactNode FirstChildElement( const char* name = 0 ) const {
+            return _document ? Link( _document->FirstChildElement( _index, name ) ) : XMLCompactNode();
+        }
+        XMLCompactNode NextSiblingElement( const char* name = 0 ) const {
+            return _document ? Link( _document->NextSiblingElement( _index, name ) ) : XMLCompactNode();
+        }
+
+        const char* Name() const {
+            return _document ? _document->Name( _index ) : 0;
+        }
+        const char* Value() const {
+            return _document ? _document->Value( _index ) : 0;
+        }
+        int GetLineNum() const {
+            return _document ? _document->LineNum( _index ) : 0;
+        }
+        const char* Attribute( const char* name ) const {
+            return _document ? _document->Attribute( _index, name ) : 0;
+        }
+        //第一个子节点是文本时返回它的内容
+        const char* GetText() const {
+            const XMLCompactNode child = FirstChild();
+            const XMLCompactDocument::NodeType type = child.Type();
+            return ( child.Valid() && ( type == XMLCompactDocument::TEXT || type == XMLCompactDocument::CDATA ) ) ? child.Value() : 0;
+        }
+
+        bool operator==( const XMLCompactNode& other ) const {
+            return _document == other._document && _index == other._index;
+        }
+        bool operator!=( const XMLCompactNode& other ) const {
+            return !( *this == other );
+        }
+
+    private:
+        //code
+        XMLCompactNode Link( uint32_t index ) const {
+            return ( index != XMLCompactDocument::NONE ) ? XMLCompactNode( _document, index ) : XMLCompactNode();
+        }
+
+        const XMLCompactDocument*   _document;
+        uint32_t                    _index;
+    };
+
     class TINYXML2_LIB XMLHandle
     {
     public:
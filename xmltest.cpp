@@ -0,0 +1,984 @@
+//回归测试：g++ TinyXML2.cpp xmltest.cpp -o xmltest && ./xmltest，全部通过时返回0
+#include "TinyXML2.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <string>
+#include <vector>
+#if !defined(TINYXML2_NO_THREADS) && ( defined(__linux__) || defined(__APPLE__) )
+#include <pthread.h>
+#define XMLTEST_THREADS
+#endif
+
+using namespace tinyxml2;
+
+static int gPass = 0;
+static int gFail = 0;
+
+static bool XMLTest( const char* testString, bool expected, bool found )
+{
+    const bool pass = ( expected == found );
+    if ( pass ) {
+        ++gPass;
+    }
+    else {
+        ++gFail;
+        printf( "[fail] %s\n", testString );
+    }
+    return pass;
+}
+
+static bool XMLTest( const char* testString, size_t expected, size_t found )
+{
+    const bool pass = ( expected == found );
+    if ( pass ) {
+        ++gPass;
+    }
+    else {
+        ++gFail;
+        printf( "[fail] %s: expected %lu, found %lu\n", testString, (unsigned long)expected, (unsigned long)found );
+    }
+    return pass;
+}
+
+//n个带属性和文本的元素
+static std::string GenerateItems( int n )
+{
+    std::string xml = "<root>";
+    for ( int i = 0; i < n; ++i ) {
+        char buf[64];
+        snprintf( buf, sizeof( buf ), "<item id='%d'>text %d</item>", i, i );
+        xml += buf;
+    }
+    xml += "</root>";
+    return xml;
+}
+
+//同一区域上反复解析：每次解析的用量与新区域相同，早先的解析不占用预算
+static void TestRegionReuse()
+{
+    const size_t size = 2 * 1024 * 1024;
+    std::vector<char> memory( size );
+    std::vector<char> freshMemory( size );
+    XMLRegionAllocator region( &memory[0], size );
+    XMLDocument doc( true, PRESERVE_WHITESPACE, &region );
+
+    bool sameResult = true;
+    bool sameUsage = true;
+    int parsed = 0;
+    for ( int n = 200; n <= 20000; n += 200 ) {
+        const std::string xml = GenerateItems( n );
+        XMLRegionAllocator fresh( &freshMemory[0], size );
+        size_t freshUsed = 0;
+        bool freshOk = false;
+        {
+            XMLDocument freshDoc( true, PRESERVE_WHITESPACE, &fresh );
+            freshDoc.Parse( xml.c_str(), xml.size() );
+            freshOk = !freshDoc.Error();
+            freshUsed = fresh.Used();
+        }
+        doc.Parse( xml.c_str(), xml.size() );
+        sameResult = sameResult && ( doc.Error() != freshOk );
+        sameUsage = sameUsage && ( !freshOk || region.Used() == freshUsed );
+        if ( !freshOk ) {
+            XMLTest( "Region reuse: out of memory only when a fresh region is", true, doc.ErrorID() == XML_ERROR_OUT_OF_MEMORY );
+            break;
+        }
+        ++parsed;
+    }
+    XMLTest( "Region reuse: same result as a fresh region", true, sameResult );
+    XMLTest( "Region reuse: same usage as a fresh region", true, sameUsage );
+    XMLTest( "Region reuse: several sizes parsed", true, parsed > 10 );
+
+    //增量解析的数据也从区域分配
+    const std::string xml = GenerateItems( 2000 );
+    doc.BeginParse();
+    for ( size_t i = 0; i < xml.size(); i += 1000 ) {
+        doc.Feed( xml.c_str() + i, xml.size() - i < 1000 ? xml.size() - i : 1000 );
+    }
+    doc.Finish();
+    XMLTest( "Region reuse: Feed()", false, doc.Error() );
+    XMLTest( "Region reuse: Feed() data in the region", true, region.Used() > xml.size() );
+
+    doc.ClearNames();
+    XMLTest( "Region reuse: all memory returned", (size_t)0, region.Used() );
+}
+
+//用malloc分配并计数
+class CountingAllocator : public XMLAllocator {
+public:
+    CountingAllocator() : calls( 0 ), live( 0 ) {}
+    virtual void* Allocate( size_t size ) {
+        ++calls;
+        live += size;
+        return malloc( size );
+    }
+    virtual void Free( void* mem, size_t size ) {
+        ++calls;
+        live -= size;
+        free( mem );
+    }
+    int calls;
+    size_t live;
+};
+
+//一般的分配器与new一样保留内存：重复解析不再调用分配器，名称键保持有效
+static void TestAllocatorReuse()
+{
+    CountingAllocator allocator;
+    XMLDocument doc( true, PRESERVE_WHITESPACE, &allocator );
+    const std::string xml = GenerateItems( 2000 );
+    doc.Parse( xml.c_str(), xml.size() );
+    const XMLName item = doc.FindName( "item" );
+    doc.Parse( xml.c_str(), xml.size() );
+    const int calls = allocator.calls;
+    for ( int i = 0; i < 5; ++i ) {
+        doc.Parse( xml.c_str(), xml.size() );
+    }
+    XMLTest( "Allocator reuse: no error", false, doc.Error() );
+    XMLTest( "Allocator reuse: no allocator calls", (size_t)0, (size_t)( allocator.calls - calls ) );
+    XMLTest( "Allocator reuse: name key still valid", true, doc.RootElement()->FirstChildElement( item ) != 0 );
+    doc.Clear();
+    doc.ClearNames();
+    XMLTest( "Allocator reuse: all memory returned", (size_t)0, allocator.live );
+}
+
+//名称键查找：空键（文档中没有的名称）不匹配任何元素，name为0时匹配任意元素
+static void TestNameKeys()
+{
+    XMLDocument doc;
+    doc.Parse( "<root><a/>text<b/><!--c--><a/></root>" );
+    const XMLElement* root = doc.RootElement();
+    const XMLElement* a = root->FirstChildElement( "a" );
+    const XMLElement* b = root->FirstChildElement( "b" );
+    const XMLElement* lastA = root->LastChildElement( "a" );
+    const XMLName typo = doc.FindName( "typo" );
+    XMLTest( "Name keys: absent name is empty", true, typo.Empty() );
+    XMLTest( "Name keys: FirstChildElement(empty)", true, root->FirstChildElement( typo ) == 0 );
+    XMLTest( "Name keys: LastChildElement(empty)", true, root->LastChildElement( typo ) == 0 );
+    XMLTest( "Name keys: NextSiblingElement(empty)", true, a->NextSiblingElement( typo ) == 0 );
+    XMLTest( "Name keys: PreviousSiblingElement(empty)", true, lastA->PreviousSiblingElement( typo ) == 0 );
+    XMLTest( "Name keys: FirstChildElement(\"typo\")", true, root->FirstChildElement( "typo" ) == 0 );
+    XMLTest( "Name keys: FindAttribute(empty)", true, root->FindAttribute( typo ) == 0 );
+
+    XMLTest( "Name keys: FirstChildElement()", true, root->FirstChildElement() == a );
+    XMLTest( "Name keys: LastChildElement()", true, root->LastChildElement() == lastA );
+    XMLTest( "Name keys: NextSiblingElement()", true, a->NextSiblingElement() == b );
+    XMLTest( "Name keys: PreviousSiblingElement()", true, lastA->PreviousSiblingElement() == b );
+    XMLTest( "Name keys: NextSiblingElement(a)", true, a->NextSiblingElement( doc.FindName( "a" ) ) == lastA );
+    XMLTest( "Name keys: PreviousSiblingElement(a)", true, lastA->PreviousSiblingElement( doc.FindName( "a" ) ) == a );
+    XMLTest( "Name keys: FirstChildElement(b)", true, root->FirstChildElement( doc.FindName( "b" ) ) == b );
+}
+
+//小区域上修改文档直到内存用完：失败的修改不留下没有值的属性或节点，文档仍可打印
+static void TestRegionOutOfMemory( size_t size )
+{
+    std::vector<char> memory( size );
+    XMLRegionAllocator region( &memory[0], size );
+    XMLDocument doc( true, PRESERVE_WHITESPACE, &region );
+    doc.Parse( "<root/>" );
+    XMLElement* root = doc.RootElement();
+    XMLTest( "Region OOM: parsed", true, root != 0 );
+    if ( !root ) {
+        return;
+    }
+
+    const std::string longValue( 300, 'v' );
+    int added = 0;
+    for ( int i = 0; i < 200; ++i ) {
+        char name[32];
+        snprintf( name, sizeof( name ), "a%d", i );
+        root->SetAttribute( name, longValue.c_str() );
+        if ( root->Attribute( name ) ) {
+            ++added;
+        }
+    }
+    XMLTest( "Region OOM: region exhausted", true, added < 200 );
+
+    bool allValues = true;
+    int count = 0;
+    for ( const XMLAttribute* a = root->FirstAttribute(); a; a = a->Next() ) {
+        allValues = allValues && a->Name() && a->Value() && longValue == a->Value();
+        ++count;
+    }
+    XMLTest( "Region OOM: every attribute has a value", true, allValues );
+    XMLTest( "Region OOM: failed attributes not linked", true, count == added );
+
+    //已有属性改成放不下的值时保持原值
+    const std::string hugeValue( size, 'h' );
+    if ( added > 0 ) {
+        root->SetAttribute( "a0", hugeValue.c_str() );
+        XMLTest( "Region OOM: old value kept", true, longValue == root->Attribute( "a0" ) );
+    }
+
+    XMLTest( "Region OOM: NewElement() fails", true, doc.NewElement( hugeValue.c_str() ) == 0 );
+    XMLTest( "Region OOM: NewText() fails", true, doc.NewText( hugeValue.c_str() ) == 0 );
+    XMLTest( "Region OOM: NewComment() fails", true, doc.NewComment( hugeValue.c_str() ) == 0 );
+    XMLTest( "Region OOM: NewUnknown() fails", true, doc.NewUnknown( hugeValue.c_str() ) == 0 );
+    root->SetText( hugeValue.c_str() );
+
+    XMLPrinter printer;
+    doc.Print( &printer );
+    XMLTest( "Region OOM: printed", true, (size_t)printer.CStrSize() > added * longValue.size() );
+}
+
+//回调时记录文档占用的最大缓存
+class PeakVisitor : public XMLVisitor {
+public:
+    PeakVisitor( const XMLDocument* doc ) : _doc( doc ), peak( 0 ), elements( 0 ) {}
+    virtual bool VisitEnter( const XMLElement&, const XMLAttribute* ) {
+        ++elements;
+        const size_t used = _doc->MemoryStats().charBuffer;
+        if ( used > peak ) {
+            peak = used;
+        }
+        return true;
+    }
+private:
+    const XMLDocument* _doc;
+public:
+    size_t peak;
+    int elements;
+};
+
+//流式解析一次交给全部数据时也分段处理，缓存不随文档大小增长
+static void TestStreamBounded()
+{
+    const std::string xml = GenerateItems( 200000 );
+    XMLDocument doc;
+    PeakVisitor visitor( &doc );
+    doc.Parse( xml.c_str(), xml.size(), &visitor );
+    XMLTest( "Stream bounded: no error", false, doc.Error() );
+    XMLTest( "Stream bounded: all elements", (size_t)200001, (size_t)visitor.elements );
+    XMLTest( "Stream bounded: buffer much smaller than the document", true, visitor.peak < xml.size() / 16 );
+
+    //一次交给Feed()的大块数据与分成小块的结果相同
+    XMLDocument whole;
+    whole.BeginParse();
+    whole.Feed( xml.c_str(), xml.size() );
+    whole.Finish();
+    XMLTest( "Stream bounded: Feed() of a large chunk", false, whole.Error() );
+    XMLTest( "Stream bounded: large chunk builds the whole tree", true,
+             whole.RootElement() && whole.RootElement()->LastChildElement() &&
+             whole.RootElement()->LastChildElement()->IntAttribute( "id" ) == 199999 );
+}
+
+//归还的文档恢复默认设置；不属于本池的文档不缓存
+static void TestDocumentPool()
+{
+    XMLDocumentPool pool;
+    XMLDocument* doc = pool.Acquire();
+    doc->SetMonotonic( true );
+    doc->SetPoolBlockSize( 64 * 1024 );
+    doc->Parse( "<a><b/></a>" );
+    pool.Release( doc );
+    XMLDocument* again = pool.Acquire();
+    XMLTest( "Document pool: cached document reused", true, again == doc );
+    XMLTest( "Document pool: monotonic mode reset", false, again->Monotonic() );
+    XMLTest( "Document pool: reused document is empty", true, again->FirstChild() == 0 );
+    pool.Release( again );
+
+    pool.Release( new XMLDocument( false, COLLAPSE_WHITESPACE ) );
+    XMLDocument* other = pool.Acquire();
+    XMLTest( "Document pool: foreign document not cached", true, other == doc && other->ProcessEntities() );
+    XMLDocument* fresh = pool.Acquire();
+    XMLTest( "Document pool: new document has pool settings", true, fresh->ProcessEntities() && fresh->WhitespaceMode() == PRESERVE_WHITESPACE );
+    pool.Release( fresh );
+    pool.Release( other );
+}
+
+//并行解析的结果与Parse()相同
+static void TestParseParallel()
+{
+    const std::string xml = GenerateItems( 100000 );
+    XMLDocument serial;
+    serial.Parse( xml.c_str(), xml.size() );
+    XMLPrinter serialPrinter;
+    serial.Print( &serialPrinter );
+    XMLDocument parallel;
+    parallel.ParseParallel( xml.c_str(), xml.size(), 4 );
+    XMLPrinter parallelPrinter;
+    parallel.Print( &parallelPrinter );
+    XMLTest( "Parse parallel: no error", false, parallel.Error() );
+    XMLTest( "Parse parallel: same as Parse()", true, strcmp( serialPrinter.CStr(), parallelPrinter.CStr() ) == 0 );
+}
+
+#ifdef XMLTEST_THREADS
+struct LookupJob {
+    const XMLElement*   element;
+    bool                found;
+};
+
+static void* LookupThread( void* arg )
+{
+    LookupJob* job = static_cast<LookupJob*>( arg );
+    job->found = true;
+    for ( int i = 0; i < 100; ++i ) {
+        int value = 0;
+        const XMLElement* child = job->element->FirstChildElement( "c30" );
+        job->found = job->found && job->element->QueryIntAttribute( "a9", &value ) == XML_SUCCESS && value == 9
+            && child && child->IntAttribute( "n" ) == 30;
+    }
+    return 0;
+}
+
+//不同元素的查找可以在多个线程中同时进行，各自建立的索引都计入文档的内存统计
+static void TestConcurrentLookup( bool monotonic )
+{
+    std::string xml = "<root>";
+    for ( int e = 0; e < 4; ++e ) {
+        xml += "<e";
+        for ( int a = 0; a < 12; ++a ) {
+            char buf[32];
+            snprintf( buf, sizeof( buf ), " a%d='%d'", a, a );
+            xml += buf;
+        }
+        xml += ">";
+        for ( int c = 0; c < 40; ++c ) {
+            char buf[32];
+            snprintf( buf, sizeof( buf ), "<c%d n='%d'/>", c, c );
+            xml += buf;
+        }
+        xml += "</e>";
+    }
+    xml += "</root>";
+
+    XMLDocument doc;
+    doc.SetMonotonic( monotonic );
+    doc.Parse( xml.c_str(), xml.size() );
+    const size_t indexes = doc.MemoryStats().indexes;
+    const size_t footprint = doc.SubtreeFootprint( doc.RootElement() );
+
+    LookupJob jobs[4];
+    pthread_t threads[4];
+    const XMLElement* element = doc.RootElement()->FirstChildElement();
+    for ( int i = 0; i < 4; ++i, element = element->NextSiblingElement() ) {
+        jobs[i].element = element;
+        pthread_create( &threads[i], 0, LookupThread, &jobs[i] );
+    }
+    bool found = true;
+    for ( int i = 0; i < 4; ++i ) {
+        pthread_join( threads[i], 0 );
+        found = found && jobs[i].found;
+    }
+    XMLTest( "Concurrent lookup: found", true, found );
+    XMLTest( "Concurrent lookup: index bytes counted", doc.SubtreeFootprint( doc.RootElement() ) - footprint,
+             doc.MemoryStats().indexes - indexes );
+}
+#endif
+
+static XMLCompactDocument::NodeType CompactType( const XMLNode* node )
+{
+    if ( node->ToDocument() ) {
+        return XMLCompactDocument::DOCUMENT;
+    }
+    if ( node->ToElement() ) {
+        return XMLCompactDocument::ELEMENT;
+    }
+    if ( node->ToText() ) {
+        return node->ToText()->CData() ? XMLCompactDocument::CDATA : XMLCompactDocument::TEXT;
+    }
+    if ( node->ToComment() ) {
+        return XMLCompactDocument::COMMENT;
+    }
+    if ( node->ToDeclaration() ) {
+        return XMLCompactDocument::DECLARATION;
+    }
+    return XMLCompactDocument::UNKNOWN;
+}
+
+//紧凑文档的子树与DOM逐个节点相同：类型、值及其长度、行号、属性，以及各个方向的链接
+static bool SameAsCompact( const XMLNode* node, const XMLCompactDocument& compact, uint32_t index )
+{
+    if ( compact.Type( index ) != CompactType( node ) ) {
+        return false;
+    }
+    if ( !node->ToDocument() ) {
+        const char* value = compact.Value( index );
+        if ( !value || strcmp( value, node->Value() ) != 0 || compact.ValueLength( index ) != strlen( value )
+             || compact.LineNum( index ) != node->GetLineNum() ) {
+            return false;
+        }
+    }
+    const XMLElement* element = node->ToElement();
+    if ( element ) {
+        uint32_t attribute = compact.FirstAttribute( index );
+        uint32_t count = 0;
+        for ( const XMLAttribute* a = element->FirstAttribute(); a; a = a->Next(), ++attribute, ++count ) {
+            if ( count >= compact.AttributeCount( index ) || strcmp( compact.AttributeName( attribute ), a->Name() ) != 0
+                 || strcmp( compact.AttributeValue( attribute ), a->Value() ) != 0
+                 || compact.AttributeValueLength( attribute ) != strlen( a->Value() )
+                 || compact.Attribute( index, a->Name() ) != compact.AttributeValue( attribute ) ) {
+                return false;
+            }
+        }
+        if ( count != compact.AttributeCount( index ) ) {
+            return false;
+        }
+    }
+    uint32_t child = compact.FirstChild( index );
+    uint32_t prev = XMLCompactDocument::NONE;
+    for ( const XMLNode* n = node->FirstChild(); n; n = n->NextSibling() ) {
+        if ( child == XMLCompactDocument::NONE || compact.Parent( child ) != index || compact.PreviousSibling( child ) != prev
+             || !SameAsCompact( n, compact, child ) ) {
+            return false;
+        }
+        prev = child;
+        child = compact.NextSibling( child );
+    }
+    return child == XMLCompactDocument::NONE && compact.LastChild( index ) == prev;
+}
+
+//XMLReader的记号序列与DOM的先序遍历相同
+static bool SameAsReader( const XMLNode* node, XMLReader& reader, int depth )
+{
+    for ( const XMLNode* n = node->FirstChild(); n; n = n->NextSibling() ) {
+        const XMLReader::TokenType type = reader.Next();
+        if ( reader.LineNum() != n->GetLineNum() || reader.Depth() != depth || strcmp( reader.Value(), n->Value() ) != 0 ) {
+            return false;
+        }
+        const XMLElement* element = n->ToElement();
+        if ( element ) {
+            const XMLAttribute* b = reader.FirstAttribute();
+            for ( const XMLAttribute* a = element->FirstAttribute(); a; a = a->Next(), b = b->Next() ) {
+                if ( !b || strcmp( a->Name(), b->Name() ) != 0 || strcmp( a->Value(), b->Value() ) != 0 ) {
+                    return false;
+                }
+            }
+            if ( type != XMLReader::START_ELEMENT || b || !SameAsReader( n, reader, depth + 1 )
+                 || reader.Next() != XMLReader::END_ELEMENT ) {
+                return false;
+            }
+            continue;
+        }
+        switch ( CompactType( n ) ) {
+            case XMLCompactDocument::TEXT:
+                if ( type != XMLReader::TEXT || reader.CData() ) {
+                    return false;
+                }
+                break;
+            case XMLCompactDocument::CDATA:
+                if ( type != XMLReader::TEXT || !reader.CData() ) {
+                    return false;
+                }
+                break;
+            case XMLCompactDocument::COMMENT:
+                if ( type != XMLReader::COMMENT ) {
+                    return false;
+                }
+                break;
+            case XMLCompactDocument::DECLARATION:
+                if ( type != XMLReader::DECLARATION ) {
+                    return false;
+                }
+                break;
+            default:
+                if ( type != XMLReader::UNKNOWN ) {
+                    return false;
+                }
+                break;
+        }
+    }
+    return true;
+}
+
+//XMLCompactDocument和XMLReader的结果与XMLDocument相同，出错时报告相同的错误
+static void TestCompactDocument()
+{
+    const char* xml =
+        "<?xml version=\"1.0\"?>\n"
+        "<!DOCTYPE root [\n<!ENTITY e \"x\">\n]>\n"
+        "<!-- comment -->\n"
+        "<root a=\"1 &amp; 2\" b='&#x41;'>\n"
+        "  text &lt; more\n"
+        "  <![CDATA[ raw <data> &amp; ]]>\n"
+        "  <item id=\"1\"/>\n"
+        "  <!--inner-->\n"
+        "  <item id=\"2\">  two   words  </item>\n"
+        "  <empty></empty>\n"
+        "</root>\n";
+    bool sameCompact = true;
+    bool sameReader = true;
+    for ( int mode = 0; mode < 4; ++mode ) {
+        const bool processEntities = ( mode & 1 ) != 0;
+        const Whitespace whitespace = ( mode & 2 ) ? COLLAPSE_WHITESPACE : PRESERVE_WHITESPACE;
+        XMLDocument doc( processEntities, whitespace );
+        XMLCompactDocument compact( processEntities, whitespace );
+        XMLReader reader( processEntities, whitespace );
+        doc.Parse( xml );
+        compact.Parse( xml );
+        reader.Open( xml );
+        sameCompact = sameCompact && !doc.Error() && !compact.Error() && SameAsCompact( &doc, compact, XMLCompactDocument::NONE );
+        sameReader = sameReader && SameAsReader( &doc, reader, 0 ) && reader.Next() == XMLReader::END_DOCUMENT && !reader.Error();
+    }
+    XMLTest( "Compact document: same as XMLDocument", true, sameCompact );
+    XMLTest( "XMLReader: same as XMLDocument", true, sameReader );
+
+    const char* const errors[] = {
+        "<root>\n<a>\n</root>",
+        "<root a='1' a='2'/>",
+        "<root>\n<a/>\n",
+        "<root>\n<!-- unclosed\n</root>",
+        "<root/>\n<second/>x",
+        "",
+        0
+    };
+    bool sameError = true;
+    for ( const char* const* p = errors; *p; ++p ) {
+        XMLDocument doc;
+        XMLCompactDocument compact;
+        XMLReader reader;
+        doc.Parse( *p );
+        compact.Parse( *p );
+        if ( reader.Open( *p ) == XML_SUCCESS ) {
+            while ( reader.Next() != XMLReader::END_DOCUMENT ) {
+            }
+        }
+        sameError = sameError && doc.Error() && compact.ErrorID() == doc.ErrorID() && compact.ErrorLineNum() == doc.ErrorLineNum()
+            && compact.NodeCount() == 0 && !compact.Root().Valid()
+            && reader.ErrorID() == doc.ErrorID() && reader.ErrorLineNum() == doc.ErrorLineNum();
+    }
+    XMLTest( "Compact document: same errors as XMLDocument", true, sameError );
+}
+
+//xorshift64，每次运行的数据相同
+static uint64_t Random()
+{
+    static uint64_t state = 0x9e3779b97f4a7c15ULL;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+//解析结果与strtod()/strtof()逐位相同
+static bool SameAsStrtod( const char* str )
+{
+    double value = 0;
+    const double expected = strtod( str, 0 );
+    if ( !XMLUtil::ToDouble( str, &value ) || memcmp( &value, &expected, sizeof( double ) ) != 0 ) {
+        printf( "  ToDouble(\"%.60s\")\n", str );
+        return false;
+    }
+    float valueF = 0;
+    const float expectedF = strtof( str, 0 );
+    if ( !XMLUtil::ToFloat( str, &valueF ) || memcmp( &valueF, &expectedF, sizeof( float ) ) != 0 ) {
+        printf( "  ToFloat(\"%.60s\")\n", str );
+        return false;
+    }
+    return true;
+}
+
+static bool SameAsStrtod( const char* const* strs )
+{
+    bool same = true;
+    for ( ; *strs; ++strs ) {
+        same = SameAsStrtod( *strs ) && same;
+    }
+    return same;
+}
+
+static const char* const kIndexNames[] = { "n0", "n1", "n2", "n3", "n4", "n5", "n6", "n7", "absent", 0 };
+
+//按名称查找子元素的结果与遍历子节点相同，包括按名称键查找和同名兄弟的链
+static bool SameAsChildScan( const XMLElement* parent )
+{
+    const XMLDocument* doc = parent->GetDocument();
+    for ( const char* const* name = kIndexNames; *name; ++name ) {
+        const XMLElement* first = 0;
+        const XMLElement* last = 0;
+        const XMLElement* next = parent->FirstChildElement( *name );
+        if ( next != parent->FirstChildElement( doc->FindName( *name ) ) ) {
+            return false;
+        }
+        for ( const XMLNode* n = parent->FirstChild(); n; n = n->NextSibling() ) {
+            const XMLElement* element = n->ToElement();
+            if ( element && strcmp( element->Name(), *name ) == 0 ) {
+                if ( element != next ) {
+                    return false;
+                }
+                first = first ? first : element;
+                last = element;
+                next = element->NextSiblingElement( *name );
+            }
+        }
+        if ( next || parent->LastChildElement( *name ) != last ) {
+            return false;
+        }
+        const XMLElement* prev = last;
+        for ( const XMLNode* n = parent->LastChild(); n; n = n->PreviousSibling() ) {
+            const XMLElement* element = n->ToElement();
+            if ( element && strcmp( element->Name(), *name ) == 0 ) {
+                if ( element != prev ) {
+                    return false;
+                }
+                prev = element->PreviousSiblingElement( doc->FindName( *name ) );
+            }
+        }
+        if ( prev ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//按名称查找属性的结果与遍历属性表相同
+static bool SameAsAttributeScan( const XMLElement* element )
+{
+    for ( int i = 0; i < 32; ++i ) {
+        char name[16];
+        snprintf( name, sizeof( name ), "a%d", i );
+        const XMLAttribute* found = 0;
+        for ( const XMLAttribute* a = element->FirstAttribute(); a; a = a->Next() ) {
+            if ( strcmp( a->Name(), name ) == 0 ) {
+                if ( found ) {
+                    return false;
+                }
+                found = a;
+            }
+        }
+        if ( element->FindAttribute( name ) != found ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//子元素索引和属性索引在插入、删除、改名、移动以及并行解析拼接之后仍与遍历的结果相同
+static void TestLookupIndexes()
+{
+    std::string xml = "<root><attrs";
+    for ( int i = 0; i < 20; ++i ) {
+        char buf[32];
+        snprintf( buf, sizeof( buf ), " a%d='%d'", i, i );
+        xml += buf;
+    }
+    xml += "/>";
+    for ( int i = 0; i < 200; ++i ) {
+        char buf[32];
+        snprintf( buf, sizeof( buf ), "<n%d/>%s", (int)( Random() % 8 ), i % 3 ? "" : "t" );
+        xml += buf;
+    }
+    xml += "</root>";
+
+    XMLDocument doc;
+    doc.Parse( xml.c_str(), xml.size() );
+    XMLElement* root = doc.RootElement();
+    XMLElement* attrs = root->FirstChildElement( "attrs" );
+    bool sameChildren = SameAsChildScan( root );
+    bool sameAttributes = SameAsAttributeScan( attrs );
+    for ( int op = 0; op < 400; ++op ) {
+        //随机选一个子节点
+        int count = 0;
+        for ( const XMLNode* n = root->FirstChild(); n; n = n->NextSibling() ) {
+            ++count;
+        }
+        XMLNode* node = root->FirstChild();
+        for ( int i = (int)( Random() % count ); i > 0; --i ) {
+            node = node->NextSibling();
+        }
+        char name[16];
+        snprintf( name, sizeof( name ), "n%d", (int)( Random() % 8 ) );
+        switch ( Random() % 6 ) {
+            case 0:
+                root->InsertEndChild( doc.NewElement( name ) );
+                break;
+            case 1:
+                root->InsertFirstChild( doc.NewElement( name ) );
+                break;
+            case 2:
+                root->InsertAfterChild( node, doc.NewElement( name ) );
+                break;
+            case 3:
+                if ( node != attrs ) {
+                    root->DeleteChild( node );
+                }
+                break;
+            case 4:
+                //改名清除父元素的索引
+                if ( node->ToElement() && node != attrs ) {
+                    node->ToElement()->SetName( name );
+                }
+                break;
+            default:
+                //移动已有的子节点
+                if ( node != root->LastChild() ) {
+                    root->InsertEndChild( node );
+                }
+                break;
+        }
+        snprintf( name, sizeof( name ), "a%d", (int)( Random() % 32 ) );
+        if ( Random() % 3 ) {
+            attrs->SetAttribute( name, op );
+        }
+        else {
+            attrs->DeleteAttribute( name );
+        }
+        sameChildren = sameChildren && SameAsChildScan( root );
+        sameAttributes = sameAttributes && SameAsAttributeScan( attrs );
+    }
+    XMLTest( "Lookup indexes: child lookups after edits", true, sameChildren );
+    XMLTest( "Lookup indexes: attribute lookups after edits", true, sameAttributes );
+
+    //并行解析时各块的子节点拼接到同一父元素下
+    std::string big = "<root>";
+    for ( int i = 0; i < 300000; ++i ) {
+        char buf[32];
+        snprintf( buf, sizeof( buf ), "<n%d i='%d'/>", (int)( Random() % 8 ), i );
+        big += buf;
+    }
+    big += "</root>";
+    XMLDocument parallel;
+    parallel.ParseParallel( big.c_str(), big.size(), 4 );
+    XMLTest( "Lookup indexes: parallel parse", false, parallel.Error() );
+    XMLTest( "Lookup indexes: child lookups after parallel parse", true, SameAsChildScan( parallel.RootElement() ) );
+}
+
+static void TestNumberParse()
+{
+    //随机的有效数字、小数点位置和指数
+    bool same = true;
+    char str[128];
+    for ( int i = 0; i < 100000; ++i ) {
+        const int digits = 1 + (int)( Random() % ( i % 8 == 0 ? 40 : 19 ) );
+        const int point = (int)( Random() % ( digits + 1 ) );
+        char* p = str;
+        if ( Random() % 2 ) {
+            *p++ = '-';
+        }
+        for ( int d = 0; d < digits; ++d ) {
+            if ( d == point ) {
+                *p++ = '.';
+            }
+            *p++ = (char)( '0' + Random() % 10 );
+        }
+        snprintf( p, str + sizeof( str ) - p, "e%d", (int)( Random() % 700 ) - 350 );
+        same = SameAsStrtod( str ) && same;
+    }
+    XMLTest( "Number parse: random decimals", true, same );
+
+    //随机位模式的最短表示
+    same = true;
+    for ( int i = 0; i < 50000; ++i ) {
+        uint64_t bits = Random();
+        double d;
+        memcpy( &d, &bits, sizeof( d ) );
+        if ( d != d ) {
+            continue;
+        }
+        snprintf( str, sizeof( str ), "%.17g", d );
+        same = SameAsStrtod( str ) && same;
+    }
+    XMLTest( "Number parse: random doubles", true, same );
+
+    //float相邻两值的中点可以用double精确表示，按偶数舍入；稍大或稍小时舍入到较近的一侧
+    same = true;
+    static char exact[1024];
+    for ( int i = 0; i < 20000; ++i ) {
+        uint32_t bits = (uint32_t)Random();
+        if ( i % 4 == 0 ) {
+            bits &= 0x807fffffu;        //非规格化数
+        }
+        float f;
+        memcpy( &f, &bits, sizeof( f ) );
+        const float next = nextafterf( f, f < 0 ? -FLT_MAX : FLT_MAX );
+        if ( f != f || fabsf( f ) >= FLT_MAX || fabsf( next ) >= FLT_MAX ) {
+            continue;
+        }
+        const double mid = ( (double)f + (double)next ) / 2;
+        snprintf( exact, sizeof( exact ), "%.120e", mid );
+        same = SameAsStrtod( exact ) && same;
+        snprintf( exact, sizeof( exact ), "%.12e", mid );
+        same = SameAsStrtod( exact ) && same;
+    }
+    XMLTest( "Number parse: float halfway cases", true, same );
+
+#if LDBL_MANT_DIG >= 64
+    //double的中点用long double精确计算，打印出全部有效数字
+    same = true;
+    for ( int i = 0; i < 2000; ++i ) {
+        uint64_t bits = Random();
+        if ( i % 4 == 0 ) {
+            bits &= 0x800fffffffffffffULL;
+        }
+        double d;
+        memcpy( &d, &bits, sizeof( d ) );
+        const double next = nextafter( d, d < 0 ? -DBL_MAX : DBL_MAX );
+        if ( d != d || fabs( d ) >= DBL_MAX || fabs( next ) >= DBL_MAX ) {
+            continue;
+        }
+        const long double mid = ( (long double)d + (long double)next ) / 2;
+        snprintf( exact, sizeof( exact ), "%.800Le", mid );
+        same = SameAsStrtod( exact ) && same;
+    }
+    //最小非规格化数的一半舍入为0，DBL_MAX之上半个单位舍入为无穷大
+    snprintf( exact, sizeof( exact ), "%.800Le", ldexpl( 1.0L, -1075 ) );
+    same = SameAsStrtod( exact ) && same;
+    snprintf( exact, sizeof( exact ), "%.800Le", (long double)DBL_MAX + ldexpl( 1.0L, 970 ) );
+    same = SameAsStrtod( exact ) && same;
+    XMLTest( "Number parse: double halfway cases", true, same );
+#endif
+
+    static const char* const halfway[] = {
+        "9007199254740993", "9007199254740995", "9007199254740993.0000000000000000000001",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203125000000000000000001",
+        "16777217", "16777219", "0.1", "0.3", "123456789012345678901234567890e-10", 0
+    };
+    XMLTest( "Number parse: halfway and long inputs", true, SameAsStrtod( halfway ) );
+    static const char* const subnormal[] = {
+        "4.9406564584124654e-324", "2.4703282292062328e-324", "2.2250738585072011e-308",
+        "2.2250738585072014e-308", "1.4012984643248171e-45", "7.006492321624085e-46",
+        "1.1754943508222875e-38", "1e-400", "-1e-400", 0
+    };
+    XMLTest( "Number parse: subnormal and underflow", true, SameAsStrtod( subnormal ) );
+    static const char* const overflow[] = {
+        "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308", "1e400", "-1e400",
+        "3.4028234663852886e38", "3.4028235677973366e38", "3.4028236e38", 0
+    };
+    XMLTest( "Number parse: overflow", true, SameAsStrtod( overflow ) );
+}
+
+//十进制数的有效数字（去掉前后的0）和第一位有效数字的指数
+static std::string Significand( const char* str, int* exponent )
+{
+    std::string digits;
+    int intDigits = 0;
+    bool point = false;
+    const char* p = ( *str == '-' ) ? str + 1 : str;
+    for ( ; *p && *p != 'e' && *p != 'E'; ++p ) {
+        if ( *p == '.' ) {
+            point = true;
+            continue;
+        }
+        digits += *p;
+        if ( !point ) {
+            ++intDigits;
+        }
+    }
+    const size_t lead = digits.find_first_not_of( '0' );
+    if ( lead == std::string::npos ) {
+        *exponent = 0;
+        return "0";
+    }
+    digits.erase( digits.find_last_not_of( '0' ) + 1 );
+    digits.erase( 0, lead );
+    *exponent = intDigits - 1 - (int)lead + ( *p ? atoi( p + 1 ) : 0 );
+    return digits;
+}
+
+//ToStr()能还原原值，有效数字不多于printf()能还原原值的最短输出，并且与它相同
+//2的幂下方的间隔只有上方的一半，printf()给出的最近值可能还原不了，ToStr()可以取到更短的
+static bool ShortestRoundTrip( double value, bool isFloat )
+{
+    char str[64];
+    if ( isFloat ) {
+        XMLUtil::ToStr( (float)value, str, sizeof( str ) );
+        const float back = strtof( str, 0 );
+        const float expected = (float)value;
+        if ( memcmp( &back, &expected, sizeof( float ) ) != 0 ) {
+            printf( "  ToStr(float %.9g) = %s\n", expected, str );
+            return false;
+        }
+    }
+    else {
+        XMLUtil::ToStr( value, str, sizeof( str ) );
+        const double back = strtod( str, 0 );
+        if ( memcmp( &back, &value, sizeof( double ) ) != 0 ) {
+            printf( "  ToStr(%.17g) = %s\n", value, str );
+            return false;
+        }
+    }
+    if ( value == 0 || value != value || fabs( value ) > DBL_MAX ) {
+        return true;
+    }
+    char shortest[64];
+    for ( int precision = 0; precision < 17; ++precision ) {
+        snprintf( shortest, sizeof( shortest ), "%.*e", precision, value );
+        if ( isFloat ? strtof( shortest, 0 ) == (float)value : strtod( shortest, 0 ) == value ) {
+            break;
+        }
+    }
+    int exponent = 0;
+    int shortestExponent = 0;
+    const std::string digits = Significand( str, &exponent );
+    const std::string shortestDigits = Significand( shortest, &shortestExponent );
+    int binaryExponent = 0;
+    const bool powerOfTwo = ( fabs( frexp( value, &binaryExponent ) ) == 0.5 );
+    if ( digits.size() > shortestDigits.size() || ( !powerOfTwo && ( digits != shortestDigits || exponent != shortestExponent ) ) ) {
+        printf( "  ToStr(%.17g) = %s, shortest %s\n", value, str, shortest );
+        return false;
+    }
+    return true;
+}
+
+static void TestNumberFormat()
+{
+    bool same = true;
+    bool sameFloat = true;
+    for ( int i = 0; i < 50000; ++i ) {
+        uint64_t bits = Random();
+        if ( i % 4 == 0 ) {
+            bits &= 0x800fffffffffffffULL | ( ( Random() % 3 ) << 52 );     //非规格化数和最小的规格化数
+        }
+        double d;
+        memcpy( &d, &bits, sizeof( d ) );
+        if ( d == d ) {
+            same = ShortestRoundTrip( d, false ) && same;
+        }
+        uint32_t bitsF = (uint32_t)Random();
+        if ( i % 4 == 0 ) {
+            bitsF &= 0x807fffffu;
+        }
+        float f;
+        memcpy( &f, &bitsF, sizeof( f ) );
+        if ( f == f ) {
+            sameFloat = ShortestRoundTrip( f, true ) && sameFloat;
+        }
+    }
+    //2的幂两侧的间隔不相等
+    for ( int e = -1074; e <= 1023; ++e ) {
+        same = ShortestRoundTrip( ldexp( 1.0, e ), false ) && same;
+    }
+    for ( int e = -149; e <= 127; ++e ) {
+        sameFloat = ShortestRoundTrip( ldexp( 1.0, e ), true ) && sameFloat;
+    }
+    static const double edges[] = { 0.1, 0.3, 1.0 / 3, 123456789.0, 1e21, 1e22, 1e23, 5e-324, DBL_MIN, DBL_MAX, -DBL_MAX, FLT_MAX, FLT_MIN, 0 };
+    for ( const double* e = edges; *e != 0; ++e ) {
+        same = ShortestRoundTrip( *e, false ) && same;
+        sameFloat = ShortestRoundTrip( (float)*e, true ) && sameFloat;
+    }
+    XMLTest( "Number format: double shortest round trip", true, same );
+    XMLTest( "Number format: float shortest round trip", true, sameFloat );
+
+    char str[64];
+    XMLUtil::ToStr( 0.0, str, sizeof( str ) );
+    XMLTest( "Number format: zero", true, strtod( str, 0 ) == 0 && !strchr( str, '-' ) );
+    XMLUtil::ToStr( -0.0, str, sizeof( str ) );
+    XMLTest( "Number format: negative zero", true, strtod( str, 0 ) == 0 && str[0] == '-' );
+}
+
+int main()
+{
+    TestRegionReuse();
+    TestAllocatorReuse();
+    TestNameKeys();
+    TestRegionOutOfMemory( 13312 );
+    TestRegionOutOfMemory( 32768 );
+    TestStreamBounded();
+    TestDocumentPool();
+    TestParseParallel();
+    TestCompactDocument();
+    TestLookupIndexes();
+#ifdef XMLTEST_THREADS
+    TestConcurrentLookup( false );
+    TestConcurrentLookup( true );
+#endif
+    TestNumberParse();
+    TestNumberFormat();
+
+    printf( "Pass %d, Fail %d\n", gPass, gFail );
+    return gFail;
+}